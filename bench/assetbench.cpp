@@ -0,0 +1,467 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Asset loading benchmark: times each step of getting assets out of resource.zip,
+// over every entry in it, and reports time per pass, its spread and throughput as
+// JSON. mount times mounting the archive. read_cold reads every entry with
+// XENO_readFile right after a fresh mount, and read_warm reads them again.
+// inflate reads every entry into one reused buffer, leaving allocation out;
+// nearly all of resource.zip is deflated. bmp_decode runs SDL_LoadBMP_RW over
+// every .bmp, texture_create hands the decoded surfaces to the software
+// renderer, and xml_parse parses every tileset descriptor.
+//
+// --baseline compares against the output of an earlier run. A scenario whose mean
+// moved by more than --threshold percent (5 by default), and by more than twice
+// the standard error of the difference, is called faster or slower; any slower
+// one makes the exit status 2. Built with PROFILE=y, --trace writes the profiling
+// zones of the whole run to FILE in the write directory.
+//
+// Usage: assetbench [--passes N] [--baseline FILE] [--threshold PCT] [--out FILE] [--trace FILE]
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/fsutils.h>
+#include <xeno/profiler.h>
+#include "benchutils.h"
+
+#include <SDL2/SDL.h>
+#include <physfs.h>
+#include <tinyxml2.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+using namespace tinyxml2;
+
+static const int MAX_ENTRIES = 1024;
+static const int MAX_SCENARIOS = 16;
+
+typedef struct Corpus {
+  char *archive;       // Native path of resource.zip
+  size_t archiveBytes;
+
+  int nEntries;
+  char paths[MAX_ENTRIES][128];
+  uint32_t length[MAX_ENTRIES];
+  size_t bytes;
+  char *buffer;        // Big enough for the largest entry
+
+  int nImages;
+  char *imageData[MAX_ENTRIES];
+  uint32_t imageLength[MAX_ENTRIES];
+  size_t imageBytes;
+  SDL_Surface *surfaces[MAX_ENTRIES];
+  size_t surfaceBytes;
+
+  int nXML;
+  char *xmlData[MAX_ENTRIES];
+  uint32_t xmlLength[MAX_ENTRIES];
+  size_t xmlBytes;
+
+  SDL_Renderer *renderer;
+} Corpus;
+
+typedef struct BenchResult {
+  const char *name;
+  BenchTiming timing;
+  size_t bytes;
+  double mbPerSec;
+  long checksum;
+
+  // From --baseline, if it has this scenario
+  int compared;
+  double baseMean, baseStddev;
+  int basePasses;
+  double change; // Percent; positive is slower
+  const char *verdict;
+} BenchResult;
+
+// Scenarios run one pass and return a checksum of what they read. prepare, if
+// given, runs before every pass, untimed.
+typedef long (*ScenarioFn)(Corpus *corpus);
+typedef void (*PrepareFn)(Corpus *corpus);
+
+
+static int compareNames(const void *a, const void *b) {
+  return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+
+static int hasExtension(const char *path, const char *ext) {
+  size_t len = strlen(path), extLen = strlen(ext);
+  return len > extLen && !SDL_strcasecmp(path + len - extLen, ext);
+}
+
+
+// Every file in the archive, depth first, in name order
+static void findEntries(Corpus *corpus, const char *dir) {
+  char **files = PHYSFS_enumerateFiles(dir);
+  int nFiles = 0;
+  if (!files)
+    return;
+
+  while (files[nFiles])
+    ++nFiles;
+  qsort(files, nFiles, sizeof(char *), compareNames);
+
+  for (int i = 0; i < nFiles && corpus->nEntries < MAX_ENTRIES; ++i) {
+    char *path = corpus->paths[corpus->nEntries];
+    PHYSFS_Stat stat;
+    SDL_snprintf(path, sizeof(corpus->paths[0]), dir[0] ? "%s/%s" : "%s%s", dir, files[i]);
+    if (!PHYSFS_stat(path, &stat))
+      continue;
+    if (stat.filetype == PHYSFS_FILETYPE_DIRECTORY) {
+      char subdir[sizeof(corpus->paths[0])];
+      SDL_strlcpy(subdir, path, sizeof(subdir));
+      findEntries(corpus, subdir);
+    } else if (stat.filetype == PHYSFS_FILETYPE_REGULAR) {
+      corpus->length[corpus->nEntries++] = (uint32_t) stat.filesize;
+      corpus->bytes += (size_t) stat.filesize;
+    }
+  }
+
+  PHYSFS_freeList(files);
+}
+
+
+// Reads the images and descriptors up front, and decodes the images for texture_create
+static int loadCorpus(Corpus *corpus) {
+  uint32_t largest = 0;
+  findEntries(corpus, "");
+  for (int i = 0; i < corpus->nEntries; ++i) {
+    largest = SDL_max(largest, corpus->length[i]);
+    char *data = NULL;
+    if (hasExtension(corpus->paths[i], ".bmp")) {
+      uint32_t length = XENO_readFile(corpus->paths[i], &data);
+      SDL_Surface *surface = length ? SDL_LoadBMP_RW(SDL_RWFromConstMem(data, length), 1) : NULL;
+      if (!surface) {
+        XENO_free(data);
+        continue;
+      }
+      corpus->imageData[corpus->nImages] = data;
+      corpus->imageLength[corpus->nImages] = length;
+      corpus->surfaces[corpus->nImages++] = surface;
+      corpus->imageBytes += length;
+      corpus->surfaceBytes += (size_t) surface->pitch * surface->h;
+    } else if (hasExtension(corpus->paths[i], ".xml")) {
+      uint32_t length = XENO_readFile(corpus->paths[i], &data);
+      if (!length) {
+        XENO_free(data);
+        continue;
+      }
+      corpus->xmlData[corpus->nXML] = data;
+      corpus->xmlLength[corpus->nXML++] = length;
+      corpus->xmlBytes += length;
+    }
+  }
+
+  corpus->buffer = (char *) malloc(largest ? largest : 1);
+  return corpus->nEntries && corpus->buffer;
+}
+
+
+static void unmountArchive(Corpus *corpus) {
+  PHYSFS_unmount(corpus->archive);
+}
+
+
+static void remountArchive(Corpus *corpus) {
+  PHYSFS_unmount(corpus->archive);
+  PHYSFS_mount(corpus->archive, "/", 1);
+}
+
+
+static long mountArchive(Corpus *corpus) {
+  return PHYSFS_mount(corpus->archive, "/", 1);
+}
+
+
+static long readEntries(Corpus *corpus) {
+  long sum = 0;
+  for (int i = 0; i < corpus->nEntries; ++i) {
+    char *data = NULL;
+    uint32_t length = XENO_readFile(corpus->paths[i], &data);
+    if (length)
+      sum += length + (unsigned char) data[length / 2];
+    XENO_free(data);
+  }
+  return sum;
+}
+
+
+static long inflateEntries(Corpus *corpus) {
+  long sum = 0;
+  for (int i = 0; i < corpus->nEntries; ++i) {
+    PHYSFS_File *file = PHYSFS_openRead(corpus->paths[i]);
+    if (!file)
+      continue;
+    PHYSFS_sint64 length = PHYSFS_readBytes(file, corpus->buffer, corpus->length[i]);
+    if (length > 0)
+      sum += (long) length + (unsigned char) corpus->buffer[length / 2];
+    PHYSFS_close(file);
+  }
+  return sum;
+}
+
+
+static long decodeImages(Corpus *corpus) {
+  long sum = 0;
+  for (int i = 0; i < corpus->nImages; ++i) {
+    SDL_Surface *surface = SDL_LoadBMP_RW(SDL_RWFromConstMem(corpus->imageData[i], corpus->imageLength[i]), 1);
+    if (surface) {
+      sum += surface->w * surface->h;
+      SDL_FreeSurface(surface);
+    }
+  }
+  return sum;
+}
+
+
+static long createTextures(Corpus *corpus) {
+  long sum = 0;
+  for (int i = 0; i < corpus->nImages; ++i) {
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(corpus->renderer, corpus->surfaces[i]);
+    if (texture) {
+      ++sum;
+      SDL_DestroyTexture(texture);
+    }
+  }
+  return sum;
+}
+
+
+// Parsed the way the tileset loader does
+static long parseDescriptors(Corpus *corpus) {
+  static XMLArena arena;
+  static XMLDocument doc;
+  long sum = 0;
+  if (!doc.Arena())
+    doc.SetArena(&arena);
+  doc.SetUnquotedAttributes(true);
+  for (int i = 0; i < corpus->nXML; ++i) {
+    doc.Parse(corpus->xmlData[i], corpus->xmlLength[i]);
+    const XMLElement *root = doc.RootElement();
+    sum += doc.ErrorID() + (root ? (long) strlen(root->Name()) : 0);
+  }
+  return sum;
+}
+
+
+static void runScenario(BenchResult *result, const char *name, PrepareFn prepare, ScenarioFn fn, Corpus *corpus,
+                        size_t bytes, int passes) {
+  BenchTimer timer;
+  memset(result, 0, sizeof(BenchResult));
+  result->name = name;
+  result->bytes = bytes;
+  if (prepare)
+    prepare(corpus);
+  result->checksum = fn(corpus); // Warm up caches and any reused storage
+  if (!benchStartTimer(&timer, passes))
+    return;
+
+  for (int p = 0; p < passes; ++p) {
+    if (prepare)
+      prepare(corpus);
+    benchBeginPass(&timer);
+    fn(corpus);
+    benchEndPass(&timer);
+  }
+
+  benchFinishTimer(&timer, &result->timing);
+  result->mbPerSec = benchMBPerSec(bytes, &result->timing);
+}
+
+
+// Reads mean_ms, stddev_ms and passes back out of an earlier run's output, which has
+// one scenario per line
+static int loadBaseline(const char *path, BenchResult *results, int n) {
+  FILE *in = fopen(path, "r");
+  char line[1024];
+  if (!in)
+    return 0;
+
+  while (fgets(line, sizeof(line), in)) {
+    const char *name = strstr(line, "{\"name\": \"");
+    const char *mean = strstr(line, "\"mean_ms\": ");
+    const char *stddev = strstr(line, "\"stddev_ms\": ");
+    const char *passes = strstr(line, "\"passes\": ");
+    if (!name || !mean || !stddev || !passes)
+      continue;
+    name += 10;
+    const char *end = strchr(name, '"');
+    for (int i = 0; end && i < n; ++i) {
+      if (strlen(results[i].name) == (size_t) (end - name) && !strncmp(results[i].name, name, end - name)) {
+        results[i].compared = 1;
+        results[i].baseMean = atof(mean + 11);
+        results[i].baseStddev = atof(stddev + 13);
+        results[i].basePasses = atoi(passes + 10);
+      }
+    }
+  }
+
+  fclose(in);
+  return 1;
+}
+
+
+// Returns how many scenarios got slower
+static int compareBaseline(BenchResult *results, int n, double threshold) {
+  int slower = 0;
+  for (int i = 0; i < n; ++i) {
+    BenchResult *r = &results[i];
+    if (!r->compared || r->baseMean <= 0 || r->basePasses < 1 || r->timing.passes < 1)
+      continue;
+
+    const BenchTiming *t = &r->timing;
+    const double diff = t->mean - r->baseMean;
+    const double stderrDiff = sqrt(t->stddev * t->stddev / t->passes + r->baseStddev * r->baseStddev / r->basePasses);
+    r->change = diff * 100.0 / r->baseMean;
+    if (fabs(r->change) <= threshold || fabs(diff) <= 2 * stderrDiff)
+      r->verdict = "same";
+    else if (diff > 0) {
+      r->verdict = "slower";
+      ++slower;
+    } else
+      r->verdict = "faster";
+  }
+  return slower;
+}
+
+
+static void writeResults(FILE *out, const BenchResult *results, int n, const Corpus *corpus, int passes) {
+  fprintf(out, "{\n  \"entries\": %d,\n  \"bytes\": %lu,\n  \"archive_bytes\": %lu,\n  \"passes\": %d,\n"
+               "  \"scenarios\": [\n", corpus->nEntries, (unsigned long) corpus->bytes,
+          (unsigned long) corpus->archiveBytes, passes);
+  for (int i = 0; i < n; ++i) {
+    const BenchResult *r = &results[i];
+    benchWriteTiming(out, r->name, &r->timing);
+    fprintf(out, ", \"bytes\": %lu, \"mb_per_s\": %.2f, \"cv_pct\": %.1f, \"checksum\": %ld", (unsigned long) r->bytes,
+            r->mbPerSec, r->timing.mean > 0 ? r->timing.stddev * 100.0 / r->timing.mean : 0.0, r->checksum);
+    if (r->verdict)
+      fprintf(out, ", \"baseline_mean_ms\": %.4f, \"change_pct\": %.1f, \"verdict\": \"%s\"", r->baseMean, r->change,
+              r->verdict);
+    fprintf(out, "}%s\n", i + 1 < n ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+
+int main(int argc, char* argv[]) {
+  int passes = 30;
+  double threshold = 5;
+  const char *outPath = NULL;
+  const char *baselinePath = NULL;
+  const char *tracePath = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--passes") && i + 1 < argc)
+      passes = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--baseline") && i + 1 < argc)
+      baselinePath = argv[++i];
+    else if (!strcmp(argv[i], "--threshold") && i + 1 < argc)
+      threshold = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--out") && i + 1 < argc)
+      outPath = argv[++i];
+    else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+      tracePath = argv[++i];
+    else
+      passes = 0;
+  }
+
+  if (passes < 2 || threshold < 0) {
+    fprintf(stderr, "Usage: %s [--passes N] [--baseline FILE] [--threshold PCT] [--out FILE] [--trace FILE]\n",
+            argv[0]);
+    return 1;
+  }
+
+  SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+  if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+    fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+    return 1;
+  }
+
+  const char* mounts[] = {"resource.zip"}; // No override dir, so results only depend on the archive
+  if (!XENO_initFilesystem(argv[0], mounts, 1)) {
+    fprintf(stderr, "initFilesystem failed! PhysFS error msg: %s\n", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    SDL_Quit();
+    return 1;
+  }
+
+  static Corpus corpus;
+  XENO_concatBasePath("resource.zip", &corpus.archive);
+  SDL_RWops *archive = SDL_RWFromFile(corpus.archive, "rb");
+  if (archive) {
+    corpus.archiveBytes = (size_t) SDL_RWsize(archive);
+    SDL_RWclose(archive);
+  }
+
+  SDL_Surface *target = SDL_CreateRGBSurfaceWithFormat(0, 64, 64, 32, SDL_PIXELFORMAT_ARGB8888);
+  corpus.renderer = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+  if (!corpus.renderer || !loadCorpus(&corpus)) {
+    fprintf(stderr, "Couldn't set up: %s\n", corpus.renderer ? "no entries found in resource.zip" : SDL_GetError());
+    PHYSFS_deinit();
+    SDL_Quit();
+    return 1;
+  }
+
+  const struct {
+    const char *name;
+    PrepareFn prepare;
+    ScenarioFn fn;
+    size_t bytes;
+  } scenarios[] = {
+    {"mount", unmountArchive, mountArchive, corpus.archiveBytes},
+    {"read_cold", remountArchive, readEntries, corpus.bytes},
+    {"read_warm", NULL, readEntries, corpus.bytes},
+    {"inflate", NULL, inflateEntries, corpus.bytes},
+    {"bmp_decode", NULL, decodeImages, corpus.imageBytes},
+    {"texture_create", NULL, createTextures, corpus.surfaceBytes},
+    {"xml_parse", NULL, parseDescriptors, corpus.xmlBytes}
+  };
+  BenchResult results[MAX_SCENARIOS];
+  const int nScenarios = (int) SDL_arraysize(scenarios);
+  int rv = 0;
+
+  for (int s = 0; s < nScenarios; ++s)
+    runScenario(&results[s], scenarios[s].name, scenarios[s].prepare, scenarios[s].fn, &corpus, scenarios[s].bytes,
+                passes);
+
+  if (baselinePath) {
+    if (!loadBaseline(baselinePath, results, nScenarios)) {
+      fprintf(stderr, "Couldn't read baseline '%s'\n", baselinePath);
+      rv = 1;
+    } else if (compareBaseline(results, nScenarios, threshold)) {
+      rv = 2;
+    }
+  }
+
+  FILE *out = outPath ? fopen(outPath, "w") : stdout;
+  if (out) {
+    writeResults(out, results, nScenarios, &corpus, passes);
+    if (out != stdout)
+      fclose(out);
+  } else {
+    fprintf(stderr, "Couldn't open '%s' for writing\n", outPath);
+    rv = 1;
+  }
+  if (tracePath && !XENO_exportTrace(tracePath)) {
+    fprintf(stderr, "Couldn't write trace '%s'\n", tracePath);
+    rv = 1;
+  }
+
+  for (int i = 0; i < corpus.nImages; ++i) {
+    XENO_free(corpus.imageData[i]);
+    SDL_FreeSurface(corpus.surfaces[i]);
+  }
+  for (int i = 0; i < corpus.nXML; ++i)
+    XENO_free(corpus.xmlData[i]);
+  free(corpus.buffer);
+  XENO_free(corpus.archive);
+  SDL_DestroyRenderer(corpus.renderer);
+  SDL_FreeSurface(target);
+  PHYSFS_deinit();
+  SDL_Quit();
+  return rv;
+}
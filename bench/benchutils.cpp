@@ -0,0 +1,80 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "benchutils.h"
+
+#include <SDL2/SDL.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+
+// Nearest rank: the smallest time at least 'pct' percent of passes took no longer than
+static double percentile(const double *sorted, int n, int pct) {
+  return sorted[(n * pct + 99) / 100 - 1];
+}
+
+
+/** Gets a timer ready for 'passes' passes. Returns 0 if it couldn't allocate. */
+int benchStartTimer(BenchTimer *timer, int passes) {
+  memset(timer, 0, sizeof(BenchTimer));
+  timer->passes = passes;
+  timer->times = (double *) malloc(sizeof(double) * (passes > 0 ? passes : 1));
+  return timer->times != NULL;
+}
+
+
+void benchBeginPass(BenchTimer *timer) {
+  timer->start = SDL_GetPerformanceCounter();
+}
+
+
+void benchEndPass(BenchTimer *timer) {
+  const Uint64 end = SDL_GetPerformanceCounter();
+  if (timer->n < timer->passes)
+    timer->times[timer->n++] = (end - timer->start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+
+/** Works out the mean, spread and percentiles of the passes timed, and frees the timer. */
+void benchFinishTimer(BenchTimer *timer, BenchTiming *timing) {
+  const int n = timer->n;
+  memset(timing, 0, sizeof(BenchTiming));
+  timing->passes = n;
+  if (n) {
+    for (int p = 0; p < n; ++p)
+      timing->mean += timer->times[p] / n;
+    for (int p = 0; p < n && n > 1; ++p)
+      timing->stddev += (timer->times[p] - timing->mean) * (timer->times[p] - timing->mean) / (n - 1);
+    timing->stddev = sqrt(timing->stddev);
+    qsort(timer->times, n, sizeof(double), compareDoubles);
+    timing->min = timer->times[0];
+    timing->p50 = percentile(timer->times, n, 50);
+    timing->p95 = percentile(timer->times, n, 95);
+    timing->p99 = percentile(timer->times, n, 99);
+  }
+  free(timer->times);
+  timer->times = NULL;
+}
+
+
+double benchMBPerSec(size_t bytes, const BenchTiming *timing) {
+  return timing->mean > 0 ? bytes / (1024.0 * 1024.0) / (timing->mean / 1000.0) : 0;
+}
+
+
+/** Starts a scenario's line of JSON with its name and timing. The caller adds its own
+ *  fields, each after a comma, and closes the object. */
+void benchWriteTiming(FILE *out, const char *name, const BenchTiming *timing) {
+  fprintf(out, "    {\"name\": \"%s\", \"passes\": %d, \"mean_ms\": %.4f, \"stddev_ms\": %.4f, \"min_ms\": %.4f, "
+               "\"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f",
+          name, timing->passes, timing->mean, timing->stddev, timing->min, timing->p50, timing->p95, timing->p99);
+}
@@ -0,0 +1,34 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_BENCHUTILS_H_
+#define _XENO_BENCHUTILS_H_
+
+// Timing shared by the benchmarks: each scenario times a number of passes
+// (or frames) and reports them as one line of JSON
+
+#include <SDL2/SDL_stdinc.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Milliseconds per pass
+typedef struct BenchTiming {
+  int passes;
+  double mean, stddev, min, p50, p95, p99;
+} BenchTiming;
+
+typedef struct BenchTimer {
+  double *times;
+  int passes, n;
+  Uint64 start;
+} BenchTimer;
+
+int benchStartTimer(BenchTimer *timer, int passes);
+void benchBeginPass(BenchTimer *timer);
+void benchEndPass(BenchTimer *timer);
+void benchFinishTimer(BenchTimer *timer, BenchTiming *timing);
+double benchMBPerSec(size_t bytes, const BenchTiming *timing);
+void benchWriteTiming(FILE *out, const char *name, const BenchTiming *timing);
+
+#endif //_XENO_BENCHUTILS_H_
@@ -0,0 +1,706 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// Headless render benchmark: scripted camera paths over generated iso and ortho
+// maps, drawn with the software renderer, reported as JSON. --hash folds every
+// frame's pixels into a digest, to check optimizations for rendering changes.
+// heap_allocs counts engine heap allocations after the first frame, which a
+// steady-state frame shouldn't make; per-frame scratch comes from a frame arena,
+// whose peak and overflows are reported too. Before the scenarios, a small arena
+// is overflowed and written past on purpose, to check it notices.
+// iso_cursor only moves a cursor (and edits a cell now and then) over a still view
+// on a window surface, redrawing just the dirty regions; pixels_per_frame is how
+// much of the screen that redraws on average, and idle_frames how many frames
+// presented nothing at all. iso_animated scatters animated cells (cycling arrows,
+// switch floors and doors flipped on and off) over a few chunks of a still view;
+// each frame should re-rasterize no more than the visible chunks holding them.
+//
+// Usage: renderbench [--frames N] [--size CELLS] [--budget MB] [--hash] [--out FILE]
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/fsutils.h>
+#include <xeno/imageutils.h>
+#include <xeno/tilemap.h>
+#include <xeno/tileset.h>
+#include <xeno/chunkcache.h>
+#include <xeno/framearena.h>
+#include <xeno/dirtyrects.h>
+#include <xeno/animation.h>
+#include "benchutils.h"
+
+#include <SDL2/SDL.h>
+#include <physfs.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int VIEW_WIDTH = 640;
+static const int VIEW_HEIGHT = 480;
+static const int MAX_TILESETS = 128;
+static const size_t ARENA_BYTES = 16 * 1024;
+static const int CURSOR_SIZE = 16;
+
+typedef struct BenchOptions {
+  int frames;
+  int size;
+  size_t budget;
+  int hash;
+  const char *out;
+} BenchOptions;
+
+typedef struct BenchResult {
+  char name[32];
+  BenchTiming timing; // Per frame
+  XENO_RenderStats stats;
+  uint32_t heapAllocs;
+  size_t arenaPeak;
+  uint32_t arenaOverflows;
+  int dirty;            // Scenario redraws dirty regions only, so these are filled in
+  double pixelsPerFrame;
+  int idleFrames, fullFrames;
+  int animated;         // Scenario runs timelines, so these are filled in
+  int animatedChunks, visibleAnimatedChunks;
+  double rasterizedPerFrame;
+  uint64_t maxRasterized; // In any frame after the first
+  uint64_t hash;
+} BenchResult;
+
+typedef struct CursorScene {
+  XENO_ChunkCache *cache;
+  XENO_TileMap *map;
+  SDL_Rect view, cursor;
+} CursorScene;
+
+
+// Fixed seed, so every run (and every platform) generates the same maps
+static uint32_t rngState;
+
+static uint32_t nextRandom(void) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+
+static uint64_t hashSurface(uint64_t hash, const SDL_Surface *surface) {
+  const Uint8 *row = (const Uint8 *) surface->pixels;
+  const int rowBytes = surface->w * surface->format->BytesPerPixel;
+  for (int y = 0; y < surface->h; ++y, row += surface->pitch) {
+    for (int x = 0; x < rowBytes; ++x) {
+      hash ^= row[x];
+      hash *= 0x100000001B3ull; // FNV-1a
+    }
+  }
+  return hash;
+}
+
+
+static int compareNames(const void *a, const void *b) {
+  return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+
+static int loadTilesets(SDL_Renderer *renderer, const char *dir, XENO_Tileset **tilesets) {
+  char **files = PHYSFS_enumerateFiles(dir);
+  int nFiles = 0, n = 0;
+  if (!files)
+    return 0;
+
+  while (files[nFiles])
+    ++nFiles;
+  qsort(files, nFiles, sizeof(char *), compareNames); // Enumeration order is up to the archiver
+
+  for (int i = 0; i < nFiles && n < MAX_TILESETS; ++i) {
+    size_t len = strlen(files[i]);
+    if (len < 4 || strcmp(files[i] + len - 4, ".xml"))
+      continue;
+
+    char path[256];
+    SDL_snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+    XENO_Tileset *tileset = XENO_loadTileset(renderer, path);
+    if (tileset)
+      tilesets[n++] = tileset;
+  }
+
+  PHYSFS_freeList(files);
+  return n;
+}
+
+
+// Adds every tileset to the map; firstIds[i] is the tile id of tilesets[i]'s first frame
+static int addTilesets(XENO_TileMap *map, XENO_Tileset **tilesets, int n, XENO_TileId *firstIds) {
+  for (int i = 0; i < n; ++i) {
+    firstIds[i] = XENO_addTilesetToMap(map, tilesets[i]);
+    if (!firstIds[i])
+      return 0;
+  }
+  return 1;
+}
+
+
+// Index of a named tileset, or -1 if it isn't loaded
+static int findTileset(XENO_Tileset **tilesets, int n, const char *name) {
+  for (int i = 0; i < n; ++i) {
+    if (!strcmp(tilesets[i]->name, name))
+      return i;
+  }
+  return -1;
+}
+
+
+// Picks a random frame (i.e. facing) of a named tileset, or 0 if it isn't loaded
+static XENO_TileId randomTile(XENO_Tileset **tilesets, const XENO_TileId *firstIds, int n, const char *name) {
+  const int i = findTileset(tilesets, n, name);
+  return i < 0 ? 0 : (XENO_TileId) (firstIds[i] + nextRandom() % tilesets[i]->nFrames);
+}
+
+
+// firstIds gets the tile id of each tileset's first frame, as from addTilesets
+static XENO_TileMap * generateMap(XENO_Projection projection, XENO_Tileset **tilesets, int n, int size,
+                                  XENO_TileId *firstIds) {
+  static const char *walls[] = {"block", "crate", "column", "fence", "blockHalf", "poleGroup"};
+  static const char *objects[] = {"arrow", "switchFloorOn", "switchFloorOff", "doorClosed", "ladder"};
+
+  if (!n)
+    return NULL;
+  XENO_TileMap *map = XENO_createTileMap(projection, size, size, tilesets[0]->canvasW, tilesets[0]->canvasH);
+  if (!map || !addTilesets(map, tilesets, n, firstIds)) {
+    XENO_destroyTileMap(map);
+    return NULL;
+  }
+
+  rngState = 0x2545F491;
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      uint32_t roll = nextRandom() % 100;
+      XENO_setCell(map, XENO_LAYER_GROUND, x, y, randomTile(tilesets, firstIds, n, roll < 5 ? "slab" : "floor"));
+
+      if (x == 0 || y == 0 || x == size - 1 || y == size - 1)
+        XENO_setCell(map, XENO_LAYER_WALL, x, y, randomTile(tilesets, firstIds, n, "wall"));
+      else if (roll >= 92)
+        XENO_setCell(map, XENO_LAYER_WALL, x, y, randomTile(tilesets, firstIds, n, walls[nextRandom() % SDL_arraysize(walls)]));
+      else if (roll >= 89)
+        XENO_setCell(map, XENO_LAYER_OBJECT, x, y, randomTile(tilesets, firstIds, n, objects[nextRandom() % SDL_arraysize(objects)]));
+    }
+  }
+
+  return map;
+}
+
+
+// Moves the view around a loop of waypoints inside the map, in integer steps
+static void cameraAt(const XENO_TileMap *map, int frame, int frames, SDL_Rect *view) {
+  SDL_Rect first, last;
+  XENO_getChunkBounds(map, 0, 0, &first);
+  XENO_getChunkBounds(map, map->chunksX - 1, map->chunksY - 1, &last);
+  const int left = SDL_min(first.x, last.x), top = first.y;
+  const int width = SDL_max(first.x + first.w, last.x + last.w) - left - VIEW_WIDTH;
+  const int height = last.y + last.h - top - VIEW_HEIGHT;
+  const int points[5][2] = {{1, 1}, {3, 1}, {3, 3}, {1, 3}, {1, 1}}; // In quarters of the map
+
+  int segment = frame * 4 / frames;
+  int t = frame * 4 % frames; // Progress through the segment, out of 'frames'
+  int x0 = points[segment][0] * width / 4, y0 = points[segment][1] * height / 4;
+  int x1 = points[segment + 1][0] * width / 4, y1 = points[segment + 1][1] * height / 4;
+
+  view->x = left + x0 + (int) ((int64_t) (x1 - x0) * t / frames);
+  view->y = top + y0 + (int) ((int64_t) (y1 - y0) * t / frames);
+  view->w = VIEW_WIDTH;
+  view->h = VIEW_HEIGHT;
+}
+
+
+static int runScenario(BenchResult *result, const char *name, SDL_Renderer *renderer, SDL_Surface *surface,
+                       XENO_TileMap *map, size_t budget, const BenchOptions *options) {
+  XENO_FrameArena *arena = XENO_createFrameArena(ARENA_BYTES, XENO_MEM_RENDER);
+  XENO_ChunkCache *cache = arena ? XENO_createChunkCache(renderer, map, budget, arena) : NULL;
+  BenchTimer timer;
+  if (!cache || !benchStartTimer(&timer, options->frames)) {
+    XENO_destroyChunkCache(cache);
+    XENO_destroyFrameArena(arena);
+    return 0;
+  }
+
+  SDL_Rect view, range, cells;
+  memset(result, 0, sizeof(BenchResult));
+  SDL_snprintf(result->name, sizeof(result->name), "%s", name);
+  result->hash = 0xCBF29CE484222325ull;
+  XENO_resetRenderStats();
+  rngState = 0x9E3779B9;
+
+  uint32_t allocs = 0;
+  for (int f = 0; f < options->frames; ++f) {
+    if (f == 1)
+      allocs = XENO_countHeapAllocs();
+    cameraAt(map, f, options->frames, &view);
+
+    // Knock out (or restore) a ground cell near the middle of the view now and then
+    if (f % 30 == 29) {
+      XENO_getChunkRange(map, &view, &range);
+      int x = (range.x + range.w / 2) * XENO_CHUNK_SIZE + (int) (nextRandom() % XENO_CHUNK_SIZE);
+      int y = (range.y + range.h / 2) * XENO_CHUNK_SIZE + (int) (nextRandom() % XENO_CHUNK_SIZE);
+      XENO_setCell(map, XENO_LAYER_GROUND, x, y, XENO_getCell(map, XENO_LAYER_GROUND, x, y) ? 0 : 1);
+    }
+
+    benchBeginPass(&timer);
+    XENO_beginFrameArena(arena);
+    SDL_RenderClear(renderer);
+    XENO_renderStaticLayers(cache, &view);
+    XENO_getChunkRange(map, &view, &range);
+    cells.x = range.x * XENO_CHUNK_SIZE;
+    cells.y = range.y * XENO_CHUNK_SIZE;
+    cells.w = range.w * XENO_CHUNK_SIZE;
+    cells.h = range.h * XENO_CHUNK_SIZE;
+    XENO_drawCells(renderer, map, XENO_LAYER_OBJECT, XENO_LAYER_OBJECT, &cells, -view.x, -view.y);
+    SDL_RenderPresent(renderer);
+    benchEndPass(&timer);
+
+    if (options->hash)
+      result->hash = hashSurface(result->hash, surface);
+  }
+
+  result->stats = XENO_renderStats;
+  if (options->frames > 1)
+    result->heapAllocs = XENO_countHeapAllocs() - allocs;
+  result->arenaPeak = arena->peak;
+  result->arenaOverflows = arena->overflows;
+  benchFinishTimer(&timer, &result->timing);
+
+  XENO_destroyChunkCache(cache);
+  XENO_destroyFrameArena(arena);
+  return 1;
+}
+
+
+// Redraws one dirty region of the cursor scenario; clipping keeps the work inside it
+static void drawCursorRegion(SDL_Renderer *renderer, const SDL_Rect *region, void *userdata) {
+  CursorScene *scene = (CursorScene *) userdata;
+  SDL_Rect world, range, cells;
+  world.x = scene->view.x + region->x;
+  world.y = scene->view.y + region->y;
+  world.w = region->w;
+  world.h = region->h;
+
+  XENO_renderStaticLayers(scene->cache, &scene->view);
+  XENO_getChunkRange(scene->map, &world, &range);
+  cells.x = range.x * XENO_CHUNK_SIZE;
+  cells.y = range.y * XENO_CHUNK_SIZE;
+  cells.w = range.w * XENO_CHUNK_SIZE;
+  cells.h = range.h * XENO_CHUNK_SIZE;
+  XENO_drawCells(renderer, scene->map, XENO_LAYER_OBJECT, XENO_LAYER_OBJECT, &cells, -scene->view.x, -scene->view.y);
+
+  if (SDL_HasIntersection(&scene->cursor, region)) {
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    SDL_RenderFillRect(renderer, &scene->cursor);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+  }
+}
+
+
+// The cursor moves for half of every second and rests for the other half, while the view stays put
+static int runCursorScenario(BenchResult *result, const char *name, SDL_Window *window, SDL_Renderer *renderer,
+                             XENO_TileMap *map, size_t budget, const BenchOptions *options) {
+  SDL_Surface *surface = SDL_GetWindowSurface(window);
+  XENO_FrameArena *arena = XENO_createFrameArena(ARENA_BYTES, XENO_MEM_RENDER);
+  CursorScene scene;
+  scene.map = map;
+  scene.cache = arena ? XENO_createChunkCache(renderer, map, budget, arena) : NULL;
+  BenchTimer timer;
+  if (!surface || !scene.cache || !benchStartTimer(&timer, options->frames)) {
+    XENO_destroyChunkCache(scene.cache);
+    XENO_destroyFrameArena(arena);
+    return 0;
+  }
+
+  XENO_DirtyRects dirty;
+  XENO_initDirtyRects(&dirty, surface->w, surface->h, 1);
+  memset(result, 0, sizeof(BenchResult));
+  SDL_snprintf(result->name, sizeof(result->name), "%s", name);
+  result->dirty = 1;
+  result->hash = 0xCBF29CE484222325ull;
+  XENO_resetRenderStats();
+  rngState = 0x9E3779B9;
+
+  cameraAt(map, 0, options->frames, &scene.view);
+  scene.cursor.x = scene.cursor.y = 0;
+  scene.cursor.w = scene.cursor.h = CURSOR_SIZE;
+
+  uint32_t allocs = 0;
+  uint64_t pixels = 0;
+  for (int f = 0; f < options->frames; ++f) {
+    if (f == 1)
+      allocs = XENO_countHeapAllocs();
+
+    benchBeginPass(&timer);
+    XENO_beginFrameArena(arena);
+    if (f % 60 < 30) {
+      SDL_Rect from = scene.cursor;
+      scene.cursor.x = (scene.cursor.x + 7) % (surface->w - CURSOR_SIZE);
+      scene.cursor.y = (scene.cursor.y + 5) % (surface->h - CURSOR_SIZE);
+      XENO_markSpriteMoved(&dirty, &from, &scene.cursor);
+    }
+
+    // Knock out (or restore) a ground cell near the middle of the view now and then
+    if (f % 60 == 45) {
+      SDL_Rect range;
+      XENO_getChunkRange(map, &scene.view, &range);
+      int x = (range.x + range.w / 2) * XENO_CHUNK_SIZE + (int) (nextRandom() % XENO_CHUNK_SIZE);
+      int y = (range.y + range.h / 2) * XENO_CHUNK_SIZE + (int) (nextRandom() % XENO_CHUNK_SIZE);
+      XENO_setCell(map, XENO_LAYER_GROUND, x, y, XENO_getCell(map, XENO_LAYER_GROUND, x, y) ? 0 : 1);
+    }
+    XENO_markMapDirty(&dirty, map, &scene.view);
+
+    const SDL_Rect *rects;
+    int n = XENO_getDirtyRects(&dirty, &rects);
+    for (int i = 0; i < n; ++i)
+      pixels += (uint64_t) rects[i].w * rects[i].h;
+    result->idleFrames += !n;
+    result->fullFrames += dirty.full;
+
+    XENO_renderDirty(renderer, &dirty, drawCursorRegion, &scene);
+    XENO_presentDirty(window, renderer, &dirty);
+    benchEndPass(&timer);
+
+    if (options->hash)
+      result->hash = hashSurface(result->hash, surface);
+  }
+
+  result->stats = XENO_renderStats;
+  if (options->frames > 1)
+    result->heapAllocs = XENO_countHeapAllocs() - allocs;
+  result->arenaPeak = arena->peak;
+  result->arenaOverflows = arena->overflows;
+  result->pixelsPerFrame = (double) pixels / options->frames;
+  benchFinishTimer(&timer, &result->timing);
+
+  XENO_destroyChunkCache(scene.cache);
+  XENO_destroyFrameArena(arena);
+  return 1;
+}
+
+
+// A state timeline over the first frames of two tilesets, e.g. {switchFloorOff, switchFloorOn}
+static XENO_TileId addStateTimeline(XENO_Animator *animator, XENO_Tileset **tilesets, const XENO_TileId *firstIds,
+                                    int n, const char *first, const char *second) {
+  int a = findTileset(tilesets, n, first), b = findTileset(tilesets, n, second);
+  if (a < 0 || b < 0)
+    return 0;
+  XENO_TileId frames[2] = {firstIds[a], firstIds[b]};
+  return XENO_addTimeline(animator, frames, 2, 0);
+}
+
+
+// Arrows cycle through their _1/_3/_5/_7 facings every 250 ms, switch floors flip every
+// second and doors every one and a half, all over a still view. Every third visible chunk
+// gets one of each on the static layers.
+static int runAnimatedScenario(BenchResult *result, const char *name, SDL_Renderer *renderer, SDL_Surface *surface,
+                               XENO_TileMap *map, XENO_Tileset **tilesets, const XENO_TileId *firstIds, int n,
+                               size_t budget, const BenchOptions *options) {
+  XENO_Animator *animator = XENO_createAnimator(map);
+  XENO_FrameArena *arena = XENO_createFrameArena(ARENA_BYTES, XENO_MEM_RENDER);
+  XENO_ChunkCache *cache = arena ? XENO_createChunkCache(renderer, map, budget, arena) : NULL;
+  int arrow = findTileset(tilesets, n, "arrow");
+  XENO_TileId arrowTile = 0, switchTile = 0, doorTile = 0;
+  if (animator && arrow >= 0) {
+    arrowTile = XENO_addTilesetTimeline(animator, tilesets[arrow], firstIds[arrow], 250);
+    switchTile = addStateTimeline(animator, tilesets, firstIds, n, "switchFloorOff", "switchFloorOn");
+    doorTile = addStateTimeline(animator, tilesets, firstIds, n, "doorClosed", "doorOpen");
+  }
+  BenchTimer timer;
+  if (!arrowTile || !switchTile || !doorTile || !cache || !benchStartTimer(&timer, options->frames)) {
+    XENO_destroyChunkCache(cache);
+    XENO_destroyFrameArena(arena);
+    XENO_destroyAnimator(animator);
+    return 0;
+  }
+
+  SDL_Rect view, range, cells;
+  memset(result, 0, sizeof(BenchResult));
+  SDL_snprintf(result->name, sizeof(result->name), "%s", name);
+  result->animated = 1;
+  result->hash = 0xCBF29CE484222325ull;
+  rngState = 0x9E3779B9;
+
+  cameraAt(map, 0, options->frames, &view);
+  XENO_getChunkRange(map, &view, &range);
+  for (int cy = range.y; cy < range.y + range.h; ++cy) {
+    for (int cx = range.x; cx < range.x + range.w; ++cx) {
+      if ((cx + cy) % 3)
+        continue;
+      const int x = cx * XENO_CHUNK_SIZE, y = cy * XENO_CHUNK_SIZE;
+      XENO_setCell(map, XENO_LAYER_GROUND, x + (int) (nextRandom() % XENO_CHUNK_SIZE),
+                   y + (int) (nextRandom() % XENO_CHUNK_SIZE), arrowTile);
+      XENO_setCell(map, XENO_LAYER_GROUND, x + (int) (nextRandom() % XENO_CHUNK_SIZE),
+                   y + (int) (nextRandom() % XENO_CHUNK_SIZE), switchTile);
+      XENO_setCell(map, XENO_LAYER_WALL, x + (int) (nextRandom() % XENO_CHUNK_SIZE),
+                   y + (int) (nextRandom() % XENO_CHUNK_SIZE), doorTile);
+    }
+  }
+  result->animatedChunks = map->nAnimatedChunks;
+  for (int a = 0; a < map->nAnimatedChunks; ++a) {
+    const int cx = map->animatedChunks[a] % map->chunksX, cy = map->animatedChunks[a] / map->chunksX;
+    result->visibleAnimatedChunks += cx >= range.x && cx < range.x + range.w && cy >= range.y && cy < range.y + range.h;
+  }
+  cells.x = range.x * XENO_CHUNK_SIZE;
+  cells.y = range.y * XENO_CHUNK_SIZE;
+  cells.w = range.w * XENO_CHUNK_SIZE;
+  cells.h = range.h * XENO_CHUNK_SIZE;
+
+  XENO_resetRenderStats();
+  uint32_t allocs = 0;
+  uint64_t firstRasterized = 0;
+  for (int f = 0; f < options->frames; ++f) {
+    if (f == 1) {
+      allocs = XENO_countHeapAllocs();
+      firstRasterized = XENO_renderStats.chunksRasterized;
+    }
+    const uint64_t rasterized = XENO_renderStats.chunksRasterized;
+
+    benchBeginPass(&timer);
+    XENO_beginFrameArena(arena);
+    XENO_updateAnimations(animator, (uint32_t) ((f + 1) * 1000 / 60 - f * 1000 / 60));
+    if (f % 60 == 59)
+      XENO_setTimelineFrame(animator, switchTile, f / 60 % 2 ? 0 : 1);
+    if (f % 90 == 89)
+      XENO_setTimelineFrame(animator, doorTile, f / 90 % 2 ? 0 : 1);
+    SDL_RenderClear(renderer);
+    XENO_renderStaticLayers(cache, &view);
+    XENO_drawCells(renderer, map, XENO_LAYER_OBJECT, XENO_LAYER_OBJECT, &cells, -view.x, -view.y);
+    SDL_RenderPresent(renderer);
+    benchEndPass(&timer);
+
+    if (f && XENO_renderStats.chunksRasterized - rasterized > result->maxRasterized)
+      result->maxRasterized = XENO_renderStats.chunksRasterized - rasterized;
+    if (options->hash)
+      result->hash = hashSurface(result->hash, surface);
+  }
+
+  result->stats = XENO_renderStats;
+  if (options->frames > 1) {
+    result->heapAllocs = XENO_countHeapAllocs() - allocs;
+    result->rasterizedPerFrame = (double) (XENO_renderStats.chunksRasterized - firstRasterized) / (options->frames - 1);
+  }
+  result->arenaPeak = arena->peak;
+  result->arenaOverflows = arena->overflows;
+  benchFinishTimer(&timer, &result->timing);
+
+  XENO_destroyChunkCache(cache);
+  XENO_destroyFrameArena(arena);
+  XENO_destroyAnimator(animator);
+
+  // Past the first frame, only chunks holding a timeline that moved should be redrawn
+  if (result->maxRasterized > (uint64_t) result->visibleAnimatedChunks) {
+    fprintf(stderr, "%s re-rasterized %llu chunks in a frame, but only %d visible chunks are animated\n", name,
+            (unsigned long long) result->maxRasterized, result->visibleAnimatedChunks);
+    return 0;
+  }
+  return 1;
+}
+
+
+// Overflows a small arena and writes a byte past two allocations, one from the buffer
+// and one from the heap; the arena should count both overflows and, in debug builds,
+// both overruns once the frame is recycled. Padding keeps the writes inside the memory
+// allocated, guard bytes or not.
+static int checkFrameArena(void) {
+  XENO_FrameArena *arena = XENO_createFrameArena(256, XENO_MEM_RENDER);
+  if (!arena)
+    return 0;
+
+  XENO_beginFrameArena(arena);
+  char *fits = (char *) XENO_frameAlloc(arena, 100);
+  char *spills = (char *) XENO_frameAlloc(arena, 200);
+  char *spillsToo = (char *) XENO_frameAlloc(arena, 300);
+  int ok = fits && spills && spillsToo;
+  if (ok) {
+    fits[100] = 0;
+    spills[200] = 0;
+  }
+  XENO_beginFrameArena(arena);
+  XENO_beginFrameArena(arena); // Recycles the first frame, checking it
+
+#ifndef NDEBUG
+  const uint32_t overruns = 2;
+#else
+  const uint32_t overruns = 0;
+#endif
+  if (ok && (arena->overflows != 2 || arena->overruns != overruns)) {
+    fprintf(stderr, "Frame arena counted %lu overflows and %lu overruns, expected 2 and %lu\n",
+            (unsigned long) arena->overflows, (unsigned long) arena->overruns, (unsigned long) overruns);
+    ok = 0;
+  }
+  XENO_destroyFrameArena(arena);
+  return ok;
+}
+
+
+static void writeResults(FILE *out, const BenchResult *results, int n, const BenchOptions *options, uint64_t setupBytes) {
+  fprintf(out, "{\n  \"view\": [%d, %d],\n  \"map_size\": %d,\n  \"frames\": %d,\n  \"budget_bytes\": %lu,\n"
+               "  \"setup_bytes_uploaded\": %llu,\n  \"scenarios\": [\n", VIEW_WIDTH, VIEW_HEIGHT, options->size,
+          options->frames, (unsigned long) options->budget, (unsigned long long) setupBytes);
+  for (int i = 0; i < n; ++i) {
+    const BenchResult *r = &results[i];
+    benchWriteTiming(out, r->name, &r->timing);
+    fprintf(out, ", \"draw_calls\": %llu, \"bytes_uploaded\": %llu, \"chunks_rasterized\": %llu, \"heap_allocs\": %lu"
+                 ", \"arena_peak\": %lu, \"arena_overflows\": %lu",
+            (unsigned long long) r->stats.drawCalls,
+            (unsigned long long) r->stats.bytesUploaded, (unsigned long long) r->stats.chunksRasterized,
+            (unsigned long) r->heapAllocs, (unsigned long) r->arenaPeak, (unsigned long) r->arenaOverflows);
+    if (r->dirty)
+      fprintf(out, ", \"pixels_per_frame\": %.1f, \"idle_frames\": %d, \"full_frames\": %d", r->pixelsPerFrame,
+              r->idleFrames, r->fullFrames);
+    if (r->animated)
+      fprintf(out, ", \"animated_chunks\": %d, \"visible_animated_chunks\": %d, \"chunks_rasterized_per_frame\": %.2f"
+                   ", \"max_chunks_rasterized\": %llu", r->animatedChunks, r->visibleAnimatedChunks,
+              r->rasterizedPerFrame, (unsigned long long) r->maxRasterized);
+    if (options->hash)
+      fprintf(out, ", \"hash\": \"%016llx\"", (unsigned long long) r->hash);
+    fprintf(out, "}%s\n", i + 1 < n ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+
+int main(int argc, char* argv[]) {
+  BenchOptions options = {300, 64, 32 * 1024 * 1024, 0, NULL};
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+      options.frames = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+      options.size = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--budget") && i + 1 < argc)
+      options.budget = (size_t) atoi(argv[++i]) * 1024 * 1024;
+    else if (!strcmp(argv[i], "--hash"))
+      options.hash = 1;
+    else if (!strcmp(argv[i], "--out") && i + 1 < argc)
+      options.out = argv[++i];
+    else
+      options.frames = 0;
+  }
+
+  if (options.frames < 1 || options.size < 1) {
+    fprintf(stderr, "Usage: %s [--frames N] [--size CELLS] [--budget MB] [--hash] [--out FILE]\n", argv[0]);
+    return 1;
+  }
+
+  // No window needed: the dummy driver satisfies SDL_Init, and the software
+  // renderer draws straight into a surface we own
+  SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+  if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+    fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+    return 1;
+  }
+
+  const char* mounts[] = {"resource.zip"}; // No override dir, so results only depend on the archive
+  if (!XENO_initFilesystem(argv[0], mounts, 1)) {
+    fprintf(stderr, "initFilesystem failed! PhysFS error msg: %s\n", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    SDL_Quit();
+    return 1;
+  }
+
+  SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, VIEW_WIDTH, VIEW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+  SDL_Renderer *renderer = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+  if (!renderer) {
+    fprintf(stderr, "Couldn't create software renderer: %s\n", SDL_GetError());
+    SDL_Quit();
+    return 1;
+  }
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+
+  if (!checkFrameArena()) {
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    SDL_Quit();
+    return 1;
+  }
+
+  static const struct {
+    const char *dir;
+    XENO_Projection projection;
+    const char *name;
+  } maps[] = {
+    {"tilesets/iso/prototype", XENO_PROJECTION_ISO, "iso"},
+    {"tilesets/ortho/prototype", XENO_PROJECTION_ORTHO, "ortho"}
+  };
+  BenchResult results[6];
+  int nResults = 0, rv = 0;
+  uint64_t setupBytes = 0;
+
+  for (size_t m = 0; m < SDL_arraysize(maps) && !rv; ++m) {
+    XENO_Tileset *tilesets[MAX_TILESETS];
+    XENO_TileId firstIds[MAX_TILESETS];
+    XENO_resetRenderStats();
+    int n = loadTilesets(renderer, maps[m].dir, tilesets);
+    setupBytes += XENO_renderStats.bytesUploaded;
+    XENO_TileMap *map = generateMap(maps[m].projection, tilesets, n, options.size, firstIds);
+    char name[32];
+
+    if (!map) {
+      fprintf(stderr, "Couldn't build the %s map from '%s'\n", maps[m].name, maps[m].dir);
+      rv = 1;
+    } else {
+      SDL_snprintf(name, sizeof(name), "%s_cached", maps[m].name);
+      rv = !runScenario(&results[nResults++], name, renderer, surface, map, options.budget, &options);
+      XENO_destroyTileMap(map);
+      map = generateMap(maps[m].projection, tilesets, n, options.size, firstIds); // Undo the edits
+      SDL_snprintf(name, sizeof(name), "%s_direct", maps[m].name);
+      rv = rv || !map || !runScenario(&results[nResults++], name, renderer, surface, map, 0, &options);
+      XENO_destroyTileMap(map);
+      if (maps[m].projection == XENO_PROJECTION_ISO && !rv) {
+        map = generateMap(maps[m].projection, tilesets, n, options.size, firstIds);
+        SDL_snprintf(name, sizeof(name), "%s_animated", maps[m].name);
+        rv = !map || !runAnimatedScenario(&results[nResults++], name, renderer, surface, map, tilesets, firstIds, n,
+                                          options.budget, &options);
+        XENO_destroyTileMap(map);
+      }
+    }
+
+    for (int i = 0; i < n; ++i)
+      XENO_destroyTileset(tilesets[i]);
+  }
+
+  // Partial presents need a window; the dummy driver gives it a plain software surface
+  SDL_Window *window = rv ? NULL : SDL_CreateWindow("renderbench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                                    VIEW_WIDTH, VIEW_HEIGHT, 0);
+  SDL_Surface *windowSurface = window ? SDL_GetWindowSurface(window) : NULL;
+  SDL_Renderer *windowRenderer = windowSurface ? SDL_CreateSoftwareRenderer(windowSurface) : NULL;
+  if (windowRenderer) {
+    XENO_Tileset *tilesets[MAX_TILESETS];
+    XENO_TileId firstIds[MAX_TILESETS];
+    SDL_SetRenderDrawColor(windowRenderer, 0, 0, 0, 0xFF);
+    int n = loadTilesets(windowRenderer, maps[0].dir, tilesets);
+    XENO_TileMap *map = generateMap(maps[0].projection, tilesets, n, options.size, firstIds);
+    rv = !map || !runCursorScenario(&results[nResults++], "iso_cursor", window, windowRenderer, map,
+                                    options.budget, &options);
+    XENO_destroyTileMap(map);
+    for (int i = 0; i < n; ++i)
+      XENO_destroyTileset(tilesets[i]);
+    SDL_DestroyRenderer(windowRenderer);
+  } else if (!rv) {
+    fprintf(stderr, "Couldn't create a window to render to: %s\n", SDL_GetError());
+    rv = 1;
+  }
+  SDL_DestroyWindow(window);
+
+  if (!rv) {
+    FILE *out = options.out ? fopen(options.out, "w") : stdout;
+    if (out) {
+      writeResults(out, results, nResults, &options, setupBytes);
+      if (out != stdout)
+        fclose(out);
+    } else {
+      fprintf(stderr, "Couldn't open '%s' for writing\n", options.out);
+      rv = 1;
+    }
+  }
+
+  SDL_DestroyRenderer(renderer);
+  SDL_FreeSurface(surface);
+  PHYSFS_deinit();
+  SDL_Quit();
+  return rv;
+}
@@ -0,0 +1,725 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+// XML loading benchmark: parses every tileset descriptor in resource.zip from
+// memory, over and over, in different ways, and reports time per pass,
+// throughput and heap allocations per pass as JSON. The walk_* scenarios
+// parse once and only time reading the frames back out. The large_* scenarios
+// parse generated multi-megabyte documents, to measure raw tokenizer speed.
+// The convert_* scenarios read a million numeric attributes from one document.
+// The batch_* scenarios read and parse the descriptors from resource.zip with
+// XENO_parseXMLBatch, on one worker and on one per core; the report gives the
+// core count and batch_parallel's speedup over batch_serial, which is only
+// meaningful with more than one core. The print_* scenarios
+// write the large text document back out, into memory and through a stream.
+// Before any of them, a descriptor is patched to a version with one <frame>
+// changed, one added and one removed, and xmlbench fails unless XENO_patchXML
+// keeps every other element and reports exactly those changes.
+//
+// Usage: xmlbench [--passes N] [--large-mb N] [--out FILE]
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/fsutils.h>
+#include <xeno/xmlbatch.h>
+#include <xeno/xmlpatch.h>
+#include "benchutils.h"
+
+#include <SDL2/SDL.h>
+#include <physfs.h>
+#include <tinyxml2.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace tinyxml2;
+
+static const int MAX_FILES = 512;
+
+typedef struct Corpus {
+  int nFiles;
+  char *data[MAX_FILES];
+  uint32_t length[MAX_FILES];
+  size_t bytes;
+  const char *paths[MAX_FILES];
+  char pathData[MAX_FILES][128];
+} Corpus;
+
+typedef struct BenchResult {
+  const char *name;
+  BenchTiming timing;
+  size_t bytes;
+  double mbPerSec;
+  double allocsPerPass;
+  long checksum;
+} BenchResult;
+
+// Scenarios run one pass over the corpus and return a checksum of what they read
+typedef long (*ScenarioFn)(const Corpus *corpus);
+
+
+static int compareNames(const void *a, const void *b) {
+  return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+
+static void loadCorpus(Corpus *corpus, const char *dir) {
+  char **files = PHYSFS_enumerateFiles(dir);
+  int nFiles = 0;
+  if (!files)
+    return;
+
+  while (files[nFiles])
+    ++nFiles;
+  qsort(files, nFiles, sizeof(char *), compareNames);
+
+  for (int i = 0; i < nFiles && corpus->nFiles < MAX_FILES; ++i) {
+    size_t len = strlen(files[i]);
+    if (len < 4 || strcmp(files[i] + len - 4, ".xml"))
+      continue;
+
+    char *path = corpus->pathData[corpus->nFiles];
+    char *data = NULL;
+    SDL_snprintf(path, sizeof(corpus->pathData[0]), "%s/%s", dir, files[i]);
+    uint32_t length = XENO_readFile(path, &data);
+    if (length) {
+      corpus->paths[corpus->nFiles] = path;
+      corpus->data[corpus->nFiles] = data;
+      corpus->length[corpus->nFiles++] = length;
+      corpus->bytes += length;
+    }
+  }
+
+  PHYSFS_freeList(files);
+}
+
+
+// Appends 'line' to the buffer until it holds at least 'bytes', between an open and close tag
+static void makeLargeDoc(Corpus *corpus, size_t bytes, const char *line) {
+  const size_t lineLen = strlen(line);
+  const size_t nLines = bytes / lineLen + 1;
+  char *data = (char *) malloc(nLines * lineLen + 32);
+  if (!data)
+    return;
+
+  char *p = data;
+  memcpy(p, "<doc>\n", 6);
+  p += 6;
+  for (size_t i = 0; i < nLines; ++i, p += lineLen)
+    memcpy(p, line, lineLen);
+  memcpy(p, "</doc>\n", 7);
+  p += 7;
+
+  corpus->data[corpus->nFiles] = data;
+  corpus->length[corpus->nFiles++] = (uint32_t) (p - data);
+  corpus->bytes += p - data;
+}
+
+
+// Every value in the tree, so text and attributes get their entities and whitespace processed
+static long visitAll(const XMLNode *node) {
+  long sum = 0;
+  for (const XMLNode *child = node->FirstChild(); child; child = child->NextSibling()) {
+    sum += strlen(child->Value());
+    const XMLElement *element = child->ToElement();
+    if (element) {
+      for (const XMLAttribute *a = element->FirstAttribute(); a; a = a->Next())
+        sum += strlen(a->Value());
+      sum += visitAll(element);
+    }
+  }
+  return sum;
+}
+
+
+static long parseLarge(const Corpus *corpus) {
+  static XMLArena arena(1024 * 1024);
+  static XMLDocument doc;
+  long sum = 0;
+  if (!doc.Arena())
+    doc.SetArena(&arena);
+  for (int i = 0; i < corpus->nFiles; ++i) {
+    doc.Parse(corpus->data[i], corpus->length[i]);
+    sum += visitAll(&doc) + doc.ErrorID();
+  }
+  return sum;
+}
+
+
+static long parseLargeCollapsed(const Corpus *corpus) {
+  static XMLArena arena(1024 * 1024);
+  static XMLDocument doc(true, COLLAPSE_WHITESPACE);
+  long sum = 0;
+  if (!doc.Arena())
+    doc.SetArena(&arena);
+  for (int i = 0; i < corpus->nFiles; ++i) {
+    doc.Parse(corpus->data[i], corpus->length[i]);
+    sum += visitAll(&doc) + doc.ErrorID();
+  }
+  return sum;
+}
+
+
+// Four numbers per element, two ints and two floats, the way descriptors store rectangles
+static const char numberLine[] = "  <f x=\"1234\" y=\"-567\" w=\"12.5\" h=\"0.375\"/>\n";
+static const int NUMBER_ELEMENTS = 250000;
+
+static const XMLDocument * parsedNumbers(const Corpus *corpus) {
+  static XMLArena arena(1024 * 1024);
+  static XMLDocument doc;
+  if (!doc.Arena()) {
+    doc.SetArena(&arena);
+    doc.Parse(corpus->data[0], corpus->length[0]);
+  }
+  return &doc;
+}
+
+
+static long convertSscanf(const Corpus *corpus) {
+  const XMLElement *root = parsedNumbers(corpus)->RootElement();
+  long sum = 0;
+  for (const XMLElement *e = root ? root->FirstChildElement() : NULL; e; e = e->NextSiblingElement()) {
+    int i = 0;
+    for (const XMLAttribute *a = e->FirstAttribute(); a; a = a->Next(), ++i) {
+      int iv = 0;
+      float fv = 0;
+      if (i < 2 && sscanf(a->Value(), "%d", &iv) == 1)
+        sum += iv;
+      else if (i >= 2 && sscanf(a->Value(), "%f", &fv) == 1)
+        sum += (long) (fv * 8);
+    }
+  }
+  return sum;
+}
+
+
+static long convertFast(const Corpus *corpus) {
+  const XMLElement *root = parsedNumbers(corpus)->RootElement();
+  long sum = 0;
+  for (const XMLElement *e = root ? root->FirstChildElement() : NULL; e; e = e->NextSiblingElement()) {
+    int i = 0;
+    for (const XMLAttribute *a = e->FirstAttribute(); a; a = a->Next(), ++i) {
+      int iv = 0;
+      float fv = 0;
+      if (i < 2 && a->QueryIntValue(&iv) == XML_SUCCESS)
+        sum += iv;
+      else if (i >= 2 && a->QueryFloatValue(&fv) == XML_SUCCESS)
+        sum += (long) (fv * 8);
+    }
+  }
+  return sum;
+}
+
+
+// What a loader reads from a descriptor: every frame rectangle
+static long sumFrames(const XMLDocument &doc) {
+  long sum = 0;
+  const XMLElement *tiles = doc.FirstChildElement("tileset");
+  tiles = tiles ? tiles->FirstChildElement("tiles") : NULL;
+  if (!tiles)
+    return 0;
+  for (const XMLElement *tile = tiles->FirstChildElement("tile"); tile; tile = tile->NextSiblingElement("tile")) {
+    const XMLElement *frame = tile->FirstChildElement("frame");
+    if (frame)
+      sum += frame->IntAttribute("x") + frame->IntAttribute("y") + frame->IntAttribute("w") + frame->IntAttribute("h");
+  }
+  return sum;
+}
+
+
+// A fresh document per file, as the loaders used to do
+static long parseFreshDocs(const Corpus *corpus) {
+  long sum = 0;
+  for (int i = 0; i < corpus->nFiles; ++i) {
+    XMLDocument doc;
+    doc.SetUnquotedAttributes(true);
+    doc.Parse(corpus->data[i], corpus->length[i]);
+    sum += sumFrames(doc);
+  }
+  return sum;
+}
+
+
+static long parseReusedDoc(const Corpus *corpus) {
+  static XMLDocument doc;
+  long sum = 0;
+  doc.SetUnquotedAttributes(true);
+  for (int i = 0; i < corpus->nFiles; ++i) {
+    doc.Parse(corpus->data[i], corpus->length[i]);
+    sum += sumFrames(doc);
+  }
+  return sum;
+}
+
+
+static long parseArenaDoc(const Corpus *corpus) {
+  static XMLArena arena;
+  static XMLDocument doc;
+  long sum = 0;
+  if (!doc.Arena())
+    doc.SetArena(&arena);
+  doc.SetUnquotedAttributes(true);
+  for (int i = 0; i < corpus->nFiles; ++i) {
+    doc.Parse(corpus->data[i], corpus->length[i]);
+    sum += sumFrames(doc);
+  }
+  return sum;
+}
+
+
+// The same walk as sumFrames, matching names by atom instead of strcmp
+typedef struct FrameAtoms {
+  XMLAtom tileset, tiles, tile, frame, x, y, w, h;
+} FrameAtoms;
+
+
+static int atomIntAttribute(const XMLElement *element, XMLAtom atom) {
+  const XMLAttribute *a = element->FindAttribute(atom);
+  return a ? a->IntValue() : 0;
+}
+
+
+static const XMLElement * firstChildAtom(const XMLNode *node, XMLAtom atom) {
+  for (const XMLElement *e = node->FirstChildElement(); e; e = e->NextSiblingElement()) {
+    if (e->Atom() == atom)
+      return e;
+  }
+  return NULL;
+}
+
+
+static long sumFramesByAtom(const XMLDocument &doc, const FrameAtoms *atoms) {
+  long sum = 0;
+  const XMLElement *tiles = firstChildAtom(&doc, atoms->tileset);
+  tiles = tiles ? firstChildAtom(tiles, atoms->tiles) : NULL;
+  if (!tiles)
+    return 0;
+  for (const XMLElement *tile = tiles->FirstChildElement(); tile; tile = tile->NextSiblingElement()) {
+    if (tile->Atom() != atoms->tile)
+      continue;
+    const XMLElement *frame = firstChildAtom(tile, atoms->frame);
+    if (frame)
+      sum += atomIntAttribute(frame, atoms->x) + atomIntAttribute(frame, atoms->y) +
+             atomIntAttribute(frame, atoms->w) + atomIntAttribute(frame, atoms->h);
+  }
+  return sum;
+}
+
+
+// Arena document sharing one atom table across every file
+static long parseAtomDoc(const Corpus *corpus) {
+  static XMLArena arena;
+  static XMLAtomTable table;
+  static XMLDocument doc;
+  static FrameAtoms atoms;
+  long sum = 0;
+  if (!doc.Arena()) {
+    doc.SetArena(&arena);
+    doc.SetAtomTable(&table);
+    atoms.tileset = table.Intern("tileset");
+    atoms.tiles = table.Intern("tiles");
+    atoms.tile = table.Intern("tile");
+    atoms.frame = table.Intern("frame");
+    atoms.x = table.Intern("x");
+    atoms.y = table.Intern("y");
+    atoms.w = table.Intern("w");
+    atoms.h = table.Intern("h");
+  }
+  doc.SetUnquotedAttributes(true);
+  for (int i = 0; i < corpus->nFiles; ++i) {
+    doc.Parse(corpus->data[i], corpus->length[i]);
+    sum += sumFramesByAtom(doc, &atoms);
+  }
+  return sum;
+}
+
+
+// The corpus parsed once, for the scenarios that only time lookups
+static XMLAtomTable corpusAtoms;
+
+static const XMLDocument * parsedCorpus(const Corpus *corpus) {
+  static XMLDocument *docs = NULL;
+  if (!docs) {
+    docs = new XMLDocument[corpus->nFiles];
+    for (int i = 0; i < corpus->nFiles; ++i) {
+      docs[i].SetUnquotedAttributes(true);
+      docs[i].SetAtomTable(&corpusAtoms);
+      docs[i].Parse(corpus->data[i], corpus->length[i]);
+    }
+  }
+  return docs;
+}
+
+
+static long walkChains(const Corpus *corpus) {
+  const XMLDocument *docs = parsedCorpus(corpus);
+  long sum = 0;
+  for (int i = 0; i < corpus->nFiles; ++i)
+    sum += sumFrames(docs[i]);
+  return sum;
+}
+
+
+static long walkPaths(const Corpus *corpus) {
+  static const char *sources[] = {
+    "tileset/tiles/tile/frame@x",
+    "tileset/tiles/tile/frame@y",
+    "tileset/tiles/tile/frame@w",
+    "tileset/tiles/tile/frame@h"
+  };
+  static XMLPath paths[SDL_arraysize(sources)];
+  if (!paths[0].Compiled()) {
+    for (size_t p = 0; p < SDL_arraysize(sources); ++p)
+      paths[p].Compile(sources[p], &corpusAtoms);
+  }
+  const XMLDocument *docs = parsedCorpus(corpus);
+  int values[1024];
+  long sum = 0;
+  for (int i = 0; i < corpus->nFiles; ++i) {
+    for (size_t p = 0; p < SDL_arraysize(paths); ++p) {
+      int n = paths[p].QueryInts(&docs[i], values, (int) SDL_arraysize(values));
+      for (int v = 0; v < n; ++v)
+        sum += values[v];
+    }
+  }
+  return sum;
+}
+
+
+// One walk for the frames, then each rectangle read by atom
+static long walkSelect(const Corpus *corpus) {
+  static XMLPath path;
+  static FrameAtoms atoms;
+  if (!path.Compiled()) {
+    path.Compile("tileset/tiles/tile/frame", &corpusAtoms);
+    atoms.x = corpusAtoms.Intern("x");
+    atoms.y = corpusAtoms.Intern("y");
+    atoms.w = corpusAtoms.Intern("w");
+    atoms.h = corpusAtoms.Intern("h");
+  }
+  const XMLDocument *docs = parsedCorpus(corpus);
+  const XMLElement *frames[256];
+  long sum = 0;
+  for (int i = 0; i < corpus->nFiles; ++i) {
+    int n = path.Select(&docs[i], frames, (int) SDL_arraysize(frames));
+    for (int f = 0; f < n; ++f)
+      sum += atomIntAttribute(frames[f], atoms.x) + atomIntAttribute(frames[f], atoms.y) +
+             atomIntAttribute(frames[f], atoms.w) + atomIntAttribute(frames[f], atoms.h);
+  }
+  return sum;
+}
+
+
+// Parsed once; the print scenarios only time writing it back out
+static const XMLDocument * parsedText(const Corpus *corpus) {
+  static XMLArena arena(1024 * 1024);
+  static XMLDocument doc;
+  if (!doc.Arena()) {
+    doc.SetArena(&arena);
+    doc.Parse(corpus->data[0], corpus->length[0]);
+  }
+  return &doc;
+}
+
+
+static long printMemory(const Corpus *corpus) {
+  XMLPrinter printer;
+  parsedText(corpus)->Print(&printer);
+  return printer.CStrSize() - 1; // Less the terminator
+}
+
+
+// Stands in for a file, so only the printer is measured
+class CountingStream : public XMLOutputStream {
+public:
+  CountingStream() : bytes(0) {}
+  virtual bool Write(const char *data, int size) {
+    bytes += size;
+    return true;
+  }
+  long bytes;
+};
+
+static long printStream(const Corpus *corpus) {
+  CountingStream stream;
+  XMLPrinter printer(stream);
+  parsedText(corpus)->Print(&printer);
+  return stream.bytes;
+}
+
+
+static XENO_XMLBatch *serialBatch, *parallelBatch;
+
+static void sumBatchFrames(int index, const char *path, const XMLDocument *doc, void *userdata) {
+  if (doc && !doc->Error())
+    SDL_AtomicAdd((SDL_atomic_t *) userdata, (int) sumFrames(*doc));
+}
+
+
+static long parseBatch(XENO_XMLBatch *batch, const Corpus *corpus, XENO_XMLBatchOrder order) {
+  SDL_atomic_t sum;
+  SDL_AtomicSet(&sum, 0);
+  if (batch)
+    XENO_parseXMLBatch(batch, corpus->paths, corpus->nFiles, order, sumBatchFrames, &sum);
+  return SDL_AtomicGet(&sum);
+}
+
+
+static long parseBatchSerial(const Corpus *corpus) {
+  return parseBatch(serialBatch, corpus, XENO_XML_IN_ORDER);
+}
+
+
+static long parseBatchParallel(const Corpus *corpus) {
+  return parseBatch(parallelBatch, corpus, XENO_XML_AS_COMPLETED);
+}
+
+
+static long parseBatchParallelOrdered(const Corpus *corpus) {
+  return parseBatch(parallelBatch, corpus, XENO_XML_IN_ORDER);
+}
+
+
+// Whether the set holds a change of this type to this element, with these flags
+static bool hasChange(const XENO_XMLChangeSet *changes, XENO_XMLChangeType type, const XMLElement *element,
+                      const XMLNode *parent, int what) {
+  for (int i = 0; i < changes->nChanges; ++i) {
+    const XENO_XMLChange *c = &changes->changes[i];
+    if (c->type == type && c->element == element && c->parent == parent && c->what == what)
+      return true;
+  }
+  return false;
+}
+
+
+// Patches a descriptor with at least four tiles: the first tile's frame moves, the second
+// gets another frame and the third loses its own. Returns false if anything else changed,
+// or any element that should have kept its identity didn't.
+static bool checkPatch(const char *data, uint32_t length) {
+  XMLDocument live, next;
+  live.SetUnquotedAttributes(true);
+  live.Parse(data, length);
+  XMLElement *tiles = live.FirstChildElement("tileset") ? live.FirstChildElement("tileset")->FirstChildElement("tiles") : NULL;
+  XMLElement *tile[4], *frame[4];
+  XMLElement *t = tiles ? tiles->FirstChildElement("tile") : NULL;
+  for (int i = 0; i < 4; ++i, t = t ? t->NextSiblingElement("tile") : NULL) {
+    tile[i] = t;
+    frame[i] = t ? t->FirstChildElement("frame") : NULL;
+    if (!frame[i]) {
+      fprintf(stderr, "checkPatch: descriptor needs four tiles with frames\n");
+      return false;
+    }
+  }
+
+  live.DeepCopy(&next);
+  XMLElement *nextTile = next.FirstChildElement("tileset")->FirstChildElement("tiles")->FirstChildElement("tile");
+  nextTile->FirstChildElement("frame")->SetAttribute("x", 999);
+  nextTile = nextTile->NextSiblingElement("tile");
+  XMLElement *added = next.NewElement("frame");
+  added->SetAttribute("x", 1);
+  nextTile->InsertAfterChild(nextTile->FirstChildElement("frame"), added);
+  nextTile = nextTile->NextSiblingElement("tile");
+  nextTile->DeleteChild(nextTile->FirstChildElement("frame"));
+
+  XENO_XMLChangeSet changes;
+  memset(&changes, 0, sizeof(changes));
+  bool ok = XENO_patchXML(&live, &next, &changes);
+
+  // Every tile and the frames that weren't removed are the same elements, still in place
+  t = tiles->FirstChildElement("tile");
+  for (int i = 0; i < 4 && ok; ++i, t = t ? t->NextSiblingElement("tile") : NULL)
+    ok = t == tile[i] && (i == 2 || t->FirstChildElement("frame") == frame[i]);
+  XMLElement *addedLive = ok ? frame[1]->NextSiblingElement("frame") : NULL;
+  ok = ok && addedLive && addedLive->IntAttribute("x") == 1 && frame[0]->IntAttribute("x") == 999
+       && !tile[2]->FirstChildElement("frame") && changes.nChanges == 5
+       && hasChange(&changes, XENO_XML_ELEMENT_CHANGED, frame[0], tile[0], XENO_XML_ATTRIBUTES_CHANGED)
+       && hasChange(&changes, XENO_XML_ELEMENT_ADDED, addedLive, tile[1], 0)
+       && hasChange(&changes, XENO_XML_ELEMENT_CHANGED, tile[1], tiles, XENO_XML_CHILDREN_CHANGED)
+       && hasChange(&changes, XENO_XML_ELEMENT_REMOVED, frame[2], tile[2], 0)
+       && hasChange(&changes, XENO_XML_ELEMENT_CHANGED, tile[2], tiles, XENO_XML_CHILDREN_CHANGED);
+
+  if (!ok) {
+    fprintf(stderr, "checkPatch: patching gave %d changes:\n", changes.nChanges);
+    for (int i = 0; i < changes.nChanges; ++i)
+      fprintf(stderr, "  type %d, what %d, <%s>\n", (int) changes.changes[i].type, changes.changes[i].what,
+              changes.changes[i].element->Name());
+  }
+  XENO_clearXMLChanges(&changes);
+  return ok;
+}
+
+
+static void runScenario(BenchResult *result, const char *name, ScenarioFn fn, const Corpus *corpus, int passes) {
+  BenchTimer timer;
+  memset(result, 0, sizeof(BenchResult));
+  result->name = name;
+  result->bytes = corpus->bytes;
+  result->checksum = fn(corpus); // Warm up caches and any reused storage
+  if (!benchStartTimer(&timer, passes))
+    return;
+
+  uint32_t allocs = XENO_countHeapAllocs();
+  for (int p = 0; p < passes; ++p) {
+    benchBeginPass(&timer);
+    fn(corpus);
+    benchEndPass(&timer);
+  }
+  result->allocsPerPass = (double) (XENO_countHeapAllocs() - allocs) / passes;
+
+  benchFinishTimer(&timer, &result->timing);
+  result->mbPerSec = benchMBPerSec(corpus->bytes, &result->timing);
+}
+
+
+static const BenchResult * findResult(const BenchResult *results, int n, const char *name) {
+  for (int i = 0; i < n; ++i) {
+    if (!strcmp(results[i].name, name))
+      return &results[i];
+  }
+  return NULL;
+}
+
+
+static void writeResults(FILE *out, const BenchResult *results, int n, const Corpus *corpus, int passes) {
+  const BenchResult *serial = findResult(results, n, "batch_serial");
+  const BenchResult *parallel = findResult(results, n, "batch_parallel");
+  const double speedup = serial && parallel && parallel->timing.mean > 0 ? serial->timing.mean / parallel->timing.mean : 0;
+  fprintf(out, "{\n  \"files\": %d,\n  \"bytes\": %lu,\n  \"passes\": %d,\n  \"cpus\": %d,\n  \"batch_workers\": %d,\n"
+               "  \"batch_speedup\": %.2f,\n  \"scenarios\": [\n", corpus->nFiles, (unsigned long) corpus->bytes, passes,
+          SDL_GetCPUCount(), parallelBatch ? parallelBatch->nWorkers : 0, speedup);
+  for (int i = 0; i < n; ++i) {
+    const BenchResult *r = &results[i];
+    benchWriteTiming(out, r->name, &r->timing);
+    fprintf(out, ", \"bytes\": %lu, \"mb_per_s\": %.2f, \"allocs_per_pass\": %.1f, \"checksum\": %ld}%s\n",
+            (unsigned long) r->bytes, r->mbPerSec, r->allocsPerPass, r->checksum, i + 1 < n ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+
+int main(int argc, char* argv[]) {
+  int passes = 200;
+  int largeMB = 4;
+  const char *outPath = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--passes") && i + 1 < argc)
+      passes = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--large-mb") && i + 1 < argc)
+      largeMB = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--out") && i + 1 < argc)
+      outPath = argv[++i];
+    else
+      passes = 0;
+  }
+
+  if (passes < 1 || largeMB < 1) {
+    fprintf(stderr, "Usage: %s [--passes N] [--large-mb N] [--out FILE]\n", argv[0]);
+    return 1;
+  }
+
+  const char* mounts[] = {"resource.zip"};
+  if (!XENO_initFilesystem(argv[0], mounts, 1)) {
+    fprintf(stderr, "initFilesystem failed! PhysFS error msg: %s\n", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    return 1;
+  }
+
+  static Corpus corpus;
+  loadCorpus(&corpus, "tilesets/iso/prototype");
+  loadCorpus(&corpus, "tilesets/ortho/prototype");
+  if (!corpus.nFiles) {
+    fprintf(stderr, "No tileset descriptors found in resource.zip\n");
+    PHYSFS_deinit();
+    return 1;
+  }
+
+  int patched = 0;
+  for (int i = 0; i < corpus.nFiles && !patched; ++i) {
+    if (!strcmp(corpus.paths[i], "tilesets/iso/prototype/arrow.xml"))
+      patched = checkPatch(corpus.data[i], corpus.length[i]) ? 1 : -1;
+  }
+  if (patched <= 0) {
+    if (!patched)
+      fprintf(stderr, "No tilesets/iso/prototype/arrow.xml to check patching with\n");
+    PHYSFS_deinit();
+    return 1;
+  }
+
+  // Indented, attribute-heavy markup, and long text runs with entities and line breaks
+  static Corpus markup, text, numbers;
+  makeLargeDoc(&markup, (size_t) largeMB << 20,
+               "    <tile id=\"floor_12.png\" x=\"128\" y=\"37\" w=\"50\" h=\"36\" rotated=\"false\"/>\n");
+  makeLargeDoc(&text, (size_t) largeMB << 20,
+               "    <p>The quick brown fox jumps over the lazy dog &amp; keeps   running\n"
+               "       past the river, where the      water is cold.</p>\n");
+  makeLargeDoc(&numbers, NUMBER_ELEMENTS * (sizeof(numberLine) - 1) - 1, numberLine);
+  if (!markup.nFiles || !text.nFiles || !numbers.nFiles) {
+    fprintf(stderr, "Could not allocate the large documents\n");
+    PHYSFS_deinit();
+    return 1;
+  }
+
+  serialBatch = XENO_createXMLBatch(1, XENO_XML_UNQUOTED_ATTRIBUTES);
+  parallelBatch = XENO_createXMLBatch(0, XENO_XML_UNQUOTED_ATTRIBUTES);
+  if (!serialBatch || !parallelBatch) {
+    fprintf(stderr, "Could not create the XML batches\n");
+    XENO_destroyXMLBatch(serialBatch);
+    XENO_destroyXMLBatch(parallelBatch);
+    PHYSFS_deinit();
+    return 1;
+  }
+
+  const int largePasses = SDL_max(passes / 20, 3);
+  const struct {
+    const char *name;
+    ScenarioFn fn;
+    const Corpus *corpus;
+    int passes;
+  } scenarios[] = {
+    {"dom_fresh", parseFreshDocs, &corpus, passes},
+    {"dom_reused", parseReusedDoc, &corpus, passes},
+    {"dom_arena", parseArenaDoc, &corpus, passes},
+    {"dom_atoms", parseAtomDoc, &corpus, passes},
+    {"walk_chains", walkChains, &corpus, passes},
+    {"walk_paths", walkPaths, &corpus, passes},
+    {"walk_select", walkSelect, &corpus, passes},
+    {"large_markup", parseLarge, &markup, largePasses},
+    {"large_text", parseLarge, &text, largePasses},
+    {"large_text_collapsed", parseLargeCollapsed, &text, largePasses},
+    {"convert_sscanf", convertSscanf, &numbers, largePasses},
+    {"convert_fast", convertFast, &numbers, largePasses},
+    {"print_memory", printMemory, &text, largePasses},
+    {"print_stream", printStream, &text, largePasses},
+    {"batch_serial", parseBatchSerial, &corpus, passes},
+    {"batch_parallel", parseBatchParallel, &corpus, passes},
+    {"batch_parallel_ordered", parseBatchParallelOrdered, &corpus, passes}
+  };
+  BenchResult results[SDL_arraysize(scenarios)];
+  int rv = 0;
+
+  for (size_t s = 0; s < SDL_arraysize(scenarios); ++s)
+    runScenario(&results[s], scenarios[s].name, scenarios[s].fn, scenarios[s].corpus, scenarios[s].passes);
+  if (parallelBatch->nWorkers < 2)
+    fprintf(stderr, "Only one core, so batch_parallel runs on one worker and measures no speedup\n");
+
+  FILE *out = outPath ? fopen(outPath, "w") : stdout;
+  if (out) {
+    writeResults(out, results, (int) SDL_arraysize(scenarios), &corpus, passes);
+    if (out != stdout)
+      fclose(out);
+  } else {
+    fprintf(stderr, "Couldn't open '%s' for writing\n", outPath);
+    rv = 1;
+  }
+
+  for (int i = 0; i < corpus.nFiles; ++i)
+    XENO_free(corpus.data[i]);
+  free(markup.data[0]);
+  free(text.data[0]);
+  free(numbers.data[0]);
+  XENO_destroyXMLBatch(serialBatch);
+  XENO_destroyXMLBatch(parallelBatch);
+  PHYSFS_deinit();
+  return rv;
+}
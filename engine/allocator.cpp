@@ -0,0 +1,371 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/memtrack.h>
+#include <SDL2/SDL.h>
+#include <physfs.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// Every block starts with its size, tag and allocation site. 16 bytes keeps what
+// the caller gets as aligned as malloc's own.
+typedef union XENO_MemHeader {
+  struct {
+    size_t size;
+    int tag;
+    int site; // From XENO_trackAlloc in MEMTRACK=y builds
+  } info;
+  char align[16];
+} XENO_MemHeader;
+
+typedef struct XENO_MemTagState {
+  SDL_SpinLock lock;
+  XENO_MemStats stats;
+  SDL_bool overBudget; // Warned about, until it drops back under
+} XENO_MemTagState;
+
+static XENO_MemTagState XENO_memTags[XENO_MEM_TAG_COUNT];
+
+static const char * const XENO_memTagNames[XENO_MEM_TAG_COUNT] = {
+  "general", "filesystem", "xml", "images", "render", "game"
+};
+
+// Each thread's current tag, created the first time one is set
+static SDL_TLSID XENO_memTagTLS;
+static SDL_SpinLock XENO_memTagTLSLock;
+
+// Live bytes across every tag, against the watermark and the simulated cap
+static size_t XENO_liveBytes;
+static size_t XENO_memWatermark;
+static size_t XENO_memCap;
+static int XENO_overWatermark;
+static int XENO_outOfMemoryReported;
+
+
+// Everything known about where memory's gone, for when it's running out
+static void XENO_reportMemory(const char *why) {
+  debugPrint("allocator: %s, %lu bytes live\n", why, (unsigned long) __atomic_load_n(&XENO_liveBytes, __ATOMIC_RELAXED));
+  for (int tag = 0; tag < XENO_MEM_TAG_COUNT; ++tag) {
+    XENO_MemStats stats;
+    XENO_getMemStats((XENO_MemTag) tag, &stats);
+    debugPrint("%-10s live %9lu  peak %9lu\n", XENO_memTagNames[tag], (unsigned long) stats.liveBytes,
+               (unsigned long) stats.peakBytes);
+  }
+  XENO_dumpMemSites(XENO_MEMTRACK_TOP);
+}
+
+
+static void XENO_outOfMemory(int tag, size_t size) {
+  SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "allocator: Out of memory allocating %lu bytes for '%s'\n",
+               (unsigned long) size, XENO_memTagNames[tag]);
+  if (!__atomic_exchange_n(&XENO_outOfMemoryReported, 1, __ATOMIC_RELAXED))
+    XENO_reportMemory("out of memory");
+}
+
+
+// Whether 'size' more bytes would go past the simulated cap
+static bool XENO_overMemCap(size_t size) {
+  return XENO_memCap && __atomic_load_n(&XENO_liveBytes, __ATOMIC_RELAXED) + size > XENO_memCap;
+}
+
+
+static void XENO_countAlloc(int tag, size_t size) {
+  XENO_MemTagState *state = &XENO_memTags[tag];
+  SDL_AtomicLock(&state->lock);
+  XENO_MemStats *stats = &state->stats;
+  stats->liveBytes += size;
+  ++stats->nAllocs;
+  if (stats->liveBytes > stats->peakBytes)
+    stats->peakBytes = stats->liveBytes;
+  SDL_bool crossed = (SDL_bool) (stats->budget && stats->liveBytes > stats->budget && !state->overBudget);
+  if (crossed)
+    state->overBudget = SDL_TRUE;
+  size_t liveBytes = stats->liveBytes, budget = stats->budget;
+  SDL_AtomicUnlock(&state->lock);
+
+  if (crossed)
+    debugPrint("allocator: '%s' is over budget, %lu of %lu bytes\n", XENO_memTagNames[tag],
+               (unsigned long) liveBytes, (unsigned long) budget);
+
+  const size_t total = __atomic_add_fetch(&XENO_liveBytes, size, __ATOMIC_RELAXED);
+  if (XENO_memWatermark && total > XENO_memWatermark && !__atomic_exchange_n(&XENO_overWatermark, 1, __ATOMIC_RELAXED))
+    XENO_reportMemory("over the watermark");
+}
+
+
+static void XENO_countFree(int tag, size_t size) {
+  XENO_MemTagState *state = &XENO_memTags[tag];
+  SDL_AtomicLock(&state->lock);
+  state->stats.liveBytes -= size;
+  ++state->stats.nFrees;
+  if (state->overBudget && state->stats.liveBytes <= state->stats.budget)
+    state->overBudget = SDL_FALSE;
+  SDL_AtomicUnlock(&state->lock);
+
+  // Reported again only after dropping well under, so hovering at the mark doesn't flood the log
+  const size_t total = __atomic_sub_fetch(&XENO_liveBytes, size, __ATOMIC_RELAXED);
+  if (XENO_overWatermark && total <= XENO_memWatermark - XENO_memWatermark / 8)
+    __atomic_store_n(&XENO_overWatermark, 0, __ATOMIC_RELAXED);
+}
+
+
+/** Allocates 'size' bytes charged to 'tag'. Free with XENO_free. */
+void * XENO_malloc(XENO_MemTag tag, size_t size) {
+  assert(tag >= 0 && tag < XENO_MEM_TAG_COUNT);
+  if (size > (size_t) -1 - sizeof(XENO_MemHeader))
+    return NULL;
+  XENO_MemHeader *header = XENO_overMemCap(size) ? NULL : (XENO_MemHeader *) malloc(sizeof(XENO_MemHeader) + size);
+  if (!header) {
+    XENO_outOfMemory(tag, size);
+    return NULL;
+  }
+  header->info.size = size;
+  header->info.tag = tag;
+#ifdef XENO_MEMTRACK
+  header->info.site = XENO_trackAlloc(tag, size);
+#endif
+  XENO_countAlloc(tag, size);
+  return header + 1;
+}
+
+
+void * XENO_calloc(XENO_MemTag tag, size_t n, size_t size) {
+  if (size && n > ((size_t) -1 - sizeof(XENO_MemHeader)) / size)
+    return NULL;
+  void *p = XENO_malloc(tag, n * size);
+  if (p)
+    memset(p, 0, n * size);
+  return p;
+}
+
+
+/** Resizes a block, moving it over to 'tag'. Like realloc, the old block is left alone on failure. */
+void * XENO_realloc(XENO_MemTag tag, void *p, size_t size) {
+  assert(tag >= 0 && tag < XENO_MEM_TAG_COUNT);
+  if (!p)
+    return XENO_malloc(tag, size);
+  if (size > (size_t) -1 - sizeof(XENO_MemHeader))
+    return NULL;
+
+  XENO_MemHeader *header = (XENO_MemHeader *) p - 1;
+  const size_t oldSize = header->info.size;
+  const int oldTag = header->info.tag;
+#ifdef XENO_MEMTRACK
+  const int oldSite = header->info.site;
+#endif
+  header = (size > oldSize && XENO_overMemCap(size - oldSize)) ? NULL :
+           (XENO_MemHeader *) realloc(header, sizeof(XENO_MemHeader) + size);
+  if (!header) {
+    XENO_outOfMemory(tag, size);
+    return NULL;
+  }
+  header->info.size = size;
+  header->info.tag = tag;
+#ifdef XENO_MEMTRACK
+  XENO_trackFree(oldSite, oldSize);
+  header->info.site = XENO_trackAlloc(tag, size);
+#endif
+  XENO_countFree(oldTag, oldSize);
+  XENO_countAlloc(tag, size);
+  return header + 1;
+}
+
+
+void XENO_free(void *p) {
+  if (p) {
+    XENO_MemHeader *header = (XENO_MemHeader *) p - 1;
+#ifdef XENO_MEMTRACK
+    XENO_trackFree(header->info.site, header->info.size);
+#endif
+    XENO_countFree(header->info.tag, header->info.size);
+    free(header);
+  }
+}
+
+
+/** Sets the tag the calling thread's operator new allocations are charged to.
+ *  Returns the previous one, to put back when done. */
+XENO_MemTag XENO_setMemTag(XENO_MemTag tag) {
+  assert(tag >= 0 && tag < XENO_MEM_TAG_COUNT);
+  if (!XENO_memTagTLS) {
+    SDL_AtomicLock(&XENO_memTagTLSLock);
+    if (!XENO_memTagTLS)
+      XENO_memTagTLS = SDL_TLSCreate();
+    SDL_AtomicUnlock(&XENO_memTagTLSLock);
+  }
+
+  XENO_MemTag previous = XENO_getMemTag();
+  // Stored as the pointer value itself; a thread that never set one reads NULL, XENO_MEM_GENERAL
+  SDL_TLSSet(XENO_memTagTLS, (const void *) (intptr_t) tag, NULL);
+  return previous;
+}
+
+
+XENO_MemTag XENO_getMemTag(void) {
+  return XENO_memTagTLS ? (XENO_MemTag) (intptr_t) SDL_TLSGet(XENO_memTagTLS) : XENO_MEM_GENERAL;
+}
+
+
+/** Sets how many live bytes a tag should stay under, or 0 for no limit. Going over
+ *  doesn't fail allocations; it's reported once each time it happens. */
+void XENO_setMemBudget(XENO_MemTag tag, size_t bytes) {
+  assert(tag >= 0 && tag < XENO_MEM_TAG_COUNT);
+  XENO_MemTagState *state = &XENO_memTags[tag];
+  SDL_AtomicLock(&state->lock);
+  state->stats.budget = bytes;
+  state->overBudget = SDL_FALSE;
+  SDL_AtomicUnlock(&state->lock);
+}
+
+
+/** Prints where memory's gone, down to allocation sites in MEMTRACK=y builds, once live
+ *  bytes across every tag go past 'bytes'. 0 turns it off. */
+void XENO_setMemWatermark(size_t bytes) {
+  XENO_memWatermark = bytes;
+  __atomic_store_n(&XENO_overWatermark, 0, __ATOMIC_RELAXED);
+}
+
+
+/** Fails allocations that would take live bytes across every tag past 'bytes', as if
+ *  that were all the memory there is, e.g. to try the console's limits on a PC. 0 lifts it. */
+void XENO_setMemCap(size_t bytes) {
+  XENO_memCap = bytes;
+  __atomic_store_n(&XENO_outOfMemoryReported, 0, __ATOMIC_RELAXED);
+}
+
+
+void XENO_getMemStats(XENO_MemTag tag, XENO_MemStats *stats) {
+  assert(tag >= 0 && tag < XENO_MEM_TAG_COUNT && stats);
+  XENO_MemTagState *state = &XENO_memTags[tag];
+  SDL_AtomicLock(&state->lock);
+  *stats = state->stats;
+  SDL_AtomicUnlock(&state->lock);
+}
+
+
+/** Allocations made so far across every tag. Compare two readings to check that
+ *  some stretch of code, like a steady-state frame, stayed off the heap. */
+uint32_t XENO_countHeapAllocs(void) {
+  uint32_t nAllocs = 0;
+  for (int tag = 0; tag < XENO_MEM_TAG_COUNT; ++tag) {
+    XENO_MemTagState *state = &XENO_memTags[tag];
+    SDL_AtomicLock(&state->lock);
+    nAllocs += state->stats.nAllocs;
+    SDL_AtomicUnlock(&state->lock);
+  }
+  return nAllocs;
+}
+
+
+const char * XENO_getMemTagName(XENO_MemTag tag) {
+  assert(tag >= 0 && tag < XENO_MEM_TAG_COUNT);
+  return XENO_memTagNames[tag];
+}
+
+
+/** Prints every tag's live and peak bytes, budget, and allocations per second since the last call. */
+void XENO_logMemStats(void) {
+  static Uint32 lastTicks;
+  static uint32_t lastAllocs[XENO_MEM_TAG_COUNT];
+  const Uint32 now = SDL_GetTicks();
+  const Uint32 ms = now - lastTicks;
+  lastTicks = now;
+
+  for (int tag = 0; tag < XENO_MEM_TAG_COUNT; ++tag) {
+    XENO_MemStats stats;
+    XENO_getMemStats((XENO_MemTag) tag, &stats);
+    unsigned long rate = ms ? (unsigned long) ((uint64_t) (stats.nAllocs - lastAllocs[tag]) * 1000 / ms) : 0;
+    lastAllocs[tag] = stats.nAllocs;
+    debugPrint("%-10s live %9lu  peak %9lu  budget %9lu  allocs/s %lu\n", XENO_memTagNames[tag],
+               (unsigned long) stats.liveBytes, (unsigned long) stats.peakBytes, (unsigned long) stats.budget, rate);
+  }
+}
+
+
+static void * XENO_physfsMalloc(PHYSFS_uint64 size) {
+  return size == (size_t) size ? XENO_malloc(XENO_MEM_FILESYSTEM, (size_t) size) : NULL;
+}
+
+
+static void * XENO_physfsRealloc(void *p, PHYSFS_uint64 size) {
+  return size == (size_t) size ? XENO_realloc(XENO_MEM_FILESYSTEM, p, (size_t) size) : NULL;
+}
+
+
+/** Charges PhysFS's allocations to XENO_MEM_FILESYSTEM. Call before PHYSFS_init. */
+int XENO_installPhysFSAllocator(void) {
+  static const PHYSFS_Allocator allocator = {
+    NULL, NULL, XENO_physfsMalloc, XENO_physfsRealloc, XENO_free
+  };
+  return PHYSFS_setAllocator(&allocator);
+}
+
+
+#if __cplusplus >= 201103L
+  #define XENO_NOTHROW noexcept
+#else
+  #define XENO_NOTHROW throw()
+#endif
+
+// A new-expression is assumed never to yield NULL, and with -fno-exceptions there's
+// nothing to throw instead, so running out of memory here is fatal. The allocator has
+// already reported where memory went by the time this gives up.
+static void * XENO_newOrAbort(size_t size) {
+  void *p = XENO_malloc(XENO_getMemTag(), size ? size : 1);
+  if (!p) {
+    fflush(stdout); // abort() won't, and the report may be sitting in its buffer
+    abort();
+  }
+  return p;
+}
+
+
+// Everything made with new, tinyxml2's node pools and strings included, goes
+// through the calling thread's tag
+void * operator new(size_t size) {
+  return XENO_newOrAbort(size);
+}
+
+void * operator new[](size_t size) {
+  return XENO_newOrAbort(size);
+}
+
+// For callers that check for NULL and can cope without the memory
+void * operator new(size_t size, const std::nothrow_t &) XENO_NOTHROW {
+  return XENO_malloc(XENO_getMemTag(), size ? size : 1);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) XENO_NOTHROW {
+  return XENO_malloc(XENO_getMemTag(), size ? size : 1);
+}
+
+void operator delete(void *p) {
+  XENO_free(p);
+}
+
+void operator delete[](void *p) {
+  XENO_free(p);
+}
+
+// Sized deletes too, or a compiler using them would free past the header
+void operator delete(void *p, size_t) {
+  XENO_free(p);
+}
+
+void operator delete[](void *p, size_t) {
+  XENO_free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) XENO_NOTHROW {
+  XENO_free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) XENO_NOTHROW {
+  XENO_free(p);
+}
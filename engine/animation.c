@@ -0,0 +1,160 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/animation.h>
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <assert.h>
+
+XENO_Animator * XENO_createAnimator(XENO_TileMap *map) {
+  assert(map);
+  XENO_Animator *animator = XENO_calloc(XENO_MEM_RENDER, 1, sizeof(XENO_Animator));
+  if (!animator)
+    return NULL;
+
+  animator->map = map;
+  animator->capTimelines = 16;
+  animator->timelines = XENO_malloc(XENO_MEM_RENDER, sizeof(XENO_Timeline) * animator->capTimelines);
+  if (!animator->timelines) {
+    debugPrint("createAnimator: Could not malloc memory\n");
+    XENO_free(animator);
+    return NULL;
+  }
+  return animator;
+}
+
+
+void XENO_destroyAnimator(XENO_Animator *animator) {
+  if (animator) {
+    XENO_free(animator->timelines);
+    XENO_free(animator);
+  }
+}
+
+
+// Copies a frame into the timeline's tile table entry, keeping the entry tagged with its timeline
+static void XENO_showTimelineFrame(XENO_Animator *animator, int index, int frame) {
+  XENO_Timeline *timeline = &animator->timelines[index];
+  XENO_Tile *tile = &animator->map->tiles[timeline->tile];
+  *tile = animator->map->tiles[timeline->frames[frame]];
+  tile->timeline = (uint16_t) (index + 1);
+  timeline->current = frame;
+}
+
+
+/** Adds a timeline over existing tile ids and returns the tile id cells should use to show it,
+ *  or 0 on failure. A frameMs of 0 makes a state timeline (e.g. {doorClosed, doorOpen})
+ *  that only moves through XENO_setTimelineFrame. */
+XENO_TileId XENO_addTimeline(XENO_Animator *animator, const XENO_TileId *frames, int nFrames, uint32_t frameMs) {
+  assert(animator && frames);
+  XENO_TileMap *map = animator->map;
+  if (nFrames < 1 || nFrames > XENO_MAX_TIMELINE_FRAMES || animator->nTimelines >= UINT16_MAX)
+    return 0;
+  for (int f = 0; f < nFrames; ++f) {
+    // Frames must be plain tiles; chaining timelines would make updates order dependent
+    if (!frames[f] || frames[f] >= map->nTiles || map->tiles[frames[f]].timeline)
+      return 0;
+  }
+
+  if (animator->nTimelines == animator->capTimelines) {
+    int cap = animator->capTimelines * 2;
+    XENO_Timeline *timelines = XENO_realloc(XENO_MEM_RENDER, animator->timelines, sizeof(XENO_Timeline) * cap);
+    if (!timelines) {
+      debugPrint("addTimeline: Could not realloc memory\n");
+      return 0;
+    }
+    animator->timelines = timelines;
+    animator->capTimelines = cap;
+  }
+
+  XENO_Tile first = map->tiles[frames[0]]; // Copied, since adding may move the tile table
+  XENO_TileId tile = XENO_addTile(map, &first);
+  if (!tile)
+    return 0;
+
+  int index = animator->nTimelines++;
+  XENO_Timeline *timeline = &animator->timelines[index];
+  timeline->tile = tile;
+  timeline->nFrames = nFrames;
+  timeline->frameMs = frameMs;
+  for (int f = 0; f < nFrames; ++f)
+    timeline->frames[f] = frames[f];
+
+  XENO_showTimelineFrame(animator, index, frameMs ? (int) (animator->clock / frameMs % nFrames) : 0);
+  return tile;
+}
+
+
+/** Builds a timeline from a tileset added at first (see XENO_addTilesetToMap), one frame per
+ *  tileset frame. This is how the directional _1/_3/_5/_7 frames are cycled. */
+XENO_TileId XENO_addTilesetTimeline(XENO_Animator *animator, const XENO_Tileset *tileset, XENO_TileId first,
+                                    uint32_t frameMs) {
+  assert(animator && tileset);
+  XENO_TileId frames[XENO_MAX_TIMELINE_FRAMES];
+  int nFrames = SDL_min(tileset->nFrames, XENO_MAX_TIMELINE_FRAMES);
+  for (int f = 0; f < nFrames; ++f)
+    frames[f] = (XENO_TileId) (first + f);
+  return XENO_addTimeline(animator, frames, nFrames, frameMs);
+}
+
+
+/** Switches a timeline to a frame, e.g. flipping every cell of a switch floor from off to on.
+ *  Cells that need their own state should be given a different tile with XENO_setCell instead. */
+void XENO_setTimelineFrame(XENO_Animator *animator, XENO_TileId tile, int frame) {
+  assert(animator);
+  XENO_TileMap *map = animator->map;
+  if (tile >= map->nTiles || !map->tiles[tile].timeline)
+    return;
+
+  int index = map->tiles[tile].timeline - 1;
+  XENO_Timeline *timeline = &animator->timelines[index];
+  if (frame < 0 || frame >= timeline->nFrames || frame == timeline->current)
+    return;
+
+  XENO_showTimelineFrame(animator, index, frame);
+  uint64_t bit = (uint64_t) 1 << (index % 64);
+  map->changedTimelines |= bit;
+  for (int a = 0; a < map->nAnimatedChunks; ++a) {
+    int chunk = map->animatedChunks[a];
+    if (map->chunkTimelines[chunk] & bit)
+      ++map->chunkRevision[chunk];
+  }
+}
+
+
+/** Advances every timed timeline from the shared clock and touches the chunks whose
+ *  cells changed. Returns the number of chunks touched. */
+int XENO_updateAnimations(XENO_Animator *animator, uint32_t elapsedMs) {
+  assert(animator);
+  XENO_TileMap *map = animator->map;
+  uint64_t changed = 0;
+  int touched = 0;
+
+  animator->clock += elapsedMs;
+  for (int t = 0; t < animator->nTimelines; ++t) {
+    XENO_Timeline *timeline = &animator->timelines[t];
+    if (!timeline->frameMs)
+      continue;
+    int frame = (int) (animator->clock / timeline->frameMs % timeline->nFrames);
+    if (frame != timeline->current) {
+      XENO_showTimelineFrame(animator, t, frame);
+      changed |= (uint64_t) 1 << (t % 64);
+    }
+  }
+
+  if (!changed)
+    return 0;
+
+  map->changedTimelines |= changed;
+  for (int a = 0; a < map->nAnimatedChunks; ++a) {
+    int chunk = map->animatedChunks[a];
+    if (map->chunkTimelines[chunk] & changed) {
+      ++map->chunkRevision[chunk];
+      ++touched;
+    }
+  }
+  return touched;
+}
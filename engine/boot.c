@@ -0,0 +1,158 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/boot.h>
+#include <xeno/metrics.h>
+#include <SDL2/SDL.h>
+#include <string.h>
+
+#define XENO_BOOT_BAR_WIDTH 40
+#define XENO_BOOT_NAME_WIDTH 36
+
+typedef struct XENO_BootPhase {
+  const char *name;
+  char detail[48]; // Copied; PhysFS passes archive names that don't outlive the call
+  int depth;
+  Uint64 begin, end;
+} XENO_BootPhase;
+
+static XENO_BootPhase XENO_bootPhases[XENO_BOOT_MAX_PHASES];
+static int XENO_nBootPhases;
+static int XENO_droppedBootPhases;
+static int XENO_openBootPhases[XENO_BOOT_MAX_DEPTH]; // Indices, or -1 once dropped
+static int XENO_bootDepth;
+static int XENO_bootStarted;
+static int XENO_bootFinished;
+static SDL_threadID XENO_bootThread;
+static Uint64 XENO_bootBegin, XENO_bootEnd;
+
+static XENO_Gauge XENO_bootTime = XENO_GAUGE("boot.time", "us");
+
+
+static int XENO_isBootThread(void) {
+  if (XENO_bootFinished)
+    return 0;
+  if (!XENO_bootStarted) {
+    XENO_bootStarted = 1;
+    XENO_bootThread = SDL_ThreadID();
+    XENO_bootBegin = SDL_GetPerformanceCounter();
+  }
+  return SDL_ThreadID() == XENO_bootThread;
+}
+
+
+/** Starts timing a boot phase, nested in whichever phase is open. 'name' must outlive
+ *  the boot, e.g. a string literal; 'detail' may be NULL. */
+void XENO_beginBootPhase(const char *name, const char *detail) {
+  if (!XENO_isBootThread())
+    return;
+
+  int index = -1;
+  if (XENO_nBootPhases < XENO_BOOT_MAX_PHASES && XENO_bootDepth < XENO_BOOT_MAX_DEPTH) {
+    index = XENO_nBootPhases++;
+    XENO_BootPhase *phase = &XENO_bootPhases[index];
+    phase->name = name;
+    SDL_strlcpy(phase->detail, detail ? detail : "", sizeof(phase->detail));
+    phase->depth = XENO_bootDepth;
+    phase->end = 0;
+    phase->begin = SDL_GetPerformanceCounter();
+  } else
+    ++XENO_droppedBootPhases;
+
+  if (XENO_bootDepth < XENO_BOOT_MAX_DEPTH)
+    XENO_openBootPhases[XENO_bootDepth] = index;
+  ++XENO_bootDepth;
+}
+
+
+/** Ends the innermost open boot phase. */
+void XENO_endBootPhase(void) {
+  if (!XENO_isBootThread() || XENO_bootDepth <= 0)
+    return;
+
+  --XENO_bootDepth;
+  if (XENO_bootDepth < XENO_BOOT_MAX_DEPTH && XENO_openBootPhases[XENO_bootDepth] >= 0)
+    XENO_bootPhases[XENO_openBootPhases[XENO_bootDepth]].end = SDL_GetPerformanceCounter();
+}
+
+
+/** Ends any phases still open and stops recording. Boot time runs from the first phase
+ *  to here. */
+void XENO_finishBoot(void) {
+  if (!XENO_isBootThread())
+    return;
+
+  while (XENO_bootDepth > 0)
+    XENO_endBootPhase();
+  XENO_bootEnd = SDL_GetPerformanceCounter();
+  XENO_bootFinished = 1;
+  XENO_setGauge(&XENO_bootTime, (int64_t) ((XENO_bootEnd - XENO_bootBegin) * 1000000 / SDL_GetPerformanceFrequency()));
+}
+
+
+/** Milliseconds from the first boot phase to XENO_finishBoot, or to now if boot
+ *  hasn't finished. */
+Uint32 XENO_bootMilliseconds(void) {
+  if (!XENO_bootStarted)
+    return 0;
+  const Uint64 end = XENO_bootFinished ? XENO_bootEnd : SDL_GetPerformanceCounter();
+  return (Uint32) ((end - XENO_bootBegin) * 1000 / SDL_GetPerformanceFrequency());
+}
+
+
+/** Prints every boot phase with its start, duration and a bar showing where it falls
+ *  in the boot. */
+void XENO_printBootWaterfall(void) {
+  const Uint64 end = XENO_bootFinished ? XENO_bootEnd : SDL_GetPerformanceCounter();
+  const Uint64 total = end > XENO_bootBegin ? end - XENO_bootBegin : 1;
+  const double msPerTick = 1000.0 / (double) SDL_GetPerformanceFrequency();
+
+  debugPrint("Boot took %.1f ms\n", (double) total * msPerTick);
+  debugPrint("  start ms    took ms  %-*s\n", XENO_BOOT_NAME_WIDTH, "phase");
+  for (int i = 0; i < XENO_nBootPhases; ++i) {
+    const XENO_BootPhase *phase = &XENO_bootPhases[i];
+    const Uint64 phaseEnd = phase->end ? phase->end : end;
+    const Uint64 offset = phase->begin - XENO_bootBegin;
+    const Uint64 length = phaseEnd - phase->begin;
+
+    char name[XENO_BOOT_NAME_WIDTH + 1];
+    if (phase->detail[0])
+      SDL_snprintf(name, sizeof(name), "%*s%s %s", phase->depth * 2, "", phase->name, phase->detail);
+    else
+      SDL_snprintf(name, sizeof(name), "%*s%s", phase->depth * 2, "", phase->name);
+
+    // Every phase gets at least one column, so short ones still show where they ran
+    char bar[XENO_BOOT_BAR_WIDTH + 1];
+    int from = (int) (offset * XENO_BOOT_BAR_WIDTH / total);
+    int to = (int) ((offset + length) * XENO_BOOT_BAR_WIDTH / total);
+    if (from >= XENO_BOOT_BAR_WIDTH)
+      from = XENO_BOOT_BAR_WIDTH - 1;
+    if (to <= from)
+      to = from + 1;
+    memset(bar, ' ', XENO_BOOT_BAR_WIDTH);
+    memset(bar + from, '#', to - from);
+    bar[XENO_BOOT_BAR_WIDTH] = '\0';
+
+    debugPrint("%10.3f %10.3f  %-*s |%s|%s\n", (double) offset * msPerTick, (double) length * msPerTick,
+               XENO_BOOT_NAME_WIDTH, name, bar, phase->end ? "" : " (unfinished)");
+  }
+  if (XENO_droppedBootPhases)
+    debugPrint("%d boot phases not recorded\n", XENO_droppedBootPhases);
+}
+
+
+/** Returns 1 if boot took no longer than 'budgetMs', or logs an error and returns 0. */
+int XENO_checkBootBudget(Uint32 budgetMs) {
+  if (!XENO_bootStarted)
+    return 1;
+  const Uint64 end = XENO_bootFinished ? XENO_bootEnd : SDL_GetPerformanceCounter();
+  const Uint64 frequency = SDL_GetPerformanceFrequency();
+  if (end - XENO_bootBegin > (Uint64) budgetMs * frequency / 1000) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Boot took %.1f ms, over its %u ms budget\n",
+                 (double) (end - XENO_bootBegin) * 1000.0 / (double) frequency, (unsigned) budgetMs);
+    return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,226 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/tilemap.h>
+#include <xeno/chunkcache.h>
+#include <xeno/imageutils.h>
+#include <xeno/profiler.h>
+#include <xeno/metrics.h>
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <assert.h>
+
+typedef struct XENO_ChunkSlot {
+  SDL_Texture *texture;
+  int chunk;         // Index of the cached chunk, or -1 if the slot is free
+  uint32_t revision; // Map revision of the chunk when it was last rasterized
+  uint32_t lastUsed; // Frame stamp for LRU recycling
+} XENO_ChunkSlot;
+
+struct XENO_ChunkCache {
+  SDL_Renderer *renderer;
+  XENO_TileMap *map;
+  XENO_FrameArena *arena; // For each frame's list of visible chunks
+  int chunkW, chunkH;
+  XENO_ChunkSlot *slots;
+  int nSlots;
+  int *slotOfChunk;
+  uint32_t frame;
+};
+
+// Chunks drawn from an up-to-date cached texture, and ones that had to be rasterized or drawn directly
+static XENO_Counter XENO_chunkHits = XENO_COUNTER("chunks.hits", "chunks");
+static XENO_Counter XENO_chunkMisses = XENO_COUNTER("chunks.misses", "chunks");
+
+
+/** Creates a chunk cache for a map's static layers, using at most budgetBytes of texture memory.
+ *  Scratch memory for each frame comes from 'arena', which must be begun every frame. */
+XENO_ChunkCache * XENO_createChunkCache(SDL_Renderer *renderer, XENO_TileMap *map, size_t budgetBytes,
+                                        XENO_FrameArena *arena) {
+  assert(renderer && map && arena);
+  XENO_ChunkCache *cache = XENO_calloc(XENO_MEM_RENDER, 1, sizeof(XENO_ChunkCache));
+  if (!cache)
+    return NULL;
+
+  SDL_Rect bounds;
+  XENO_getChunkBounds(map, 0, 0, &bounds);
+  cache->renderer = renderer;
+  cache->map = map;
+  cache->arena = arena;
+  cache->chunkW = bounds.w;
+  cache->chunkH = bounds.h;
+
+  // Without render targets (or budget) everything falls back to drawing cells directly
+  size_t chunkBytes = (size_t) bounds.w * bounds.h * 4;
+  if (SDL_RenderTargetSupported(renderer))
+    cache->nSlots = (int) SDL_min(budgetBytes / chunkBytes, (size_t) map->chunksX * map->chunksY);
+
+  int nChunks = map->chunksX * map->chunksY;
+  cache->slotOfChunk = XENO_malloc(XENO_MEM_RENDER, sizeof(int) * nChunks);
+  cache->slots = XENO_calloc(XENO_MEM_RENDER, SDL_max(cache->nSlots, 1), sizeof(XENO_ChunkSlot));
+  if (!cache->slotOfChunk || !cache->slots) {
+    debugPrint("createChunkCache: Could not malloc memory\n");
+    XENO_destroyChunkCache(cache);
+    return NULL;
+  }
+
+  for (int c = 0; c < nChunks; ++c)
+    cache->slotOfChunk[c] = -1;
+  for (int s = 0; s < cache->nSlots; ++s)
+    cache->slots[s].chunk = -1;
+
+  debugPrint("createChunkCache: %d slots of %dx%d\n", cache->nSlots, cache->chunkW, cache->chunkH);
+  return cache;
+}
+
+
+void XENO_destroyChunkCache(XENO_ChunkCache *cache) {
+  if (cache) {
+    if (cache->slots) {
+      for (int s = 0; s < cache->nSlots; ++s) {
+        if (cache->slots[s].texture)
+          SDL_DestroyTexture(cache->slots[s].texture);
+      }
+      XENO_free(cache->slots);
+    }
+    XENO_free(cache->slotOfChunk);
+    XENO_free(cache);
+  }
+}
+
+
+/** Forces every cached chunk to be rasterized again, e.g. after SDL_RENDER_TARGETS_RESET. */
+void XENO_invalidateChunkCache(XENO_ChunkCache *cache) {
+  assert(cache);
+  for (int s = 0; s < cache->nSlots; ++s)
+    cache->slots[s].revision = 0;
+}
+
+
+// Finds a free slot, or recycles the least recently used one that isn't on screen this frame
+static XENO_ChunkSlot * XENO_claimChunkSlot(XENO_ChunkCache *cache, int chunk) {
+  XENO_ChunkSlot *victim = NULL;
+  for (int s = 0; s < cache->nSlots; ++s) {
+    XENO_ChunkSlot *slot = &cache->slots[s];
+    if (slot->chunk < 0) {
+      victim = slot;
+      break;
+    }
+    if (slot->lastUsed != cache->frame && (!victim || slot->lastUsed < victim->lastUsed))
+      victim = slot;
+  }
+
+  if (!victim)
+    return NULL;
+
+  if (!victim->texture) {
+    victim->texture = SDL_CreateTexture(cache->renderer, SDL_PIXELFORMAT_ARGB8888,
+                                        SDL_TEXTUREACCESS_TARGET, cache->chunkW, cache->chunkH);
+    if (!victim->texture) {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create chunk texture: %s\n", SDL_GetError());
+      return NULL;
+    }
+    SDL_SetTextureBlendMode(victim->texture, SDL_BLENDMODE_BLEND);
+  }
+
+  if (victim->chunk >= 0)
+    cache->slotOfChunk[victim->chunk] = -1;
+  victim->chunk = chunk;
+  victim->revision = 0;
+  cache->slotOfChunk[chunk] = (int) (victim - cache->slots);
+  return victim;
+}
+
+
+static int XENO_rasterizeChunk(XENO_ChunkCache *cache, XENO_ChunkSlot *slot, int cx, int cy, const SDL_Rect *bounds) {
+  XENO_ZONE("rasterizeChunk");
+  SDL_Renderer *renderer = cache->renderer;
+  SDL_Texture *previous = SDL_GetRenderTarget(renderer);
+  Uint8 r, g, b, a;
+
+  if (SDL_SetRenderTarget(renderer, slot->texture) < 0)
+    return -1;
+
+  SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+  SDL_RenderClear(renderer);
+  SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+  SDL_Rect cells = {cx * XENO_CHUNK_SIZE, cy * XENO_CHUNK_SIZE, XENO_CHUNK_SIZE, XENO_CHUNK_SIZE};
+  XENO_drawCells(renderer, cache->map, 0, XENO_STATIC_LAYERS - 1, &cells, -bounds->x, -bounds->y);
+
+  SDL_SetRenderTarget(renderer, previous);
+  ++XENO_renderStats.chunksRasterized;
+  slot->revision = cache->map->chunkRevision[cy * cache->map->chunksX + cx];
+  return 0;
+}
+
+
+/** Composites the static layers visible in a world-space view onto the current render target.
+ *  Returns the number of chunks drawn, or -1 on error. */
+int XENO_renderStaticLayers(XENO_ChunkCache *cache, const SDL_Rect *view) {
+  XENO_ZONE("renderStaticLayers");
+  assert(cache && view);
+  XENO_TileMap *map = cache->map;
+  SDL_Rect range, bounds, dest;
+  int nVisible = 0;
+
+  ++cache->frame;
+  XENO_getChunkRange(map, view, &range);
+  int *visible = XENO_frameAlloc(cache->arena, sizeof(int) * SDL_max(range.w * range.h, 1));
+  if (!visible)
+    return -1;
+
+  // Stale chunks are all rasterized before any is composited, so drawing to the
+  // view isn't broken up by switches to and from chunk textures
+  for (int cy = range.y; cy < range.y + range.h; ++cy) {
+    for (int cx = range.x; cx < range.x + range.w; ++cx) {
+      XENO_getChunkBounds(map, cx, cy, &bounds);
+      if (!SDL_HasIntersection(&bounds, view))
+        continue;
+
+      int chunk = cy * map->chunksX + cx;
+      visible[nVisible++] = chunk;
+      XENO_ChunkSlot *slot = NULL;
+      if (cache->slotOfChunk[chunk] >= 0)
+        slot = &cache->slots[cache->slotOfChunk[chunk]];
+      else
+        slot = XENO_claimChunkSlot(cache, chunk);
+
+      if (slot && slot->revision != map->chunkRevision[chunk]) {
+        if (XENO_rasterizeChunk(cache, slot, cx, cy, &bounds) < 0) {
+          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't rasterize chunk: %s\n", SDL_GetError());
+          return -1;
+        }
+        XENO_addCounter(&XENO_chunkMisses, 1);
+      } else {
+        XENO_addCounter(slot ? &XENO_chunkHits : &XENO_chunkMisses, 1);
+      }
+      if (slot)
+        slot->lastUsed = cache->frame; // Keeps it from being recycled for a later chunk this frame
+    }
+  }
+
+  for (int v = 0; v < nVisible; ++v) {
+    const int chunk = visible[v];
+    const int cx = chunk % map->chunksX, cy = chunk / map->chunksX;
+    XENO_getChunkBounds(map, cx, cy, &bounds);
+    if (cache->slotOfChunk[chunk] >= 0) {
+      dest.x = bounds.x - view->x;
+      dest.y = bounds.y - view->y;
+      dest.w = bounds.w;
+      dest.h = bounds.h;
+      SDL_RenderCopy(cache->renderer, cache->slots[cache->slotOfChunk[chunk]].texture, NULL, &dest);
+      ++XENO_renderStats.drawCalls;
+    } else {
+      // Over budget for this view; draw the chunk's cells straight to the screen
+      SDL_Rect cells = {cx * XENO_CHUNK_SIZE, cy * XENO_CHUNK_SIZE, XENO_CHUNK_SIZE, XENO_CHUNK_SIZE};
+      XENO_drawCells(cache->renderer, map, 0, XENO_STATIC_LAYERS - 1, &cells, -view->x, -view->y);
+    }
+  }
+
+  return nVisible;
+}
@@ -0,0 +1,239 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/tilemap.h>
+#include <xeno/dirtyrects.h>
+#include <SDL2/SDL.h>
+#include <assert.h>
+
+static int XENO_rectArea(const SDL_Rect *r) {
+  return r->w * r->h;
+}
+
+
+/** Sets up dirty tracking for a screen. Pass partial=1 only when presenting through
+ *  SDL_UpdateWindowSurfaceRects, where pixels outside the dirty rectangles are kept. */
+void XENO_initDirtyRects(XENO_DirtyRects *dirty, int width, int height, int partial) {
+  assert(dirty);
+  dirty->screen.x = 0;
+  dirty->screen.y = 0;
+  dirty->screen.w = width;
+  dirty->screen.h = height;
+  dirty->partial = partial;
+  XENO_markAllDirty(dirty); // Nothing has been drawn yet
+}
+
+
+void XENO_clearDirtyRects(XENO_DirtyRects *dirty) {
+  assert(dirty);
+  dirty->count = 0;
+  dirty->full = 0;
+}
+
+
+void XENO_markAllDirty(XENO_DirtyRects *dirty) {
+  assert(dirty);
+  dirty->count = 0;
+  dirty->full = 1;
+}
+
+
+/** Adds a screen region, merging it with existing ones where that wastes little redraw area. */
+void XENO_markDirty(XENO_DirtyRects *dirty, const SDL_Rect *rect) {
+  assert(dirty && rect);
+  SDL_Rect add, merged;
+
+  if (dirty->full || !SDL_IntersectRect(rect, &dirty->screen, &add))
+    return;
+
+  // Back buffers are undefined after a present, so anything dirty means everything is
+  if (!dirty->partial) {
+    XENO_markAllDirty(dirty);
+    return;
+  }
+
+  // Absorb any rectangle whose union with the new one costs no more than drawing both
+  int i = 0;
+  while (i < dirty->count) {
+    SDL_UnionRect(&dirty->rects[i], &add, &merged);
+    if (SDL_HasIntersection(&dirty->rects[i], &add)
+        || XENO_rectArea(&merged) <= XENO_rectArea(&dirty->rects[i]) + XENO_rectArea(&add)) {
+      add = merged;
+      dirty->rects[i] = dirty->rects[--dirty->count];
+      i = 0; // The grown rectangle may now touch ones we already passed
+    } else {
+      ++i;
+    }
+  }
+
+  // Out of slots: fold into whichever rectangle grows the least
+  if (dirty->count == XENO_MAX_DIRTY_RECTS) {
+    int best = 0, bestGrowth = 0;
+    for (i = 0; i < dirty->count; ++i) {
+      SDL_UnionRect(&dirty->rects[i], &add, &merged);
+      int growth = XENO_rectArea(&merged) - XENO_rectArea(&dirty->rects[i]);
+      if (i == 0 || growth < bestGrowth) {
+        best = i;
+        bestGrowth = growth;
+      }
+    }
+    SDL_UnionRect(&dirty->rects[best], &add, &add);
+    dirty->rects[best] = dirty->rects[--dirty->count];
+    XENO_markDirty(dirty, &add);
+    return;
+  }
+
+  dirty->rects[dirty->count++] = add;
+
+  // Past three quarters of the screen, one full redraw beats many partial ones
+  int area = 0;
+  for (i = 0; i < dirty->count; ++i)
+    area += XENO_rectArea(&dirty->rects[i]);
+  if (area * 4 > XENO_rectArea(&dirty->screen) * 3)
+    XENO_markAllDirty(dirty);
+}
+
+
+void XENO_markSpriteMoved(XENO_DirtyRects *dirty, const SDL_Rect *from, const SDL_Rect *to) {
+  if (from)
+    XENO_markDirty(dirty, from);
+  if (to)
+    XENO_markDirty(dirty, to);
+}
+
+
+/** Marks the screen area covered by a cell's canvas, for a world-space view. */
+void XENO_markCellDirty(XENO_DirtyRects *dirty, const XENO_TileMap *map, int x, int y, const SDL_Rect *view) {
+  assert(map && view);
+  SDL_Point pos;
+  XENO_cellToWorld(map, x, y, &pos);
+
+  SDL_Rect rect;
+  rect.x = pos.x - view->x;
+  rect.y = pos.y - view->y;
+  rect.w = map->canvasW;
+  rect.h = map->canvasH;
+  XENO_markDirty(dirty, &rect);
+}
+
+
+// Marks the cells in a rectangle whose tiles are driven by any of the 'changed' timelines
+static void XENO_markTimelineCells(XENO_DirtyRects *dirty, const XENO_TileMap *map, int firstLayer, int lastLayer,
+                                   const SDL_Rect *cells, uint64_t changed, const SDL_Rect *view) {
+  const int x0 = SDL_max(cells->x, 0), y0 = SDL_max(cells->y, 0);
+  const int x1 = SDL_min(cells->x + cells->w, map->width);
+  const int y1 = SDL_min(cells->y + cells->h, map->height);
+
+  for (int l = firstLayer; l <= lastLayer; ++l) {
+    const XENO_TileId *layer = map->cells[l];
+    for (int y = y0; y < y1; ++y) {
+      for (int x = x0; x < x1; ++x) {
+        XENO_TileId id = layer[y * map->width + x];
+        uint16_t timeline = id && id < map->nTiles ? map->tiles[id].timeline : 0;
+        if (timeline && (changed & ((uint64_t) 1 << ((timeline - 1) % 64))))
+          XENO_markCellDirty(dirty, map, x, y, view);
+      }
+    }
+  }
+}
+
+
+/** Marks what changed on a map since the last call, for a world-space view: cells set with
+ *  XENO_setCell, and cells showing a timeline that moved to another frame. Static layers
+ *  only look in animated chunks; the object layer is searched within the view. */
+void XENO_markMapDirty(XENO_DirtyRects *dirty, XENO_TileMap *map, const SDL_Rect *view) {
+  assert(dirty && map && view);
+  if (map->nChangedCells > XENO_MAX_CHANGED_CELLS) {
+    XENO_markAllDirty(dirty);
+  } else {
+    for (int i = 0; i < map->nChangedCells && !dirty->full; ++i)
+      XENO_markCellDirty(dirty, map, map->changedCells[i].x, map->changedCells[i].y, view);
+  }
+
+  if (map->changedTimelines && !dirty->full) {
+    SDL_Rect range, cells;
+    XENO_getChunkRange(map, view, &range);
+    cells.w = XENO_CHUNK_SIZE;
+    cells.h = XENO_CHUNK_SIZE;
+    for (int a = 0; a < map->nAnimatedChunks && !dirty->full; ++a) {
+      int chunk = map->animatedChunks[a];
+      int cx = chunk % map->chunksX, cy = chunk / map->chunksX;
+      if ((map->chunkTimelines[chunk] & map->changedTimelines) && cx >= range.x && cx < range.x + range.w
+          && cy >= range.y && cy < range.y + range.h) {
+        cells.x = cx * XENO_CHUNK_SIZE;
+        cells.y = cy * XENO_CHUNK_SIZE;
+        XENO_markTimelineCells(dirty, map, 0, XENO_STATIC_LAYERS - 1, &cells, map->changedTimelines, view);
+      }
+    }
+
+    cells.x = range.x * XENO_CHUNK_SIZE;
+    cells.y = range.y * XENO_CHUNK_SIZE;
+    cells.w = range.w * XENO_CHUNK_SIZE;
+    cells.h = range.h * XENO_CHUNK_SIZE;
+    if (!dirty->full)
+      XENO_markTimelineCells(dirty, map, XENO_STATIC_LAYERS, XENO_LAYER_COUNT - 1, &cells, map->changedTimelines, view);
+  }
+
+  map->nChangedCells = 0;
+  map->changedTimelines = 0;
+}
+
+
+/** Gets the regions to redraw this frame. Returns their count, which is 0 for an idle frame. */
+int XENO_getDirtyRects(const XENO_DirtyRects *dirty, const SDL_Rect **rects) {
+  assert(dirty && rects);
+  if (dirty->full) {
+    *rects = &dirty->screen;
+    return 1;
+  }
+
+  *rects = dirty->rects;
+  return dirty->count;
+}
+
+
+/** Clears and redraws each dirty region with clipping set to it. Returns the number of regions drawn. */
+int XENO_renderDirty(SDL_Renderer *renderer, XENO_DirtyRects *dirty, XENO_DrawRegionFn draw, void *userdata) {
+  assert(renderer && dirty && draw);
+  const SDL_Rect *rects;
+  int n = XENO_getDirtyRects(dirty, &rects);
+
+  for (int i = 0; i < n; ++i) {
+    SDL_RenderSetClipRect(renderer, &rects[i]);
+    SDL_RenderFillRect(renderer, &rects[i]); // Clear only this region, in the current draw colour
+    draw(renderer, &rects[i], userdata);
+  }
+  SDL_RenderSetClipRect(renderer, NULL);
+
+  return n;
+}
+
+
+/** Presents the dirty regions and resets tracking. On the software path, only those regions
+ *  are copied to the window; otherwise the renderer is presented as usual. Idle frames present
+ *  nothing. Returns the number of regions presented, or -1 if copying them to the window failed. */
+int XENO_presentDirty(SDL_Window *window, SDL_Renderer *renderer, XENO_DirtyRects *dirty) {
+  assert(dirty);
+  const SDL_Rect *rects;
+  int n = XENO_getDirtyRects(dirty, &rects);
+
+  if (n) {
+    if (dirty->partial && window) {
+#if SDL_VERSION_ATLEAST(2, 0, 10)
+      if (renderer)
+        SDL_RenderFlush(renderer); // Batched draws have to reach the surface before it's copied
+#endif
+      if ((dirty->full ? SDL_UpdateWindowSurface(window) : SDL_UpdateWindowSurfaceRects(window, rects, n)) < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't present dirty regions: %s\n", SDL_GetError());
+        n = -1;
+      }
+    } else if (renderer) {
+      SDL_RenderPresent(renderer);
+    }
+  }
+
+  XENO_clearDirtyRects(dirty);
+  return n;
+}
@@ -0,0 +1,177 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/framearena.h>
+#include <string.h>
+#include <assert.h>
+
+// Allocations are as aligned as malloc's, since the buffers come from it
+#define XENO_FRAME_ALIGN 16
+
+// Debug builds put a header with the size before each allocation and guard bytes
+// after it, checked when the buffer is recycled, and poison recycled memory
+#ifndef NDEBUG
+  #define XENO_FRAME_HEADER XENO_FRAME_ALIGN
+  #define XENO_FRAME_GUARD  16
+#else
+  #define XENO_FRAME_HEADER 0
+  #define XENO_FRAME_GUARD  0
+#endif
+
+#define XENO_FRAME_GUARD_BYTE  0xFD
+#define XENO_FRAME_NEW_BYTE    0xCD // Allocated, not yet written
+#define XENO_FRAME_FREED_BYTE  0xDD // Recycled
+
+// Overflow blocks keep the chain pointer and their size in a header of their own, and
+// get the same guard bytes and fills as allocations from the buffers
+typedef union XENO_FrameOverflow {
+  struct {
+    void *next;
+    size_t size;
+  } info;
+  char align[XENO_FRAME_ALIGN];
+} XENO_FrameOverflow;
+
+#define XENO_FRAME_PADDED(size) (((size) + XENO_FRAME_GUARD + XENO_FRAME_ALIGN - 1) & ~(size_t) (XENO_FRAME_ALIGN - 1))
+
+
+/** Creates an arena with two buffers of bytesPerFrame each, charged to 'tag'. */
+XENO_FrameArena * XENO_createFrameArena(size_t bytesPerFrame, XENO_MemTag tag) {
+  XENO_FrameArena *arena = XENO_calloc(tag, 1, sizeof(XENO_FrameArena));
+  if (!arena)
+    return NULL;
+
+  arena->capacity = (bytesPerFrame + XENO_FRAME_ALIGN - 1) & ~(size_t) (XENO_FRAME_ALIGN - 1);
+  arena->tag = tag;
+  for (int b = 0; b < 2; ++b) {
+    arena->buffers[b].base = XENO_malloc(tag, arena->capacity);
+    if (!arena->buffers[b].base) {
+      debugPrint("createFrameArena: Could not malloc memory\n");
+      XENO_destroyFrameArena(arena);
+      return NULL;
+    }
+  }
+  return arena;
+}
+
+
+#ifndef NDEBUG
+// Whether the guard bytes after an allocation were written over
+static int XENO_checkFrameGuard(const char *p, size_t size) {
+  const unsigned char *guard = (const unsigned char *) p + size;
+  const unsigned char *end = (const unsigned char *) p + XENO_FRAME_PADDED(size);
+  for (; guard < end; ++guard) {
+    if (*guard != XENO_FRAME_GUARD_BYTE) {
+      debugPrint("frameArena: %lu byte allocation at %p was written past its end\n", (unsigned long) size,
+                 (void *) p);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+// Walks a buffer's allocations, counting the ones whose guard bytes were written over
+static uint32_t XENO_checkFrameGuards(const XENO_FrameBuffer *buffer) {
+  uint32_t overruns = 0;
+  const char *p = buffer->base;
+  const char *end = buffer->base + buffer->used;
+  while (p < end) {
+    const size_t size = *(const size_t *) p;
+    overruns += XENO_checkFrameGuard(p + XENO_FRAME_HEADER, size);
+    p += XENO_FRAME_HEADER + XENO_FRAME_PADDED(size);
+  }
+  return overruns;
+}
+#endif
+
+
+// Frees a buffer's overflow blocks, checking and poisoning them first in debug builds
+static void XENO_freeFrameOverflow(XENO_FrameArena *arena, XENO_FrameBuffer *buffer) {
+  while (buffer->overflow) {
+    XENO_FrameOverflow *block = (XENO_FrameOverflow *) buffer->overflow;
+    buffer->overflow = block->info.next;
+#ifndef NDEBUG
+    arena->overruns += XENO_checkFrameGuard((char *) (block + 1), block->info.size);
+    memset(block + 1, XENO_FRAME_FREED_BYTE, XENO_FRAME_PADDED(block->info.size));
+#else
+    (void) arena;
+#endif
+    XENO_free(block);
+  }
+  buffer->overflowBytes = 0;
+}
+
+
+void XENO_destroyFrameArena(XENO_FrameArena *arena) {
+  if (arena) {
+    for (int b = 0; b < 2; ++b) {
+      XENO_freeFrameOverflow(arena, &arena->buffers[b]);
+      XENO_free(arena->buffers[b].base);
+    }
+    XENO_free(arena);
+  }
+}
+
+
+/** Starts a frame: switches buffers and empties the one allocated from two frames ago. */
+void XENO_beginFrameArena(XENO_FrameArena *arena) {
+  assert(arena);
+  arena->current ^= 1;
+  XENO_FrameBuffer *buffer = &arena->buffers[arena->current];
+#ifndef NDEBUG
+  arena->overruns += XENO_checkFrameGuards(buffer);
+  memset(buffer->base, XENO_FRAME_FREED_BYTE, buffer->used);
+#endif
+  buffer->used = 0;
+  XENO_freeFrameOverflow(arena, buffer);
+  ++arena->frames;
+}
+
+
+/** Allocates scratch memory that stays valid until the end of the next frame. What doesn't
+ *  fit goes to the heap, counted in 'overflows'; that only fails if the heap does. */
+void * XENO_frameAlloc(XENO_FrameArena *arena, size_t size) {
+  assert(arena);
+  XENO_FrameBuffer *buffer = &arena->buffers[arena->current];
+  const size_t available = arena->capacity - buffer->used;
+  const size_t padded = XENO_FRAME_PADDED(size);
+  char *p;
+
+  if (size <= available && padded + XENO_FRAME_HEADER <= available) {
+    p = buffer->base + buffer->used;
+    buffer->used += XENO_FRAME_HEADER + padded;
+#ifndef NDEBUG
+    *(size_t *) p = size;
+    p += XENO_FRAME_HEADER;
+    memset(p, XENO_FRAME_NEW_BYTE, size);
+    memset(p + size, XENO_FRAME_GUARD_BYTE, padded - size);
+#endif
+  } else {
+    if (size > (size_t) -1 - sizeof(XENO_FrameOverflow) - XENO_FRAME_GUARD - XENO_FRAME_ALIGN)
+      return NULL;
+    XENO_FrameOverflow *block = XENO_malloc(arena->tag, sizeof(XENO_FrameOverflow) + padded);
+    if (!block)
+      return NULL;
+    if (!arena->overflows)
+      debugPrint("frameAlloc: %lu bytes per frame isn't enough; overflowing to the heap\n",
+                 (unsigned long) arena->capacity);
+    ++arena->overflows;
+    block->info.next = buffer->overflow;
+    block->info.size = size;
+    buffer->overflow = block;
+    buffer->overflowBytes += size;
+    p = (char *) (block + 1);
+#ifndef NDEBUG
+    memset(p, XENO_FRAME_NEW_BYTE, size);
+    memset(p + size, XENO_FRAME_GUARD_BYTE, padded - size);
+#endif
+  }
+
+  if (buffer->used + buffer->overflowBytes > arena->peak)
+    arena->peak = buffer->used + buffer->overflowBytes;
+  return p;
+}
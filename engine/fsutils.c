@@ -3,7 +3,11 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
 #include <xeno/platform.h>
+#include <xeno/allocator.h>
 #include <xeno/fsutils.h>
+#include <xeno/profiler.h>
+#include <xeno/metrics.h>
+#include <xeno/boot.h>
 #include <physfs.h>
 #include <SDL2/SDL.h>
 #include <stdlib.h>
@@ -14,13 +18,20 @@
   #include <hal/fileio.h>
 #endif
 
+static XENO_Counter XENO_fileReads = XENO_COUNTER("fs.reads", "files");
+static XENO_Counter XENO_fileReadBytes = XENO_COUNTER("fs.read_bytes", "bytes");
+static XENO_Histogram XENO_fileReadTime = XENO_HISTOGRAM("fs.read_time", "us");
+static XENO_Counter XENO_zipReads = XENO_COUNTER("zip.reads", "reads");
+static XENO_Counter XENO_zipCompressedBytes = XENO_COUNTER("zip.compressed_bytes", "bytes");
+static XENO_Counter XENO_zipInflatedBytes = XENO_COUNTER("zip.inflated_bytes", "bytes");
+
 void XENO_concatBasePath(const char* path, char** target) {
   // Using assert() instead of if() because we shouldn't
   // ever get NULL values during normal operation.
   assert(path && target);
   assert(PHYSFS_isInit());
   if (*target) {
-    free(*target);
+    XENO_free(*target);
     *target = NULL;
   }
 
@@ -29,7 +40,7 @@ void XENO_concatBasePath(const char* path, char** target) {
   size_t baseLen = strlen(base);
   size_t pathLen = strlen(path);
   size_t dirSepLen = strlen(dirSep);
-  char * buffer = malloc(baseLen + pathLen + dirSepLen + 1);
+  char * buffer = XENO_malloc(XENO_MEM_FILESYSTEM, baseLen + pathLen + dirSepLen + 1);
 
   assert(buffer); // OOM errors aren't really something we can recover from...
   strcpy(buffer, base);
@@ -38,10 +49,9 @@ void XENO_concatBasePath(const char* path, char** target) {
   // Find whether the base ends in a dirSep
   // Otherwise, add a dirSep to the buffer
   size_t fromEnd;
-  for (fromEnd = 1; (fromEnd <= dirSepLen) && (dirSep[dirSepLen - fromEnd - 1] == base[baseLen - fromEnd - 1]); ++fromEnd);
+  for (fromEnd = 1; (fromEnd <= dirSepLen) && (fromEnd <= baseLen) && (dirSep[dirSepLen - fromEnd] == base[baseLen - fromEnd]); ++fromEnd);
   if (fromEnd <= dirSepLen) { // Needs a path separator
     strcat(buffer, dirSep);
-    buffer[baseLen] = '\0'; // Ensure there's another null terminator for strcat to find
   }
 
   strcat(buffer, path);
@@ -49,7 +59,11 @@ void XENO_concatBasePath(const char* path, char** target) {
 }
 
 
+/** Reads a whole file into a buffer charged to the calling thread's memory tag.
+ *  Free it with XENO_free. */
 uint32_t XENO_readFile(const char* inFilename, char** outData) {
+  XENO_ZONE("readFile");
+  const Uint64 start = SDL_GetPerformanceCounter();
   assert(PHYSFS_isInit());
   if (inFilename && outData) {
     int status = PHYSFS_exists(inFilename);
@@ -60,26 +74,30 @@ uint32_t XENO_readFile(const char* inFilename, char** outData) {
       uint32_t file_size = PHYSFS_fileLength(myfile);
 
       char* buffer;
-      buffer = malloc(file_size + 1);
+      buffer = XENO_malloc(XENO_getMemTag(), file_size + 1);
       if (buffer) {
         uint32_t length_read = PHYSFS_read(myfile, buffer, 1, file_size);
         PHYSFS_close(myfile);
 
         if (length_read == file_size) {
           if (*outData)
-            free(*outData); // TODO: Be careful; this can bite if we're passed a new but uninitialized pointer
+            XENO_free(*outData); // TODO: Be careful; this can bite if we're passed a new but uninitialized pointer
           buffer[length_read] = '\0';
           (*outData) = buffer;
+          XENO_addCounter(&XENO_fileReads, 1);
+          XENO_addCounter(&XENO_fileReadBytes, length_read);
+          XENO_recordMicroseconds(&XENO_fileReadTime, start);
           return length_read;
         }
         else {
-          free(buffer);
+          XENO_free(buffer);
           debugPrint("readFile: File size and read length mismatch\n");
           return 0;
         }
       }
       else {
-        debugPrint("readFile: Could not malloc memory\n");
+        PHYSFS_close(myfile);
+        debugPrint("readFile: Could not allocate %lu bytes for '%s'\n", (unsigned long) file_size + 1, inFilename);
         return 0;
       }
     }
@@ -93,9 +111,34 @@ uint32_t XENO_readFile(const char* inFilename, char** outData) {
 }
 
 
+// Called by PhysFS after every read from a zip entry, on the reading thread
+static void XENO_countZipRead(PHYSFS_uint64 compressed, PHYSFS_uint64 uncompressed) {
+  XENO_addCounter(&XENO_zipReads, 1);
+  XENO_addCounter(&XENO_zipCompressedBytes, compressed);
+  XENO_addCounter(&XENO_zipInflatedBytes, uncompressed);
+}
+
+
+// Called by PhysFS around the costly steps of mounting, e.g. reading a zip's central directory
+static void XENO_timeMountStep(const char *step, const char *detail, int begin) {
+  if (begin) {
+    // Archives are named by their full path; the waterfall only has room for the file
+    const char *file = detail ? strrchr(detail, PHYSFS_getDirSeparator()[0]) : NULL;
+    XENO_beginBootPhase(step, file ? file + 1 : detail);
+  } else
+    XENO_endBootPhase();
+}
+
+
 /** Initializes PhysFS filesystem access. */
 int XENO_initFilesystem(const char *argv0, const char** readPaths, size_t nReadPaths) {
+  XENO_ZONE("initFilesystem");
+  XENO_installPhysFSAllocator();
+  PHYSFS_setZipReadCallback(XENO_countZipRead);
+  PHYSFS_setStepCallback(XENO_timeMountStep);
+  XENO_beginBootPhase("PHYSFS_init", NULL);
   int rv = PHYSFS_init(argv0);
+  XENO_endBootPhase();
 
   if (rv) {
     char* target = NULL;
@@ -107,26 +150,32 @@ int XENO_initFilesystem(const char *argv0, const char** readPaths, size_t nReadP
     if (readPaths && nReadPaths) {
       for (size_t n = 0; n < nReadPaths; ++n) {
         XENO_concatBasePath(readPaths[n], &target);
+        XENO_beginBootPhase("PHYSFS_mount", readPaths[n]);
         rv = PHYSFS_mount(target, "/", 1);
+        XENO_endBootPhase();
         if (rv) {
           debugPrint("Using read path '%s'\n", target);
         } else {
-          free(target);
+          XENO_free(target);
           return rv;
         }
       }
     }
 
     if (target)
-      free(target);
+      XENO_free(target);
+    XENO_beginBootPhase("PHYSFS_getPrefDir", NULL);
     target = PHYSFS_getPrefDir("Games", APP_TITLE);
+    XENO_endBootPhase();
+    XENO_beginBootPhase("PHYSFS_setWriteDir", NULL);
     rv = PHYSFS_setWriteDir(target);
+    XENO_endBootPhase();
     debugPrint("Using write path '%s'\n", target);
 
 #if 0
     XENO_concatBasePath("data", &target);
     PHYSFS_setWriteDir(target);
-    free(target);
+    XENO_free(target);
 #endif
     debugPrint("Filesystem initialized\n");
   }
@@ -145,7 +194,7 @@ SDL_RWops* XENO_openSDLBuffer(const char* inFilename) {
       return rw;
     }
     else {
-      free(buffer);
+      XENO_free(buffer);
       return NULL;
     }
   }
@@ -159,6 +208,6 @@ void XENO_closeSDLBuffer(SDL_RWops* rw) {
     void* buf = rw->hidden.mem.base;
     SDL_RWclose(rw);
     if (buf)
-      free(buf);
+      XENO_free(buf);
   }
 }
@@ -3,18 +3,32 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
 #include <xeno/platform.h>
+#include <xeno/allocator.h>
 #include <xeno/fsutils.h>
 #include <xeno/imageutils.h>
+#include <xeno/profiler.h>
+#include <xeno/metrics.h>
 #include <SDL2/SDL.h>
+#include <string.h>
+
+XENO_RenderStats XENO_renderStats;
+
+static XENO_Counter XENO_textureUploads = XENO_COUNTER("render.texture_uploads", "textures");
+static XENO_Counter XENO_textureUploadBytes = XENO_COUNTER("render.upload_bytes", "bytes");
+static XENO_Histogram XENO_imageLoadTime = XENO_HISTOGRAM("images.load_time", "us");
 
 // Modified from original NXDK SDL sample
 SDL_Texture * XENO_LoadBMPTexture(SDL_Renderer *renderer, const char *filename) {
+  XENO_ZONE("LoadBMPTexture");
+  const Uint64 start = SDL_GetPerformanceCounter();
   SDL_RWops *buffer = NULL;;
   SDL_Surface *surf = NULL;
   SDL_Texture *tex = NULL;
 
   // Buffer the image
+  XENO_MemTag tag = XENO_setMemTag(XENO_MEM_IMAGES);
   buffer = XENO_openSDLBuffer(filename);
+  XENO_setMemTag(tag);
   if (buffer == NULL) {
       SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't load %s: %s", filename, SDL_GetError());
       return 0;
@@ -40,7 +54,16 @@ SDL_Texture * XENO_LoadBMPTexture(SDL_Renderer *renderer, const char *filename)
       SDL_FreeSurface(surf);
       return 0;
   }
+  XENO_renderStats.bytesUploaded += (uint64_t) surf->pitch * surf->h;
+  XENO_addCounter(&XENO_textureUploads, 1);
+  XENO_addCounter(&XENO_textureUploadBytes, (uint64_t) surf->pitch * surf->h);
   SDL_FreeSurface(surf);
+  XENO_recordMicroseconds(&XENO_imageLoadTime, start);
 
   return tex;
 }
+
+
+void XENO_resetRenderStats(void) {
+  memset(&XENO_renderStats, 0, sizeof(XENO_renderStats));
+}
@@ -0,0 +1,69 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_ALLOCATOR_H_
+#define _XENO_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Who an allocation is charged to. operator new charges the calling thread's
+ *  current tag (see XENO_setMemTag), since it can't be told one. */
+typedef enum {
+  XENO_MEM_GENERAL = 0, // Anything not tagged otherwise
+  XENO_MEM_FILESYSTEM,  // PhysFS and path strings
+  XENO_MEM_XML,         // tinyxml2 documents and what's loaded from them
+  XENO_MEM_IMAGES,      // Image files on their way to textures
+  XENO_MEM_RENDER,      // Tile maps, chunk caches, animators
+  XENO_MEM_GAME,
+  XENO_MEM_TAG_COUNT
+} XENO_MemTag;
+
+typedef struct XENO_MemStats {
+  size_t liveBytes;
+  size_t peakBytes;
+  size_t budget;     // 0 for none
+  uint32_t nAllocs;  // Since startup; reallocs count as a free and an alloc
+  uint32_t nFrees;
+} XENO_MemStats;
+
+void * XENO_malloc(XENO_MemTag tag, size_t size);
+void * XENO_calloc(XENO_MemTag tag, size_t n, size_t size);
+void * XENO_realloc(XENO_MemTag tag, void *p, size_t size);
+void XENO_free(void *p);
+
+XENO_MemTag XENO_setMemTag(XENO_MemTag tag);
+XENO_MemTag XENO_getMemTag(void);
+
+void XENO_setMemBudget(XENO_MemTag tag, size_t bytes);
+void XENO_setMemWatermark(size_t bytes);
+void XENO_setMemCap(size_t bytes);
+void XENO_getMemStats(XENO_MemTag tag, XENO_MemStats *stats);
+uint32_t XENO_countHeapAllocs(void);
+const char * XENO_getMemTagName(XENO_MemTag tag);
+void XENO_logMemStats(void);
+
+int XENO_installPhysFSAllocator(void);
+
+#ifdef __cplusplus
+}
+
+/** Charges the calling thread's allocations to a tag until the end of the scope. */
+class XENO_MemTagScope {
+public:
+  explicit XENO_MemTagScope(XENO_MemTag tag) : previous(XENO_setMemTag(tag)) {}
+  ~XENO_MemTagScope() { XENO_setMemTag(previous); }
+
+private:
+  XENO_MemTagScope(const XENO_MemTagScope &); // not supported
+  void operator=(const XENO_MemTagScope &);   // not supported
+
+  XENO_MemTag previous;
+};
+#endif
+#endif //_XENO_ALLOCATOR_H_
@@ -0,0 +1,47 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_ANIMATION_H_
+#define _XENO_ANIMATION_H_
+
+#include <stdint.h>
+#include <xeno/tilemap.h>
+#include <xeno/tileset.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XENO_MAX_TIMELINE_FRAMES 16
+
+/** A sequence of tile ids shared by every cell showing the timeline's tile.
+ *  Advancing a timeline rewrites one tile table entry, so the cost doesn't
+ *  depend on how many cells use it. */
+typedef struct XENO_Timeline {
+  XENO_TileId tile; // Tile table entry cells reference; mirrors the current frame
+  XENO_TileId frames[XENO_MAX_TIMELINE_FRAMES];
+  int nFrames;
+  uint32_t frameMs; // Time per frame, or 0 for a state timeline that only changes on request
+  int current;
+} XENO_Timeline;
+
+typedef struct XENO_Animator {
+  XENO_TileMap *map;
+  XENO_Timeline *timelines;
+  int nTimelines, capTimelines;
+  uint32_t clock; // Milliseconds of animation time elapsed
+} XENO_Animator;
+
+XENO_Animator * XENO_createAnimator(XENO_TileMap *map);
+void XENO_destroyAnimator(XENO_Animator *animator);
+XENO_TileId XENO_addTimeline(XENO_Animator *animator, const XENO_TileId *frames, int nFrames, uint32_t frameMs);
+XENO_TileId XENO_addTilesetTimeline(XENO_Animator *animator, const XENO_Tileset *tileset, XENO_TileId first,
+                                    uint32_t frameMs);
+void XENO_setTimelineFrame(XENO_Animator *animator, XENO_TileId tile, int frame);
+int XENO_updateAnimations(XENO_Animator *animator, uint32_t elapsedMs);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_ANIMATION_H_
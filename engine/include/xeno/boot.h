@@ -0,0 +1,31 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_BOOT_H_
+#define _XENO_BOOT_H_
+
+#include <SDL2/SDL_stdinc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Phases recorded until XENO_finishBoot; more are dropped, and counted
+#define XENO_BOOT_MAX_PHASES 64
+#define XENO_BOOT_MAX_DEPTH 8
+
+// Boot phases are timed on the thread that begins the first one. Calls from any other
+// thread, or after XENO_finishBoot, are ignored, so they can stay in code that also
+// runs after startup.
+void XENO_beginBootPhase(const char *name, const char *detail);
+void XENO_endBootPhase(void);
+void XENO_finishBoot(void);
+Uint32 XENO_bootMilliseconds(void);
+void XENO_printBootWaterfall(void);
+int XENO_checkBootBudget(Uint32 budgetMs);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_BOOT_H_
@@ -0,0 +1,28 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_CHUNKCACHE_H_
+#define _XENO_CHUNKCACHE_H_
+
+#include <stddef.h>
+#include <xeno/tilemap.h>
+#include <xeno/framearena.h>
+#include <SDL2/SDL_render.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct XENO_ChunkCache XENO_ChunkCache;
+
+XENO_ChunkCache * XENO_createChunkCache(SDL_Renderer *renderer, XENO_TileMap *map, size_t budgetBytes,
+                                        XENO_FrameArena *arena);
+void XENO_destroyChunkCache(XENO_ChunkCache *cache);
+void XENO_invalidateChunkCache(XENO_ChunkCache *cache);
+int XENO_renderStaticLayers(XENO_ChunkCache *cache, const SDL_Rect *view);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_CHUNKCACHE_H_
@@ -0,0 +1,43 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_DIRTYRECTS_H_
+#define _XENO_DIRTYRECTS_H_
+
+#include <xeno/tilemap.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+#include <SDL2/SDL_video.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XENO_MAX_DIRTY_RECTS 16
+
+typedef struct XENO_DirtyRects {
+  SDL_Rect screen;
+  SDL_Rect rects[XENO_MAX_DIRTY_RECTS];
+  int count;
+  int full;    // The whole screen needs redrawing
+  int partial; // Screen contents survive a present (software path), so partial redraws are valid
+} XENO_DirtyRects;
+
+typedef void (*XENO_DrawRegionFn)(SDL_Renderer *renderer, const SDL_Rect *region, void *userdata);
+
+void XENO_initDirtyRects(XENO_DirtyRects *dirty, int width, int height, int partial);
+void XENO_clearDirtyRects(XENO_DirtyRects *dirty);
+void XENO_markDirty(XENO_DirtyRects *dirty, const SDL_Rect *rect);
+void XENO_markAllDirty(XENO_DirtyRects *dirty);
+void XENO_markSpriteMoved(XENO_DirtyRects *dirty, const SDL_Rect *from, const SDL_Rect *to);
+void XENO_markCellDirty(XENO_DirtyRects *dirty, const XENO_TileMap *map, int x, int y, const SDL_Rect *view);
+void XENO_markMapDirty(XENO_DirtyRects *dirty, XENO_TileMap *map, const SDL_Rect *view);
+int XENO_getDirtyRects(const XENO_DirtyRects *dirty, const SDL_Rect **rects);
+int XENO_renderDirty(SDL_Renderer *renderer, XENO_DirtyRects *dirty, XENO_DrawRegionFn draw, void *userdata);
+int XENO_presentDirty(SDL_Window *window, SDL_Renderer *renderer, XENO_DirtyRects *dirty);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_DIRTYRECTS_H_
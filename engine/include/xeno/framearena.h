@@ -0,0 +1,92 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_FRAMEARENA_H_
+#define _XENO_FRAMEARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <xeno/allocator.h>
+
+#ifdef __cplusplus
+#include <new>
+
+extern "C" {
+#endif
+
+typedef struct XENO_FrameBuffer {
+  char *base;
+  size_t used;
+  size_t overflowBytes;
+  void *overflow;       // Heap blocks for what didn't fit, chained through their first word
+} XENO_FrameBuffer;
+
+/** Scratch memory that lives for two frames. Allocating bumps a pointer; nothing
+ *  is freed individually. XENO_beginFrameArena switches to the other buffer and
+ *  empties it, so what was allocated last frame is still there this frame. */
+typedef struct XENO_FrameArena {
+  XENO_FrameBuffer buffers[2];
+  int current;
+  size_t capacity;      // Bytes per frame before allocations overflow to the heap
+  XENO_MemTag tag;      // Charged for the buffers and any overflow
+  uint64_t frames;
+  size_t peak;          // Most bytes a frame has used, overflow included
+  uint32_t overflows;   // Allocations that went to the heap
+  uint32_t overruns;    // Debug builds: allocations written past their end
+} XENO_FrameArena;
+
+XENO_FrameArena * XENO_createFrameArena(size_t bytesPerFrame, XENO_MemTag tag);
+void XENO_destroyFrameArena(XENO_FrameArena *arena);
+void XENO_beginFrameArena(XENO_FrameArena *arena);
+void * XENO_frameAlloc(XENO_FrameArena *arena, size_t size);
+
+#ifdef __cplusplus
+}
+
+/** Lets standard containers allocate from a frame arena, e.g.
+ *  std::vector<int, XENO_FrameAllocator<int> > v(XENO_FrameAllocator<int>(arena));
+ *  Deallocating does nothing; the memory comes back when the frame is recycled. */
+template <typename T>
+class XENO_FrameAllocator {
+public:
+  typedef T value_type;
+  typedef T *pointer;
+  typedef const T *const_pointer;
+  typedef T &reference;
+  typedef const T &const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <typename U>
+  struct rebind {
+    typedef XENO_FrameAllocator<U> other;
+  };
+
+  explicit XENO_FrameAllocator(XENO_FrameArena *arena) : arena(arena) {}
+  template <typename U>
+  XENO_FrameAllocator(const XENO_FrameAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(size_t n, const void * = 0) { return (T *) XENO_frameAlloc(arena, n * sizeof(T)); }
+  void deallocate(T *, size_t) {}
+
+  size_t max_size() const { return (size_t) -1 / sizeof(T); }
+  T *address(T &x) const { return &x; }
+  const T *address(const T &x) const { return &x; }
+  void construct(T *p, const T &value) { new ((void *) p) T(value); }
+  void destroy(T *p) { p->~T(); }
+
+  XENO_FrameArena *arena;
+};
+
+template <typename T, typename U>
+bool operator==(const XENO_FrameAllocator<T> &a, const XENO_FrameAllocator<U> &b) {
+  return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const XENO_FrameAllocator<T> &a, const XENO_FrameAllocator<U> &b) {
+  return a.arena != b.arena;
+}
+#endif
+#endif //_XENO_FRAMEARENA_H_
@@ -5,13 +5,23 @@
 #ifndef _XENO_IMAGEUTILS_H_
 #define _XENO_IMAGEUTILS_H_
 
+#include <stdint.h>
 #include <SDL2/SDL_render.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct XENO_RenderStats {
+  uint64_t drawCalls;        // Texture copies issued by engine draw paths
+  uint64_t bytesUploaded;    // Surface bytes handed to SDL_CreateTextureFromSurface
+  uint64_t chunksRasterized; // Chunk cache re-renders
+} XENO_RenderStats;
+
+extern XENO_RenderStats XENO_renderStats;
+
 SDL_Texture * XENO_LoadBMPTexture(SDL_Renderer *renderer, const char *filename);
+void XENO_resetRenderStats(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,72 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_MAINLOOP_H_
+#define _XENO_MAINLOOP_H_
+
+#include <stdint.h>
+#include <SDL2/SDL_events.h>
+#include <xeno/framearena.h>
+#include <xeno/dirtyrects.h>
+#include <xeno/animation.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Frame times are binned in whole milliseconds; the last bucket collects everything slower
+#define XENO_FRAME_HISTOGRAM_BUCKETS 64
+
+typedef enum {
+  XENO_PACING_NONE = 0, // Run flat out (benchmarks)
+  XENO_PACING_VSYNC,    // The renderer was created with SDL_RENDERER_PRESENTVSYNC
+  XENO_PACING_SLEEP     // Sleep until the next frame is due
+} XENO_Pacing;
+
+typedef struct XENO_MainLoop {
+  // Configuration; XENO_initMainLoop fills in defaults
+  int tickRate;         // Simulation ticks per second
+  int maxTicksPerFrame; // Spiral-of-death guard: simulation time beyond this is dropped
+  int frameRate;        // Target frame rate for XENO_PACING_SLEEP
+  XENO_Pacing pacing;
+  uint64_t maxFrames;   // Stops the loop after this many frames if nonzero
+  XENO_FrameArena *arena; // Optional; begun at the start of every frame
+  XENO_Animator *animator; // Optional; advanced by each tick's length before update runs
+
+  // Optional dirty mode: render only redraws the dirty regions (see XENO_renderDirty) and
+  // the loop presents them with XENO_presentDirty; nothing dirty makes an idle frame
+  XENO_DirtyRects *dirty;
+  SDL_Window *window;     // For partial presents on the software path
+  SDL_Renderer *renderer;
+
+  // Callbacks; event returns nonzero to quit, render returns nonzero if it presented a frame
+  // (ignored in dirty mode)
+  int (*event)(const SDL_Event *event, void *userdata);
+  void (*update)(double dt, void *userdata);
+  int (*render)(double alpha, void *userdata);
+  void *userdata;
+
+  // State and statistics
+  int done;
+  uint64_t ticks;
+  uint64_t frames;
+  uint64_t idleFrames;
+  uint64_t droppedTicks;
+  uint64_t dirtyPixels; // Presented in dirty mode
+  uint64_t spinMicros;  // Busy-waited by XENO_PACING_SLEEP, under a millisecond a frame
+  uint64_t heapAllocs;  // Made during frames after the first, which is allowed to warm up
+  uint64_t allocFrames; // Frames that made any; 0 in a steady state
+  uint32_t histogram[XENO_FRAME_HISTOGRAM_BUCKETS];
+} XENO_MainLoop;
+
+void XENO_initMainLoop(XENO_MainLoop *loop, int tickRate);
+void XENO_runMainLoop(XENO_MainLoop *loop);
+void XENO_stopMainLoop(XENO_MainLoop *loop);
+int XENO_frameTimePercentile(const XENO_MainLoop *loop, int percentile);
+void XENO_printFrameHistogram(const XENO_MainLoop *loop);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_MAINLOOP_H_
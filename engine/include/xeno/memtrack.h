@@ -0,0 +1,36 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_MEMTRACK_H_
+#define _XENO_MEMTRACK_H_
+
+#include <xeno/allocator.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Allocation sites are told apart by this many frames of their call stack. Sampled
+// allocations from more sites than fit are lumped together.
+#define XENO_MEMTRACK_DEPTH 8
+#define XENO_MEMTRACK_SITES 512
+
+// Allocations this big are always sampled; they're few, and they're what runs a heap out
+#define XENO_MEMTRACK_LARGE 4096
+
+// Sites printed when the allocator reports crossing its watermark or running out
+#define XENO_MEMTRACK_TOP 16
+
+// Built with MEMTRACK=y (XENO_MEMTRACK), the allocator passes every allocation and
+// free through these; otherwise nothing is tracked and the dump is empty
+int XENO_trackAlloc(XENO_MemTag tag, size_t size);
+void XENO_trackFree(int site, size_t size);
+
+void XENO_setMemSampling(uint32_t every);
+void XENO_dumpMemSites(int maxSites);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_MEMTRACK_H_
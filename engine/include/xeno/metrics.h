@@ -0,0 +1,95 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_METRICS_H_
+#define _XENO_METRICS_H_
+
+#include <stdint.h>
+#include <SDL2/SDL_stdinc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  XENO_METRIC_COUNTER = 0, // Only goes up; dumps include the rate since the last dump
+  XENO_METRIC_GAUGE,       // A current value, set or adjusted
+  XENO_METRIC_HISTOGRAM    // A distribution of 32-bit values
+} XENO_MetricType;
+
+typedef enum {
+  XENO_METRICS_TEXT = 0,
+  XENO_METRICS_JSON
+} XENO_MetricsFormat;
+
+// Histogram buckets are exact below 8, then split every power of two eight ways,
+// so a bucket is never more than 12.5% wide
+#define XENO_HISTOGRAM_SUB_BITS 3
+#define XENO_HISTOGRAM_BUCKETS ((32 - XENO_HISTOGRAM_SUB_BITS + 1) << XENO_HISTOGRAM_SUB_BITS)
+
+/** What every metric starts with. Metrics are statics at the code they measure, and join
+ *  the registry the first time they're updated; from then on they must stay alive. */
+typedef struct XENO_Metric {
+  const char *name; // Both must outlive the metric, e.g. string literals
+  const char *unit;
+  XENO_MetricType type;
+  volatile int registered;
+  struct XENO_Metric *next;
+} XENO_Metric;
+
+typedef struct XENO_Counter {
+  XENO_Metric metric;
+  uint64_t value;
+  uint64_t dumped; // value at the last dump
+} XENO_Counter;
+
+typedef struct XENO_Gauge {
+  XENO_Metric metric;
+  int64_t value;
+} XENO_Gauge;
+
+typedef struct XENO_Histogram {
+  XENO_Metric metric;
+  uint64_t count;
+  uint64_t sum;
+  uint32_t max;
+  uint32_t buckets[XENO_HISTOGRAM_BUCKETS];
+} XENO_Histogram;
+
+// Static initializers, e.g. static XENO_Counter reads = XENO_COUNTER("fs.reads", "reads");
+#define XENO_COUNTER(name, unit) {{(name), (unit), XENO_METRIC_COUNTER, 0, NULL}, 0, 0}
+#define XENO_GAUGE(name, unit) {{(name), (unit), XENO_METRIC_GAUGE, 0, NULL}, 0}
+#define XENO_HISTOGRAM(name, unit) {{(name), (unit), XENO_METRIC_HISTOGRAM, 0, NULL}, 0, 0, 0, {0}}
+
+void XENO_registerMetric(XENO_Metric *metric);
+void XENO_recordHistogram(XENO_Histogram *histogram, uint32_t value);
+void XENO_recordMicroseconds(XENO_Histogram *histogram, Uint64 since);
+uint32_t XENO_histogramPercentile(const XENO_Histogram *histogram, int percentile);
+int XENO_dumpMetrics(const char *filename, XENO_MetricsFormat format);
+void XENO_setMetricsDump(const char *filename, XENO_MetricsFormat format, Uint32 intervalMs);
+void XENO_pollMetricsDump(void);
+
+// Updates are single atomic operations; only a metric's first update takes a lock
+static inline void XENO_addCounter(XENO_Counter *counter, uint64_t n) {
+  if (!counter->metric.registered)
+    XENO_registerMetric(&counter->metric);
+  __atomic_fetch_add(&counter->value, n, __ATOMIC_RELAXED);
+}
+
+static inline void XENO_setGauge(XENO_Gauge *gauge, int64_t value) {
+  if (!gauge->metric.registered)
+    XENO_registerMetric(&gauge->metric);
+  __atomic_store_n(&gauge->value, value, __ATOMIC_RELAXED);
+}
+
+static inline void XENO_addGauge(XENO_Gauge *gauge, int64_t delta) {
+  if (!gauge->metric.registered)
+    XENO_registerMetric(&gauge->metric);
+  __atomic_fetch_add(&gauge->value, delta, __ATOMIC_RELAXED);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_METRICS_H_
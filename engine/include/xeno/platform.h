@@ -26,4 +26,10 @@
   #define debugSleep(n)
 #endif
 
+#ifdef _MSC_VER
+  #define XENO_THREADLOCAL __declspec(thread)
+#else
+  #define XENO_THREADLOCAL __thread
+#endif
+
 #endif //_XENO_PLATFORM_H_
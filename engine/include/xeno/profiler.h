@@ -0,0 +1,63 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_PROFILER_H_
+#define _XENO_PROFILER_H_
+
+#include <stdint.h>
+#include <SDL2/SDL_timer.h>
+
+// Zones are stamped with the TSC where there is one: reading it costs a fraction of
+// SDL_GetPerformanceCounter, and the exporter converts it against that clock
+#if ((defined __i386__) || (defined __x86_64__)) && (defined __GNUC__)
+  #include <x86intrin.h>
+  #define XENO_zoneClock() ((Uint64) __rdtsc())
+#else
+  #define XENO_zoneClock() SDL_GetPerformanceCounter()
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Zones recorded per thread between exports; more are dropped, and counted
+#define XENO_ZONE_RING_SIZE 8192
+
+typedef struct XENO_Zone {
+  const char *name;
+  Uint64 begin;
+} XENO_Zone;
+
+// XENO_zoneClock() when the first zone began; trace timestamps count from here
+extern Uint64 XENO_zoneEpoch;
+void XENO_startZoneClock(void);
+
+/** Starts timing a zone. 'name' must outlive the trace, e.g. a string literal. */
+static inline XENO_Zone XENO_beginZone(const char *name) {
+  XENO_Zone zone;
+  zone.name = name;
+  if (!__atomic_load_n(&XENO_zoneEpoch, __ATOMIC_ACQUIRE))
+    XENO_startZoneClock();
+  zone.begin = XENO_zoneClock();
+  return zone;
+}
+
+void XENO_endZone(const XENO_Zone *zone);
+int XENO_exportTrace(const char *filename);
+
+// XENO_ZONE("name") times the rest of the enclosing block. Built with PROFILE=y
+// (XENO_PROFILE) only; otherwise it compiles to nothing.
+#ifdef XENO_PROFILE
+  #define XENO_ZONE_CONCAT2(a, b) a##b
+  #define XENO_ZONE_CONCAT(a, b) XENO_ZONE_CONCAT2(a, b)
+  #define XENO_ZONE(name) \
+    XENO_Zone XENO_ZONE_CONCAT(xenoZone, __LINE__) __attribute__((cleanup(XENO_endZone))) = XENO_beginZone(name)
+#else
+  #define XENO_ZONE(name) do {} while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_PROFILER_H_
@@ -0,0 +1,81 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_TILEMAP_H_
+#define _XENO_TILEMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cells per chunk edge; chunks are the unit of render caching and invalidation
+#define XENO_CHUNK_SIZE 8
+
+// Layers below this index are considered static and get cached per chunk
+#define XENO_STATIC_LAYERS 2
+
+// Cell edits remembered for dirty tracking; past this many the whole map counts as changed
+#define XENO_MAX_CHANGED_CELLS 64
+
+typedef uint16_t XENO_TileId; // Index into the map's tile table; 0 is an empty cell
+
+typedef enum {
+  XENO_LAYER_GROUND = 0,
+  XENO_LAYER_WALL,
+  XENO_LAYER_OBJECT,
+  XENO_LAYER_COUNT
+} XENO_Layer;
+
+typedef enum {
+  XENO_PROJECTION_ORTHO = 0,
+  XENO_PROJECTION_ISO
+} XENO_Projection;
+
+typedef struct XENO_Tile {
+  SDL_Texture *texture;
+  SDL_Rect frame;    // Source rectangle within the texture
+  SDL_Point offset;  // Position of the frame inside the tile canvas
+  uint16_t timeline; // 1 + index of the animation timeline driving this tile, or 0 if static
+} XENO_Tile;
+
+typedef struct XENO_TileMap {
+  XENO_Projection projection;
+  int width, height;       // Size in cells
+  int stepX, stepY;        // Screen distance between neighbouring cells (half steps on iso maps)
+  int canvasW, canvasH;    // Size of the canvas every tile frame is placed in
+  XENO_Tile *tiles;        // Tile table; entry 0 is reserved for empty cells
+  size_t nTiles, capTiles;
+  XENO_TileId *cells[XENO_LAYER_COUNT];
+  int chunksX, chunksY;
+  uint32_t *chunkRevision; // Bumped whenever a static cell in the chunk changes
+  uint64_t *chunkTimelines; // Per chunk, bit (timeline % 64) is set if a static cell uses that timeline
+  int *animatedChunks;      // Chunks with any timeline bits set
+  int nAnimatedChunks;
+  SDL_Point changedCells[XENO_MAX_CHANGED_CELLS]; // Edited since XENO_markMapDirty last looked
+  int nChangedCells;        // One past XENO_MAX_CHANGED_CELLS if some edits weren't recorded
+  uint64_t changedTimelines; // Bit (timeline % 64) is set for timelines that moved to another frame
+} XENO_TileMap;
+
+XENO_TileMap * XENO_createTileMap(XENO_Projection projection, int width, int height, int canvasW, int canvasH);
+void XENO_destroyTileMap(XENO_TileMap *map);
+XENO_TileId XENO_addTile(XENO_TileMap *map, const XENO_Tile *tile);
+void XENO_setCell(XENO_TileMap *map, int layer, int x, int y, XENO_TileId id);
+XENO_TileId XENO_getCell(const XENO_TileMap *map, int layer, int x, int y);
+void XENO_touchChunk(XENO_TileMap *map, int cx, int cy);
+void XENO_cellToWorld(const XENO_TileMap *map, int x, int y, SDL_Point *out);
+void XENO_getChunkBounds(const XENO_TileMap *map, int cx, int cy, SDL_Rect *out);
+void XENO_getChunkRange(const XENO_TileMap *map, const SDL_Rect *view, SDL_Rect *out);
+int XENO_drawTile(SDL_Renderer *renderer, const XENO_Tile *tile, int x, int y);
+void XENO_drawCells(SDL_Renderer *renderer, const XENO_TileMap *map, int firstLayer, int lastLayer,
+                    const SDL_Rect *cells, int originX, int originY);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_TILEMAP_H_
@@ -0,0 +1,39 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_TILESET_H_
+#define _XENO_TILESET_H_
+
+#include <xeno/tilemap.h>
+#include <SDL2/SDL_render.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XENO_TILESET_NAME_MAX 48
+
+typedef struct XENO_TilesetFrame {
+  char id[XENO_TILESET_NAME_MAX]; // e.g. "doorOpen_1.png"
+  SDL_Rect frame;
+  SDL_Point offset;
+} XENO_TilesetFrame;
+
+typedef struct XENO_Tileset {
+  char name[XENO_TILESET_NAME_MAX]; // Descriptor file name without extension, e.g. "doorOpen"
+  SDL_Texture *texture;
+  int canvasW, canvasH;
+  int nFrames;
+  XENO_TilesetFrame *frames;
+} XENO_Tileset;
+
+XENO_Tileset * XENO_loadTileset(SDL_Renderer *renderer, const char *xmlPath);
+void XENO_destroyTileset(XENO_Tileset *tileset);
+int XENO_findTilesetFrame(const XENO_Tileset *tileset, const char *id);
+XENO_TileId XENO_addTilesetToMap(XENO_TileMap *map, const XENO_Tileset *tileset);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //_XENO_TILESET_H_
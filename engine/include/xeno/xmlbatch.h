@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_XMLBATCH_H_
+#define _XENO_XMLBATCH_H_
+
+#include <stddef.h>
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+#include <tinyxml2.h>
+
+// Batch flags
+#define XENO_XML_UNQUOTED_ATTRIBUTES 0x1 // See tinyxml2::XMLDocument::SetUnquotedAttributes
+#define XENO_XML_COLLAPSE_WHITESPACE 0x2
+
+typedef enum {
+  XENO_XML_AS_COMPLETED = 0, // Concurrently from the workers, as each document is parsed
+  XENO_XML_IN_ORDER          // One at a time, in the order the paths were given
+} XENO_XMLBatchOrder;
+
+/** Receives each document of a batch. 'doc' is NULL if the file couldn't be read; otherwise
+ *  check doc->Error(). The document belongs to the worker and is reused for its next file,
+ *  so copy out what's needed before returning. */
+typedef void (*XENO_XMLBatchCallback)(int index, const char *path, const tinyxml2::XMLDocument *doc, void *userdata);
+
+struct XENO_XMLBatch;
+
+typedef struct XENO_XMLWorker {
+  struct XENO_XMLBatch *batch;
+  SDL_Thread *thread;           // NULL for worker 0, which is the thread calling XENO_parseXMLBatch
+  tinyxml2::XMLArena *arena;
+  tinyxml2::XMLDocument *doc;
+  char *buffer;                 // File contents, parsed in place
+  size_t capBuffer;
+} XENO_XMLWorker;
+
+typedef struct XENO_XMLBatch {
+  XENO_XMLWorker *workers;
+  int nWorkers;
+  SDL_mutex *lock;
+  SDL_cond *wake;      // Workers wait here for a job, and for their turn in XENO_XML_IN_ORDER
+  SDL_cond *done;      // The caller waits here for the workers to finish a job
+  int generation;      // Bumped for every job
+  int nFinished;       // Threads done with the current job
+  SDL_bool quit;
+
+  // The current job
+  const char * const *paths;
+  int nPaths;
+  XENO_XMLBatchOrder order;
+  XENO_XMLBatchCallback callback;
+  void *userdata;
+  SDL_atomic_t next;   // Next path to claim
+  SDL_atomic_t nParsed;
+  int turn;            // Next index to hand back in XENO_XML_IN_ORDER
+} XENO_XMLBatch;
+
+XENO_XMLBatch * XENO_createXMLBatch(int nWorkers, int flags);
+void XENO_destroyXMLBatch(XENO_XMLBatch *batch);
+int XENO_parseXMLBatch(XENO_XMLBatch *batch, const char * const *paths, int nPaths, XENO_XMLBatchOrder order,
+                       XENO_XMLBatchCallback callback, void *userdata);
+
+#endif //_XENO_XMLBATCH_H_
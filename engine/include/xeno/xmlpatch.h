@@ -0,0 +1,44 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_XMLPATCH_H_
+#define _XENO_XMLPATCH_H_
+
+#include <tinyxml2.h>
+
+typedef enum {
+  XENO_XML_ELEMENT_ADDED = 0, // element is the root of a subtree new to the live document
+  XENO_XML_ELEMENT_REMOVED,   // element is no longer in the live document, see XENO_XMLChangeSet
+  XENO_XML_ELEMENT_CHANGED    // element was updated in place; 'what' says how
+} XENO_XMLChangeType;
+
+// What changed about a XENO_XML_ELEMENT_CHANGED element
+#define XENO_XML_ATTRIBUTES_CHANGED 0x1
+#define XENO_XML_TEXT_CHANGED       0x2 // Its text children
+#define XENO_XML_CHILDREN_CHANGED   0x4 // Child elements were added, removed or reordered
+
+typedef struct XENO_XMLChange {
+  XENO_XMLChangeType type;
+  int what;
+  tinyxml2::XMLElement *element;
+  tinyxml2::XMLNode *parent;        // The live parent it was added to or removed from
+} XENO_XMLChange;
+
+/** The changes made by XENO_patchXML. Removed elements are kept, unlinked, until the set
+ *  is cleared, so their pointers stay valid for whoever is dropping what they cached
+ *  from them. Zero it before first use, and clear it before clearing or deleting the
+ *  live document. */
+typedef struct XENO_XMLChangeSet {
+  XENO_XMLChange *changes;
+  int nChanges;
+  int capChanges;
+  tinyxml2::XMLDocument *doc;       // The live document
+  tinyxml2::XMLElement *removed;    // Parent of the removed elements
+} XENO_XMLChangeSet;
+
+bool XENO_patchXML(tinyxml2::XMLDocument *live, const tinyxml2::XMLDocument *next, XENO_XMLChangeSet *changes);
+bool XENO_reloadXML(tinyxml2::XMLDocument *live, const char *filename, XENO_XMLChangeSet *changes);
+void XENO_clearXMLChanges(XENO_XMLChangeSet *changes);
+
+#endif //_XENO_XMLPATCH_H_
@@ -0,0 +1,48 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#ifndef _XENO_XMLUTILS_H_
+#define _XENO_XMLUTILS_H_
+
+#include <physfs.h>
+#include <tinyxml2.h>
+
+/** Feeds a tinyxml2::XMLStreamReader from a PhysFS file, so documents are read
+ *  in chunks instead of being buffered whole. */
+class XENO_PhysFSInputStream : public tinyxml2::XMLInputStream {
+public:
+  explicit XENO_PhysFSInputStream(const char *filename);
+  ~XENO_PhysFSInputStream();
+
+  bool isOpen() const { return file != NULL; }
+  virtual int Read(char *buffer, int size);
+
+private:
+  XENO_PhysFSInputStream(const XENO_PhysFSInputStream &); // not supported
+  void operator=(const XENO_PhysFSInputStream &);         // not supported
+
+  PHYSFS_File *file;
+};
+
+/** Takes a tinyxml2::XMLPrinter's output and writes it to a file in the PhysFS
+ *  write directory, a chunk at a time. */
+class XENO_PhysFSOutputStream : public tinyxml2::XMLOutputStream {
+public:
+  explicit XENO_PhysFSOutputStream(const char *filename);
+  ~XENO_PhysFSOutputStream();
+
+  bool isOpen() const { return file != NULL; }
+  bool close();
+  virtual bool Write(const char *data, int size);
+
+private:
+  XENO_PhysFSOutputStream(const XENO_PhysFSOutputStream &); // not supported
+  void operator=(const XENO_PhysFSOutputStream &);          // not supported
+
+  PHYSFS_File *file;
+};
+
+bool XENO_saveXML(const tinyxml2::XMLDocument *doc, const char *filename, bool compact);
+
+#endif //_XENO_XMLUTILS_H_
@@ -0,0 +1,194 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/mainloop.h>
+#include <xeno/profiler.h>
+#include <xeno/metrics.h>
+#include <SDL2/SDL.h>
+#include <string.h>
+#include <assert.h>
+
+static XENO_Histogram XENO_frameTime = XENO_HISTOGRAM("frame.time", "us");
+static XENO_Counter XENO_frameCount = XENO_COUNTER("frame.frames", "frames");
+static XENO_Counter XENO_idleFrameCount = XENO_COUNTER("frame.idle", "frames");
+static XENO_Counter XENO_droppedTickCount = XENO_COUNTER("frame.dropped_ticks", "ticks");
+static XENO_Counter XENO_frameHeapAllocs = XENO_COUNTER("frame.heap_allocs", "allocations");
+static XENO_Gauge XENO_frameArenaPeak = XENO_GAUGE("frame.arena_peak", "bytes");
+
+void XENO_initMainLoop(XENO_MainLoop *loop, int tickRate) {
+  assert(loop && tickRate > 0);
+  memset(loop, 0, sizeof(XENO_MainLoop));
+  loop->tickRate = tickRate;
+  loop->maxTicksPerFrame = 5;
+  loop->frameRate = 60;
+  loop->pacing = XENO_PACING_SLEEP;
+}
+
+
+static void XENO_dispatchEvent(XENO_MainLoop *loop, const SDL_Event *event) {
+  if (event->type == SDL_QUIT)
+    loop->done = 1;
+  else if (loop->event && loop->event(event, loop->userdata))
+    loop->done = 1;
+}
+
+
+// SDL_Delay only has millisecond resolution, so sleep whole milliseconds while at
+// least one is left and spin on the performance counter for the rest. Returns the
+// performance counter ticks spent spinning.
+static Uint64 XENO_sleepUntil(Uint64 deadline, Uint64 freq) {
+  Uint64 now = SDL_GetPerformanceCounter();
+  while (now < deadline && (deadline - now) * 1000 / freq > 0) {
+    SDL_Delay((Uint32) ((deadline - now) * 1000 / freq));
+    now = SDL_GetPerformanceCounter();
+  }
+
+  const Uint64 spinStart = now;
+  while (now < deadline)
+    now = SDL_GetPerformanceCounter();
+  return now - spinStart;
+}
+
+
+/** Runs fixed-rate simulation ticks with interpolated rendering until the loop is stopped. */
+void XENO_runMainLoop(XENO_MainLoop *loop) {
+  assert(loop && loop->update && loop->render);
+  const Uint64 freq = SDL_GetPerformanceFrequency();
+  const Uint64 tickLen = freq / loop->tickRate;
+  const Uint64 frameLen = freq / (loop->frameRate > 0 ? loop->frameRate : loop->tickRate);
+  Uint64 previous = SDL_GetPerformanceCounter();
+  Uint64 accumulator = 0;
+  uint32_t allocs = XENO_countHeapAllocs();
+  SDL_Event event;
+
+  loop->done = 0;
+  while (!loop->done) {
+    XENO_ZONE("frame");
+    Uint64 frameStart = SDL_GetPerformanceCounter();
+    Uint64 elapsed = frameStart - previous;
+    previous = frameStart;
+    accumulator += elapsed;
+
+    // Counted frame to frame, so nothing is missed between frames either
+    uint32_t nowAllocs = XENO_countHeapAllocs();
+    if (loop->frames) {
+      Uint64 ms = elapsed * 1000 / freq;
+      ++loop->histogram[ms < XENO_FRAME_HISTOGRAM_BUCKETS ? ms : XENO_FRAME_HISTOGRAM_BUCKETS - 1];
+      Uint64 us = elapsed * 1000000 / freq;
+      XENO_recordHistogram(&XENO_frameTime, us < 0xFFFFFFFF ? (uint32_t) us : 0xFFFFFFFF);
+      if (loop->frames > 1 && nowAllocs != allocs) {
+        loop->heapAllocs += nowAllocs - allocs;
+        ++loop->allocFrames;
+        XENO_addCounter(&XENO_frameHeapAllocs, nowAllocs - allocs);
+      }
+    }
+    allocs = nowAllocs;
+
+    if (loop->arena) {
+      XENO_beginFrameArena(loop->arena);
+      XENO_setGauge(&XENO_frameArenaPeak, (int64_t) loop->arena->peak);
+    }
+    XENO_pollMetricsDump();
+
+    while (SDL_PollEvent(&event))
+      XENO_dispatchEvent(loop, &event);
+
+    int n = 0;
+    while (accumulator >= tickLen && n < loop->maxTicksPerFrame) {
+      // Whole milliseconds per tick, carrying the remainder so the animation clock doesn't drift
+      if (loop->animator)
+        XENO_updateAnimations(loop->animator, (uint32_t) ((loop->ticks + 1) * 1000 / loop->tickRate
+                                                          - loop->ticks * 1000 / loop->tickRate));
+      loop->update((double) tickLen / freq, loop->userdata);
+      accumulator -= tickLen;
+      ++loop->ticks;
+      ++n;
+    }
+
+    // Can't keep up; drop the backlog instead of spending ever longer catching up
+    if (accumulator >= tickLen) {
+      loop->droppedTicks += accumulator / tickLen;
+      XENO_addCounter(&XENO_droppedTickCount, accumulator / tickLen);
+      accumulator %= tickLen;
+    }
+
+    int presented = loop->render((double) accumulator / tickLen, loop->userdata);
+    if (loop->dirty) {
+      const SDL_Rect *rects;
+      int n = XENO_getDirtyRects(loop->dirty, &rects);
+      for (int i = 0; i < n; ++i)
+        loop->dirtyPixels += (uint64_t) rects[i].w * rects[i].h;
+      presented = XENO_presentDirty(loop->window, loop->renderer, loop->dirty) != 0;
+    }
+    ++loop->frames;
+    XENO_addCounter(&XENO_frameCount, 1);
+    if (loop->maxFrames && loop->frames >= loop->maxFrames)
+      loop->done = 1;
+
+    if (!presented) {
+      // Nothing changed on screen, so block on input until the next tick is due
+      ++loop->idleFrames;
+      XENO_addCounter(&XENO_idleFrameCount, 1);
+      Uint32 ms = (Uint32) ((tickLen - accumulator) * 1000 / freq);
+      if (SDL_WaitEventTimeout(&event, ms ? ms : 1))
+        XENO_dispatchEvent(loop, &event);
+    } else if (loop->pacing == XENO_PACING_SLEEP) {
+      loop->spinMicros += XENO_sleepUntil(frameStart + frameLen, freq) * 1000000 / freq;
+    }
+  }
+}
+
+
+void XENO_stopMainLoop(XENO_MainLoop *loop) {
+  assert(loop);
+  loop->done = 1;
+}
+
+
+/** Gets an upper bound, in milliseconds, for the given percentile of recorded frame times. */
+int XENO_frameTimePercentile(const XENO_MainLoop *loop, int percentile) {
+  assert(loop);
+  uint64_t total = 0, seen = 0;
+  for (int i = 0; i < XENO_FRAME_HISTOGRAM_BUCKETS; ++i)
+    total += loop->histogram[i];
+  if (!total)
+    return 0;
+
+  uint64_t target = (total * percentile + 99) / 100;
+  for (int i = 0; i < XENO_FRAME_HISTOGRAM_BUCKETS; ++i) {
+    seen += loop->histogram[i];
+    if (seen >= target)
+      return i + 1;
+  }
+  return XENO_FRAME_HISTOGRAM_BUCKETS;
+}
+
+
+void XENO_printFrameHistogram(const XENO_MainLoop *loop) {
+  assert(loop);
+  debugPrint("Frames: %llu (%llu idle), ticks: %llu (%llu dropped)\n",
+             (unsigned long long) loop->frames, (unsigned long long) loop->idleFrames,
+             (unsigned long long) loop->ticks, (unsigned long long) loop->droppedTicks);
+  if (loop->pacing == XENO_PACING_SLEEP)
+    debugPrint("Pacing: %llu us spinning, %llu per frame\n", (unsigned long long) loop->spinMicros,
+               (unsigned long long) (loop->frames ? loop->spinMicros / loop->frames : 0));
+  if (loop->dirty)
+    debugPrint("Dirty pixels: %llu presented, %llu per frame\n", (unsigned long long) loop->dirtyPixels,
+               (unsigned long long) (loop->frames ? loop->dirtyPixels / loop->frames : 0));
+  debugPrint("Heap allocations: %llu in %llu frames\n", (unsigned long long) loop->heapAllocs,
+             (unsigned long long) loop->allocFrames);
+  if (loop->arena)
+    debugPrint("Frame arena: peak %lu of %lu bytes, %lu overflows, %lu overruns\n",
+               (unsigned long) loop->arena->peak, (unsigned long) loop->arena->capacity,
+               (unsigned long) loop->arena->overflows, (unsigned long) loop->arena->overruns);
+  for (int i = 0; i < XENO_FRAME_HISTOGRAM_BUCKETS; ++i) {
+    if (loop->histogram[i])
+      debugPrint("  %2d ms%s: %lu\n", i, i == XENO_FRAME_HISTOGRAM_BUCKETS - 1 ? "+" : " ",
+                 (unsigned long) loop->histogram[i]);
+  }
+  debugPrint("  p50 <= %d ms, p95 <= %d ms, p99 <= %d ms\n", XENO_frameTimePercentile(loop, 50),
+             XENO_frameTimePercentile(loop, 95), XENO_frameTimePercentile(loop, 99));
+}
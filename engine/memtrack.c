@@ -0,0 +1,200 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/memtrack.h>
+#include <SDL2/SDL.h>
+#include <string.h>
+#include <assert.h>
+
+#if (defined __GLIBC__)
+  #include <execinfo.h>
+  #include <stdio.h>
+  #include <unistd.h>
+#elif (defined _WIN32) && !(defined XENO_PLATFORM_NXDK)
+  #include <windows.h>
+#endif
+
+// Frames belonging to the tracker and the allocator, left off every stack
+#define XENO_MEMTRACK_SKIP 3
+
+typedef struct XENO_MemSite {
+  uint32_t hash;
+  int nFrames; // 0 for an unused slot
+  void *frames[XENO_MEMTRACK_DEPTH];
+  XENO_MemTag tag; // Of the first allocation seen from here
+  size_t liveBytes;
+  size_t peakBytes;
+  uint32_t nAllocs;
+} XENO_MemSite;
+
+// Slot 0 collects allocations whose stack couldn't be read, or that came once the
+// table was full; the rest is an open-addressed hash table
+static XENO_MemSite XENO_memSites[XENO_MEMTRACK_SITES];
+static int XENO_nMemSites;
+static uint32_t XENO_sampledAllocs;
+static SDL_SpinLock XENO_memSitesLock;
+
+static uint32_t XENO_memSampling = 16;
+static XENO_THREADLOCAL uint32_t XENO_untilSample;
+
+
+// Return addresses from XENO_malloc's caller outward. Where there's no unwinder this
+// follows frame pointers, so MEMTRACK=y builds keep them.
+static int __attribute__((noinline)) XENO_captureStack(void **frames) {
+#if (defined __GLIBC__)
+  void *raw[XENO_MEMTRACK_DEPTH + XENO_MEMTRACK_SKIP];
+  const int n = backtrace(raw, XENO_MEMTRACK_DEPTH + XENO_MEMTRACK_SKIP) - XENO_MEMTRACK_SKIP;
+  if (n <= 0)
+    return 0;
+  memcpy(frames, raw + XENO_MEMTRACK_SKIP, n * sizeof(void *));
+  return n;
+#elif (defined _WIN32) && !(defined XENO_PLATFORM_NXDK)
+  return CaptureStackBackTrace(XENO_MEMTRACK_SKIP, XENO_MEMTRACK_DEPTH, frames, NULL);
+#else
+  // Each frame holds the caller's frame pointer, then the return address. This function's
+  // own frame has no return address on the list, hence one less to skip.
+  void **fp = (void **) __builtin_frame_address(0);
+  int skip = XENO_MEMTRACK_SKIP - 1, n = 0;
+  while (fp && n < XENO_MEMTRACK_DEPTH) {
+    if (skip)
+      --skip;
+    else
+      frames[n++] = fp[1];
+    void **next = (void **) fp[0];
+    // Callers' frames are further up the stack, and not far; anything else means a
+    // frame without a frame pointer, and the walk stops there
+    if (next <= fp || (char *) next - (char *) fp > 64 * 1024 || ((uintptr_t) next & (sizeof(void *) - 1)))
+      break;
+    fp = next;
+  }
+  return n;
+#endif
+}
+
+
+static uint32_t XENO_hashStack(void * const *frames, int nFrames) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < nFrames; ++i) {
+    uintptr_t frame = (uintptr_t) frames[i];
+    for (size_t byte = 0; byte < sizeof(frame); ++byte, frame >>= 8)
+      hash = (hash ^ (uint32_t) (frame & 0xFF)) * 16777619u;
+  }
+  return hash;
+}
+
+
+// Takes XENO_memSitesLock
+static int XENO_findMemSite(uint32_t hash, void * const *frames, int nFrames, XENO_MemTag tag) {
+  if (!nFrames)
+    return 0;
+  for (int probe = 0; probe < XENO_MEMTRACK_SITES - 1; ++probe) {
+    const int index = 1 + (int) ((hash + probe) % (XENO_MEMTRACK_SITES - 1));
+    XENO_MemSite *site = &XENO_memSites[index];
+    if (!site->nFrames) {
+      // Filling up no further than this keeps probes short
+      if (XENO_nMemSites >= XENO_MEMTRACK_SITES * 3 / 4)
+        return 0;
+      site->hash = hash;
+      site->nFrames = nFrames;
+      memcpy(site->frames, frames, nFrames * sizeof(void *));
+      site->tag = tag;
+      ++XENO_nMemSites;
+      return index;
+    }
+    if (site->hash == hash && site->nFrames == nFrames && !memcmp(site->frames, frames, nFrames * sizeof(void *)))
+      return index;
+  }
+  return 0;
+}
+
+
+/** Charges a sampled allocation to the call stack it came from. Returns the site to
+ *  pass to XENO_trackFree when it's freed, or -1 if it wasn't sampled. */
+int __attribute__((noinline)) XENO_trackAlloc(XENO_MemTag tag, size_t size) {
+  if (size < XENO_MEMTRACK_LARGE) {
+    if (XENO_untilSample > 1) {
+      --XENO_untilSample;
+      return -1;
+    }
+    XENO_untilSample = XENO_memSampling;
+  }
+
+  void *frames[XENO_MEMTRACK_DEPTH];
+  const int nFrames = XENO_captureStack(frames);
+  const uint32_t hash = XENO_hashStack(frames, nFrames);
+
+  SDL_AtomicLock(&XENO_memSitesLock);
+  const int index = XENO_findMemSite(hash, frames, nFrames, tag);
+  XENO_MemSite *site = &XENO_memSites[index];
+  site->liveBytes += size;
+  if (site->liveBytes > site->peakBytes)
+    site->peakBytes = site->liveBytes;
+  ++site->nAllocs;
+  ++XENO_sampledAllocs;
+  SDL_AtomicUnlock(&XENO_memSitesLock);
+  return index;
+}
+
+
+void XENO_trackFree(int site, size_t size) {
+  if (site < 0)
+    return;
+  assert(site < XENO_MEMTRACK_SITES);
+  SDL_AtomicLock(&XENO_memSitesLock);
+  XENO_memSites[site].liveBytes -= size;
+  SDL_AtomicUnlock(&XENO_memSitesLock);
+}
+
+
+/** Records the call stack of one small allocation in every 'every' on each thread, and
+ *  of every large one. 1 tracks them all, at the cost of an unwind per allocation.
+ *  Allocations that aren't sampled aren't charged to any site, so sites' bytes are a
+ *  sample too. */
+void XENO_setMemSampling(uint32_t every) {
+  XENO_memSampling = every ? every : 1;
+}
+
+
+/** Prints the sites with the most live bytes, with their peaks and call stacks. Doesn't
+ *  allocate, so it's safe to call when memory has run out. */
+void XENO_dumpMemSites(int maxSites) {
+  SDL_AtomicLock(&XENO_memSitesLock);
+  debugPrint("memtrack: %d sites, %lu allocations sampled, 1 in %lu under %d bytes\n", XENO_nMemSites,
+             (unsigned long) XENO_sampledAllocs, (unsigned long) XENO_memSampling, XENO_MEMTRACK_LARGE);
+  debugPrint("  live bytes  peak bytes    allocs  tag\n");
+
+  // Picks sites in order of live bytes, breaking ties by slot, without a sorted copy
+  size_t lastBytes = (size_t) -1;
+  int lastIndex = -1;
+  for (int n = 0; n < maxSites; ++n) {
+    int best = -1;
+    for (int i = 0; i < XENO_MEMTRACK_SITES; ++i) {
+      const XENO_MemSite *site = &XENO_memSites[i];
+      if (!site->nAllocs)
+        continue;
+      if (site->liveBytes > lastBytes || (site->liveBytes == lastBytes && i <= lastIndex))
+        continue; // Already printed
+      if (best < 0 || site->liveBytes > XENO_memSites[best].liveBytes)
+        best = i;
+    }
+    if (best < 0)
+      break;
+
+    const XENO_MemSite *site = &XENO_memSites[best];
+    debugPrint("%12lu %11lu %9lu  %s\n", (unsigned long) site->liveBytes, (unsigned long) site->peakBytes,
+               (unsigned long) site->nAllocs, best ? XENO_getMemTagName(site->tag) : "(untracked sites)");
+#if (defined __GLIBC__) && (defined DEBUG) && !(defined NDEBUG)
+    // Straight to stdout, where debugPrint goes; backtrace_symbols would allocate
+    fflush(stdout);
+    backtrace_symbols_fd(site->frames, site->nFrames, STDOUT_FILENO);
+#else
+    for (int i = 0; i < site->nFrames; ++i)
+      debugPrint("    %p\n", site->frames[i]);
+#endif
+    lastBytes = site->liveBytes;
+    lastIndex = best;
+  }
+  SDL_AtomicUnlock(&XENO_memSitesLock);
+}
@@ -0,0 +1,256 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/metrics.h>
+#include <SDL2/SDL.h>
+#include <physfs.h>
+#include <stdarg.h>
+#include <assert.h>
+
+// Every metric updated so far, in the order they first were
+static XENO_Metric *XENO_metrics;
+static XENO_Metric *XENO_lastMetric;
+static SDL_SpinLock XENO_metricsLock;
+
+// Periodic dumps, driven by XENO_pollMetricsDump
+static char XENO_metricsFile[256];
+static XENO_MetricsFormat XENO_metricsFormat;
+static Uint32 XENO_metricsInterval;
+static Uint32 XENO_nextMetricsDump;
+static Uint32 XENO_lastMetricsDump;
+
+typedef struct XENO_MetricsWriter {
+  PHYSFS_File *file;
+  int ok;
+} XENO_MetricsWriter;
+
+
+/** Adds a metric to the registry. The update functions do this themselves; call it to have
+ *  a metric show up in dumps before it's first updated. */
+void XENO_registerMetric(XENO_Metric *metric) {
+  assert(metric && metric->name);
+  SDL_AtomicLock(&XENO_metricsLock);
+  if (!metric->registered) {
+    metric->next = NULL;
+    if (XENO_lastMetric)
+      XENO_lastMetric->next = metric;
+    else
+      XENO_metrics = metric;
+    XENO_lastMetric = metric;
+    metric->registered = 1;
+  }
+  SDL_AtomicUnlock(&XENO_metricsLock);
+}
+
+
+static int XENO_histogramBucket(uint32_t value) {
+  if (value < (1u << XENO_HISTOGRAM_SUB_BITS))
+    return (int) value;
+  const int exponent = 31 - __builtin_clz(value);
+  return ((exponent - XENO_HISTOGRAM_SUB_BITS + 1) << XENO_HISTOGRAM_SUB_BITS) +
+         (int) ((value >> (exponent - XENO_HISTOGRAM_SUB_BITS)) & ((1u << XENO_HISTOGRAM_SUB_BITS) - 1));
+}
+
+
+// The smallest and largest values that land in a bucket
+static uint32_t XENO_bucketLow(int bucket) {
+  if (bucket < (1 << XENO_HISTOGRAM_SUB_BITS))
+    return (uint32_t) bucket;
+  const int shift = (bucket >> XENO_HISTOGRAM_SUB_BITS) - 1;
+  return (uint32_t) ((1 << XENO_HISTOGRAM_SUB_BITS) + (bucket & ((1 << XENO_HISTOGRAM_SUB_BITS) - 1))) << shift;
+}
+
+
+static uint32_t XENO_bucketHigh(int bucket) {
+  if (bucket < (1 << XENO_HISTOGRAM_SUB_BITS))
+    return (uint32_t) bucket;
+  return XENO_bucketLow(bucket) + ((1u << ((bucket >> XENO_HISTOGRAM_SUB_BITS) - 1)) - 1);
+}
+
+
+void XENO_recordHistogram(XENO_Histogram *histogram, uint32_t value) {
+  if (!histogram->metric.registered)
+    XENO_registerMetric(&histogram->metric);
+  __atomic_fetch_add(&histogram->buckets[XENO_histogramBucket(value)], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&histogram->sum, value, __ATOMIC_RELAXED);
+
+  uint32_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+  while (value > max && !__atomic_compare_exchange_n(&histogram->max, &max, value, 1, __ATOMIC_RELAXED,
+                                                     __ATOMIC_RELAXED));
+}
+
+
+/** Records the microseconds since an SDL_GetPerformanceCounter() reading. */
+void XENO_recordMicroseconds(XENO_Histogram *histogram, Uint64 since) {
+  static Uint64 freq;
+  if (!freq)
+    freq = SDL_GetPerformanceFrequency();
+  const Uint64 us = (SDL_GetPerformanceCounter() - since) * 1000000 / freq;
+  XENO_recordHistogram(histogram, us < 0xFFFFFFFF ? (uint32_t) us : 0xFFFFFFFF);
+}
+
+
+/** Gets an upper bound for the given percentile of recorded values, within 12.5%. */
+uint32_t XENO_histogramPercentile(const XENO_Histogram *histogram, int percentile) {
+  assert(histogram && percentile >= 0 && percentile <= 100);
+  uint64_t total = 0, seen = 0;
+  for (int i = 0; i < XENO_HISTOGRAM_BUCKETS; ++i)
+    total += __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+  if (!total)
+    return 0;
+
+  const uint64_t target = (total * percentile + 99) / 100;
+  const uint32_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+  for (int i = 0; i < XENO_HISTOGRAM_BUCKETS; ++i) {
+    seen += __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+    if (seen >= target && seen) {
+      const uint32_t high = XENO_bucketHigh(i);
+      return high < max ? high : max;
+    }
+  }
+  return max;
+}
+
+
+static void XENO_writeMetrics(XENO_MetricsWriter *writer, const char *format, ...) {
+  char line[256];
+  va_list ap;
+  va_start(ap, format);
+  const int n = SDL_vsnprintf(line, sizeof(line), format, ap);
+  va_end(ap);
+  if (writer->ok)
+    writer->ok = n >= 0 && n < (int) sizeof(line) && PHYSFS_writeBytes(writer->file, line, (PHYSFS_uint64) n) == n;
+}
+
+
+static void XENO_writeMetricText(XENO_MetricsWriter *writer, XENO_Metric *metric, Uint32 ms) {
+  if (metric->type == XENO_METRIC_COUNTER) {
+    XENO_Counter *counter = (XENO_Counter *) metric;
+    const uint64_t value = __atomic_load_n(&counter->value, __ATOMIC_RELAXED);
+    XENO_writeMetrics(writer, "%-28s counter   %llu %s, %.1f/s\n", metric->name, (unsigned long long) value,
+                      metric->unit, ms ? (double) (value - counter->dumped) * 1000.0 / ms : 0.0);
+    counter->dumped = value;
+  } else if (metric->type == XENO_METRIC_GAUGE) {
+    XENO_writeMetrics(writer, "%-28s gauge     %lld %s\n", metric->name,
+                      (long long) __atomic_load_n(&((XENO_Gauge *) metric)->value, __ATOMIC_RELAXED), metric->unit);
+  } else {
+    XENO_Histogram *histogram = (XENO_Histogram *) metric;
+    const uint64_t count = __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+    const uint64_t sum = __atomic_load_n(&histogram->sum, __ATOMIC_RELAXED);
+    XENO_writeMetrics(writer, "%-28s histogram %llu samples, mean %.1f, p50 <= %lu, p90 <= %lu, p99 <= %lu, "
+                      "max %lu %s\n", metric->name, (unsigned long long) count, count ? (double) sum / count : 0.0,
+                      (unsigned long) XENO_histogramPercentile(histogram, 50),
+                      (unsigned long) XENO_histogramPercentile(histogram, 90),
+                      (unsigned long) XENO_histogramPercentile(histogram, 99),
+                      (unsigned long) __atomic_load_n(&histogram->max, __ATOMIC_RELAXED), metric->unit);
+  }
+}
+
+
+static void XENO_writeMetricJSON(XENO_MetricsWriter *writer, XENO_Metric *metric, Uint32 ms) {
+  static const char * const types[] = {"counter", "gauge", "histogram"};
+  XENO_writeMetrics(writer, "{\"name\": \"%s\", \"type\": \"%s\", \"unit\": \"%s\", ", metric->name,
+                    types[metric->type], metric->unit);
+
+  if (metric->type == XENO_METRIC_COUNTER) {
+    XENO_Counter *counter = (XENO_Counter *) metric;
+    const uint64_t value = __atomic_load_n(&counter->value, __ATOMIC_RELAXED);
+    XENO_writeMetrics(writer, "\"value\": %llu, \"rate\": %.3f}", (unsigned long long) value,
+                      ms ? (double) (value - counter->dumped) * 1000.0 / ms : 0.0);
+    counter->dumped = value;
+  } else if (metric->type == XENO_METRIC_GAUGE) {
+    XENO_writeMetrics(writer, "\"value\": %lld}",
+                      (long long) __atomic_load_n(&((XENO_Gauge *) metric)->value, __ATOMIC_RELAXED));
+  } else {
+    XENO_Histogram *histogram = (XENO_Histogram *) metric;
+    XENO_writeMetrics(writer, "\"count\": %llu, \"sum\": %llu, \"max\": %lu, \"p50\": %lu, \"p90\": %lu, "
+                      "\"p99\": %lu, \"buckets\": [",
+                      (unsigned long long) __atomic_load_n(&histogram->count, __ATOMIC_RELAXED),
+                      (unsigned long long) __atomic_load_n(&histogram->sum, __ATOMIC_RELAXED),
+                      (unsigned long) __atomic_load_n(&histogram->max, __ATOMIC_RELAXED),
+                      (unsigned long) XENO_histogramPercentile(histogram, 50),
+                      (unsigned long) XENO_histogramPercentile(histogram, 90),
+                      (unsigned long) XENO_histogramPercentile(histogram, 99));
+    // Only the buckets in use, as [lowest value, count]
+    const char *separator = "";
+    for (int i = 0; i < XENO_HISTOGRAM_BUCKETS; ++i) {
+      const uint32_t n = __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+      if (n) {
+        XENO_writeMetrics(writer, "%s[%lu, %lu]", separator, (unsigned long) XENO_bucketLow(i), (unsigned long) n);
+        separator = ", ";
+      }
+    }
+    XENO_writeMetrics(writer, "]}");
+  }
+}
+
+
+/** Writes every registered metric to a file in the PhysFS write directory. Counter rates
+ *  are since the previous dump. Only one thread may dump at a time. Returns 0 on failure. */
+int XENO_dumpMetrics(const char *filename, XENO_MetricsFormat format) {
+  assert(filename);
+  XENO_MetricsWriter writer;
+  writer.file = PHYSFS_openWrite(filename);
+  writer.ok = 1;
+  if (!writer.file) {
+    debugPrint("dumpMetrics: Couldn't open '%s': %s\n", filename, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    return 0;
+  }
+  PHYSFS_setBuffer(writer.file, 4096);
+
+  SDL_AtomicLock(&XENO_metricsLock);
+  XENO_Metric *first = XENO_metrics;
+  XENO_Metric *last = XENO_lastMetric;
+  SDL_AtomicUnlock(&XENO_metricsLock);
+
+  const Uint32 now = SDL_GetTicks();
+  const Uint32 ms = now - XENO_lastMetricsDump;
+  XENO_lastMetricsDump = now;
+
+  if (format == XENO_METRICS_JSON)
+    XENO_writeMetrics(&writer, "{\"time_ms\": %lu, \"interval_ms\": %lu, \"metrics\": [\n", (unsigned long) now,
+                      (unsigned long) ms);
+  else
+    XENO_writeMetrics(&writer, "# %lu ms, %lu since the last dump\n", (unsigned long) now, (unsigned long) ms);
+
+  for (XENO_Metric *metric = first; metric; metric = metric == last ? NULL : metric->next) {
+    if (format == XENO_METRICS_JSON) {
+      XENO_writeMetricJSON(&writer, metric, ms);
+      XENO_writeMetrics(&writer, metric == last ? "\n" : ",\n");
+    } else {
+      XENO_writeMetricText(&writer, metric, ms);
+    }
+  }
+
+  if (format == XENO_METRICS_JSON)
+    XENO_writeMetrics(&writer, "]}\n");
+  if (!PHYSFS_close(writer.file))
+    writer.ok = 0;
+  if (!writer.ok)
+    debugPrint("dumpMetrics: Couldn't write '%s': %s\n", filename, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+  return writer.ok;
+}
+
+
+/** Has XENO_pollMetricsDump write the metrics every intervalMs, replacing the file each
+ *  time. An interval of 0 stops. */
+void XENO_setMetricsDump(const char *filename, XENO_MetricsFormat format, Uint32 intervalMs) {
+  assert(filename || !intervalMs);
+  if (filename)
+    SDL_strlcpy(XENO_metricsFile, filename, sizeof(XENO_metricsFile));
+  XENO_metricsFormat = format;
+  XENO_metricsInterval = intervalMs;
+  XENO_nextMetricsDump = SDL_GetTicks() + intervalMs;
+}
+
+
+/** Dumps the metrics if a periodic dump is due. The main loop calls this every frame. */
+void XENO_pollMetricsDump(void) {
+  if (XENO_metricsInterval && SDL_TICKS_PASSED(SDL_GetTicks(), XENO_nextMetricsDump)) {
+    XENO_nextMetricsDump = SDL_GetTicks() + XENO_metricsInterval;
+    XENO_dumpMetrics(XENO_metricsFile, XENO_metricsFormat);
+  }
+}
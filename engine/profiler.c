@@ -0,0 +1,149 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/profiler.h>
+#include <SDL2/SDL.h>
+#include <physfs.h>
+#include <stdio.h>
+
+typedef struct XENO_ZoneEvent {
+  const char *name;
+  Uint64 begin, end;
+} XENO_ZoneEvent;
+
+// Each thread only ever writes its own ring, and the exporter only ever reads them,
+// so neither side takes a lock: head is published after the event is written, and
+// tail after the exporter is done with what it read
+typedef struct XENO_ZoneRing {
+  volatile uint32_t head;    // Written by the owning thread
+  volatile uint32_t tail;    // Written by the exporter
+  volatile uint32_t dropped; // Zones lost to a full ring
+  uint32_t reportedDrops;    // What 'dropped' was at the last export
+  SDL_threadID thread;
+  struct XENO_ZoneRing *next;
+  XENO_ZoneEvent events[XENO_ZONE_RING_SIZE];
+} XENO_ZoneRing;
+
+static XENO_THREADLOCAL XENO_ZoneRing *XENO_zoneRing;
+
+// Every thread's ring, for the exporter; rings outlive their threads
+static XENO_ZoneRing *XENO_zoneRings;
+static SDL_SpinLock XENO_zoneRingsLock;
+Uint64 XENO_zoneEpoch;
+static Uint64 XENO_zoneEpochCounter; // SDL_GetPerformanceCounter() at the same time
+
+
+static XENO_ZoneRing * XENO_createZoneRing(void) {
+  XENO_ZoneRing *ring = XENO_calloc(XENO_MEM_GENERAL, 1, sizeof(XENO_ZoneRing));
+  if (!ring)
+    return NULL;
+  ring->thread = SDL_ThreadID();
+
+  SDL_AtomicLock(&XENO_zoneRingsLock);
+  ring->next = XENO_zoneRings;
+  XENO_zoneRings = ring;
+  SDL_AtomicUnlock(&XENO_zoneRingsLock);
+
+  XENO_zoneRing = ring;
+  return ring;
+}
+
+
+/** Sets the epoch, from the first zone to begin. Every zone reads the clock after
+ *  seeing the epoch set, so none starts before it. */
+void XENO_startZoneClock(void) {
+  SDL_AtomicLock(&XENO_zoneRingsLock);
+  if (!XENO_zoneEpoch) {
+    XENO_zoneEpochCounter = SDL_GetPerformanceCounter();
+    __atomic_store_n(&XENO_zoneEpoch, XENO_zoneClock(), __ATOMIC_RELEASE);
+  }
+  SDL_AtomicUnlock(&XENO_zoneRingsLock);
+}
+
+
+/** Records a zone started with XENO_beginZone in the calling thread's ring. */
+void XENO_endZone(const XENO_Zone *zone) {
+  const Uint64 end = XENO_zoneClock();
+  XENO_ZoneRing *ring = XENO_zoneRing;
+  if (!ring && !(ring = XENO_createZoneRing()))
+    return;
+
+  const uint32_t head = ring->head;
+  if (head - ring->tail >= XENO_ZONE_RING_SIZE) {
+    ++ring->dropped;
+    return;
+  }
+  XENO_ZoneEvent *event = &ring->events[head & (XENO_ZONE_RING_SIZE - 1)];
+  event->name = zone->name;
+  event->begin = zone->begin;
+  event->end = end;
+  SDL_MemoryBarrierRelease();
+  ring->head = head + 1;
+}
+
+
+static int XENO_writeTrace(PHYSFS_File *file, const char *text, int length) {
+  return PHYSFS_writeBytes(file, text, (PHYSFS_uint64) length) == length;
+}
+
+
+/** Writes the zones recorded since the last export to a file in the PhysFS write
+ *  directory, as Chrome trace events (chrome://tracing, Perfetto). Only one thread
+ *  may export at a time. Returns 0 on failure. */
+int XENO_exportTrace(const char *filename) {
+  PHYSFS_File *file = PHYSFS_openWrite(filename);
+  if (!file) {
+    debugPrint("exportTrace: Couldn't open '%s': %s\n", filename, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    return 0;
+  }
+
+  SDL_AtomicLock(&XENO_zoneRingsLock);
+  XENO_ZoneRing *rings = XENO_zoneRings;
+  SDL_AtomicUnlock(&XENO_zoneRingsLock);
+
+  // How fast the zone clock ran against the performance counter since the first zone
+  const Uint64 clocks = XENO_zoneClock() - XENO_zoneEpoch;
+  const double us = (double) (SDL_GetPerformanceCounter() - XENO_zoneEpochCounter) * 1000000.0 /
+                    SDL_GetPerformanceFrequency();
+  const double usPerCount = clocks ? us / clocks : 0;
+  char line[256];
+  int ok = XENO_writeTrace(file, "{\"traceEvents\": [\n", 18);
+  const char *separator = "";
+
+  for (XENO_ZoneRing *ring = rings; ring && ok; ring = ring->next) {
+    int n = SDL_snprintf(line, sizeof(line), "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %lu, "
+                         "\"args\": {\"name\": \"thread %lu\"}}", separator, (unsigned long) ring->thread,
+                         (unsigned long) ring->thread);
+    ok = XENO_writeTrace(file, line, n);
+    separator = ",\n";
+
+    const uint32_t head = ring->head;
+    SDL_MemoryBarrierAcquire();
+    for (uint32_t i = ring->tail; i != head && ok; ++i) {
+      const XENO_ZoneEvent *event = &ring->events[i & (XENO_ZONE_RING_SIZE - 1)];
+      n = SDL_snprintf(line, sizeof(line), ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %lu, "
+                       "\"ts\": %.3f, \"dur\": %.3f}", event->name, (unsigned long) ring->thread,
+                       ((double) event->begin - (double) XENO_zoneEpoch) * usPerCount,
+                       (double) (event->end - event->begin) * usPerCount);
+      ok = n > 0 && n < (int) sizeof(line) && XENO_writeTrace(file, line, n);
+    }
+    SDL_MemoryBarrierRelease();
+    ring->tail = head;
+
+    const uint32_t dropped = ring->dropped;
+    if (dropped != ring->reportedDrops)
+      debugPrint("exportTrace: thread %lu dropped %lu zones; export more often\n", (unsigned long) ring->thread,
+                 (unsigned long) (dropped - ring->reportedDrops));
+    ring->reportedDrops = dropped;
+  }
+
+  ok = ok && XENO_writeTrace(file, "\n]}\n", 4);
+  if (!PHYSFS_close(file))
+    ok = 0;
+  if (!ok)
+    debugPrint("exportTrace: Couldn't write '%s': %s\n", filename, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+  return ok;
+}
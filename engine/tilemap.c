@@ -0,0 +1,258 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/tilemap.h>
+#include <xeno/imageutils.h>
+#include <xeno/profiler.h>
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+XENO_TileMap * XENO_createTileMap(XENO_Projection projection, int width, int height, int canvasW, int canvasH) {
+  assert(width > 0 && height > 0 && canvasW > 0 && canvasH > 0);
+  XENO_TileMap *map = XENO_calloc(XENO_MEM_RENDER, 1, sizeof(XENO_TileMap));
+  if (!map)
+    return NULL;
+
+  map->projection = projection;
+  map->width = width;
+  map->height = height;
+  map->canvasW = canvasW;
+  map->canvasH = canvasH;
+  if (projection == XENO_PROJECTION_ISO) {
+    // Diamonds are twice as wide as they are tall, and neighbours overlap by half
+    map->stepX = canvasW / 2;
+    map->stepY = canvasW / 4;
+  } else {
+    map->stepX = canvasW;
+    map->stepY = canvasW / 2;
+  }
+
+  map->chunksX = (width + XENO_CHUNK_SIZE - 1) / XENO_CHUNK_SIZE;
+  map->chunksY = (height + XENO_CHUNK_SIZE - 1) / XENO_CHUNK_SIZE;
+  map->chunkRevision = XENO_malloc(XENO_MEM_RENDER, sizeof(uint32_t) * map->chunksX * map->chunksY);
+  map->chunkTimelines = XENO_calloc(XENO_MEM_RENDER, map->chunksX * map->chunksY, sizeof(uint64_t));
+  map->animatedChunks = XENO_malloc(XENO_MEM_RENDER, sizeof(int) * map->chunksX * map->chunksY);
+  for (int l = 0; l < XENO_LAYER_COUNT; ++l)
+    map->cells[l] = XENO_calloc(XENO_MEM_RENDER, (size_t) width * height, sizeof(XENO_TileId));
+
+  map->capTiles = 16;
+  map->nTiles = 1; // Entry 0 stands for an empty cell
+  map->tiles = XENO_calloc(XENO_MEM_RENDER, map->capTiles, sizeof(XENO_Tile));
+
+  int ok = map->chunkRevision && map->chunkTimelines && map->animatedChunks && map->tiles;
+  for (int l = 0; l < XENO_LAYER_COUNT; ++l)
+    ok = ok && map->cells[l];
+  if (!ok) {
+    debugPrint("createTileMap: Could not malloc memory\n");
+    XENO_destroyTileMap(map);
+    return NULL;
+  }
+
+  // Start at 1 so that a freshly assigned cache slot (revision 0) is always stale
+  for (int c = 0; c < map->chunksX * map->chunksY; ++c)
+    map->chunkRevision[c] = 1;
+
+  return map;
+}
+
+
+void XENO_destroyTileMap(XENO_TileMap *map) {
+  if (map) {
+    for (int l = 0; l < XENO_LAYER_COUNT; ++l)
+      XENO_free(map->cells[l]);
+    XENO_free(map->chunkRevision);
+    XENO_free(map->chunkTimelines);
+    XENO_free(map->animatedChunks);
+    XENO_free(map->tiles);
+    XENO_free(map);
+  }
+}
+
+
+XENO_TileId XENO_addTile(XENO_TileMap *map, const XENO_Tile *tile) {
+  assert(map && tile);
+  if (map->nTiles >= 0xFFFF)
+    return 0;
+
+  if (map->nTiles == map->capTiles) {
+    XENO_Tile *tiles = XENO_realloc(XENO_MEM_RENDER, map->tiles, sizeof(XENO_Tile) * map->capTiles * 2);
+    if (!tiles) {
+      debugPrint("addTile: Could not realloc memory\n");
+      return 0;
+    }
+    map->tiles = tiles;
+    map->capTiles *= 2;
+  }
+
+  map->tiles[map->nTiles] = *tile;
+  return (XENO_TileId) map->nTiles++;
+}
+
+
+void XENO_setCell(XENO_TileMap *map, int layer, int x, int y, XENO_TileId id) {
+  assert(map && layer >= 0 && layer < XENO_LAYER_COUNT);
+  if (x < 0 || y < 0 || x >= map->width || y >= map->height)
+    return;
+
+  XENO_TileId *cell = &map->cells[layer][y * map->width + x];
+  if (*cell != id) {
+    *cell = id;
+    if (map->nChangedCells < XENO_MAX_CHANGED_CELLS) {
+      map->changedCells[map->nChangedCells].x = x;
+      map->changedCells[map->nChangedCells].y = y;
+    }
+    if (map->nChangedCells <= XENO_MAX_CHANGED_CELLS)
+      ++map->nChangedCells;
+
+    if (layer < XENO_STATIC_LAYERS) {
+      int chunk = (y / XENO_CHUNK_SIZE) * map->chunksX + x / XENO_CHUNK_SIZE;
+      ++map->chunkRevision[chunk];
+
+      // Remember which timelines can dirty this chunk. Bits are never cleared,
+      // so removing an animated cell at worst costs a few spare re-renders.
+      uint16_t timeline = id < map->nTiles ? map->tiles[id].timeline : 0;
+      if (timeline) {
+        if (!map->chunkTimelines[chunk])
+          map->animatedChunks[map->nAnimatedChunks++] = chunk;
+        map->chunkTimelines[chunk] |= (uint64_t) 1 << ((timeline - 1) % 64);
+      }
+    }
+  }
+}
+
+
+XENO_TileId XENO_getCell(const XENO_TileMap *map, int layer, int x, int y) {
+  assert(map && layer >= 0 && layer < XENO_LAYER_COUNT);
+  if (x < 0 || y < 0 || x >= map->width || y >= map->height)
+    return 0;
+
+  return map->cells[layer][y * map->width + x];
+}
+
+
+/** Marks a chunk's cached static layers as stale. */
+void XENO_touchChunk(XENO_TileMap *map, int cx, int cy) {
+  assert(map);
+  if (cx >= 0 && cy >= 0 && cx < map->chunksX && cy < map->chunksY)
+    ++map->chunkRevision[cy * map->chunksX + cx];
+}
+
+
+/** Gets the world-space position of a cell's canvas. */
+void XENO_cellToWorld(const XENO_TileMap *map, int x, int y, SDL_Point *out) {
+  assert(map && out);
+  if (map->projection == XENO_PROJECTION_ISO) {
+    out->x = (x - y) * map->stepX;
+    out->y = (x + y) * map->stepY;
+  } else {
+    out->x = x * map->stepX;
+    out->y = y * map->stepY;
+  }
+}
+
+
+/** Gets the world-space rectangle covering every canvas in a chunk. */
+void XENO_getChunkBounds(const XENO_TileMap *map, int cx, int cy, SDL_Rect *out) {
+  assert(map && out);
+  const int last = XENO_CHUNK_SIZE - 1;
+  SDL_Point first;
+  XENO_cellToWorld(map, cx * XENO_CHUNK_SIZE, cy * XENO_CHUNK_SIZE, &first);
+
+  // Every chunk gets the same size, so edge chunks can share cache textures
+  if (map->projection == XENO_PROJECTION_ISO) {
+    out->x = first.x - last * map->stepX;
+    out->y = first.y;
+    out->w = 2 * last * map->stepX + map->canvasW;
+    out->h = 2 * last * map->stepY + map->canvasH;
+  } else {
+    out->x = first.x;
+    out->y = first.y;
+    out->w = last * map->stepX + map->canvasW;
+    out->h = last * map->stepY + map->canvasH;
+  }
+}
+
+
+/** Gets a conservative range of chunks (in chunk coordinates) that may intersect a world-space view. */
+void XENO_getChunkRange(const XENO_TileMap *map, const SDL_Rect *view, SDL_Rect *out) {
+  assert(map && view && out);
+  // Canvases hang down and to the right of their cell, so grow the view up and left
+  const float left = (float) (view->x - map->canvasW);
+  const float top = (float) (view->y - map->canvasH);
+  const float right = (float) (view->x + view->w);
+  const float bottom = (float) (view->y + view->h);
+  const float cornersX[4] = {left, right, left, right};
+  const float cornersY[4] = {top, top, bottom, bottom};
+  float minX = 0, minY = 0, maxX = 0, maxY = 0;
+
+  for (int i = 0; i < 4; ++i) {
+    float u = cornersX[i] / map->stepX, v = cornersY[i] / map->stepY;
+    float x, y;
+    if (map->projection == XENO_PROJECTION_ISO) {
+      x = (u + v) * 0.5f;
+      y = (v - u) * 0.5f;
+    } else {
+      x = u;
+      y = v;
+    }
+    if (i == 0 || x < minX) minX = x;
+    if (i == 0 || x > maxX) maxX = x;
+    if (i == 0 || y < minY) minY = y;
+    if (i == 0 || y > maxY) maxY = y;
+  }
+
+  int x0 = (int) floorf(minX) / XENO_CHUNK_SIZE, y0 = (int) floorf(minY) / XENO_CHUNK_SIZE;
+  int x1 = (int) ceilf(maxX) / XENO_CHUNK_SIZE, y1 = (int) ceilf(maxY) / XENO_CHUNK_SIZE;
+  x0 = SDL_max(x0, 0);
+  y0 = SDL_max(y0, 0);
+  x1 = SDL_min(x1, map->chunksX - 1);
+  y1 = SDL_min(y1, map->chunksY - 1);
+
+  out->x = x0;
+  out->y = y0;
+  out->w = SDL_max(x1 - x0 + 1, 0);
+  out->h = SDL_max(y1 - y0 + 1, 0);
+}
+
+
+int XENO_drawTile(SDL_Renderer *renderer, const XENO_Tile *tile, int x, int y) {
+  SDL_Rect dest;
+  dest.x = x + tile->offset.x;
+  dest.y = y + tile->offset.y;
+  dest.w = tile->frame.w;
+  dest.h = tile->frame.h;
+  ++XENO_renderStats.drawCalls;
+  return SDL_RenderCopy(renderer, tile->texture, &tile->frame, &dest);
+}
+
+
+/** Draws a rectangle of cells in back-to-front order, with world (0,0) placed at the origin. */
+void XENO_drawCells(SDL_Renderer *renderer, const XENO_TileMap *map, int firstLayer, int lastLayer,
+                    const SDL_Rect *cells, int originX, int originY) {
+  XENO_ZONE("drawCells");
+  assert(renderer && map && cells);
+  const int x0 = SDL_max(cells->x, 0), y0 = SDL_max(cells->y, 0);
+  const int x1 = SDL_min(cells->x + cells->w, map->width);
+  const int y1 = SDL_min(cells->y + cells->h, map->height);
+  SDL_Point pos;
+
+  // Row-major order is back-to-front for both projections
+  for (int l = firstLayer; l <= lastLayer; ++l) {
+    const XENO_TileId *layer = map->cells[l];
+    for (int y = y0; y < y1; ++y) {
+      for (int x = x0; x < x1; ++x) {
+        XENO_TileId id = layer[y * map->width + x];
+        if (id && id < map->nTiles) {
+          XENO_cellToWorld(map, x, y, &pos);
+          XENO_drawTile(renderer, &map->tiles[id], originX + pos.x, originY + pos.y);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,160 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/imageutils.h>
+#include <xeno/profiler.h>
+#include <xeno/tileset.h>
+#include <xeno/xmlutils.h>
+#include <SDL2/SDL.h>
+#include <tinyxml2.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+using namespace tinyxml2;
+
+static void XENO_copyName(char *dest, const char *src, size_t len) {
+  if (len >= XENO_TILESET_NAME_MAX)
+    len = XENO_TILESET_NAME_MAX - 1;
+  memcpy(dest, src, len);
+  dest[len] = '\0';
+}
+
+
+/** Loads a tileset descriptor (e.g. "tilesets/iso/prototype/floor.xml") and the
+ *  BMP atlas next to it. The descriptor's image name is ignored, since the atlases
+ *  ship as BMPs converted from the original PNGs. */
+XENO_Tileset * XENO_loadTileset(SDL_Renderer *renderer, const char *xmlPath) {
+  XENO_ZONE("loadTileset");
+  assert(renderer && xmlPath);
+  XENO_MemTagScope memTag(XENO_MEM_XML);
+  XENO_PhysFSInputStream input(xmlPath);
+  if (!input.isOpen())
+    return NULL;
+
+  XENO_Tileset *tileset = (XENO_Tileset *) XENO_calloc(XENO_MEM_XML, 1, sizeof(XENO_Tileset));
+  if (!tileset)
+    return NULL;
+
+  // Streamed rather than parsed into a DOM, since every value is copied out once.
+  // The descriptors don't quote their numbers: <frame x=0 y=37 w=50 h=36 />
+  XMLStreamReader reader(&input);
+  reader.SetUnquotedAttributes(true);
+  XENO_TilesetFrame *frame = NULL;
+  int capFrames = 0;
+  XMLStreamReader::Event event;
+
+  while ((event = reader.Next()) != XMLStreamReader::END_DOCUMENT && event != XMLStreamReader::FAILED) {
+    if (event != XMLStreamReader::START_ELEMENT)
+      continue;
+
+    // tileset/tiles/tile, and the tile's frame/spriteSourceSize children
+    const char *name = reader.Name();
+    if (reader.Depth() == 3 && !strcmp(name, "tile")) {
+      if (tileset->nFrames == capFrames) {
+        capFrames = capFrames ? capFrames * 2 : 16;
+        XENO_TilesetFrame *frames = (XENO_TilesetFrame *) XENO_realloc(XENO_MEM_XML, tileset->frames, sizeof(XENO_TilesetFrame) * capFrames);
+        if (!frames) {
+          debugPrint("loadTileset: Could not realloc memory\n");
+          XENO_destroyTileset(tileset);
+          return NULL;
+        }
+        tileset->frames = frames;
+      }
+
+      frame = &tileset->frames[tileset->nFrames++];
+      memset(frame, 0, sizeof(XENO_TilesetFrame));
+      const char *id = reader.Attribute("id");
+      if (id)
+        XENO_copyName(frame->id, id, strlen(id));
+    } else if (frame && reader.Depth() == 4 && !strcmp(name, "frame")) {
+      frame->frame.x = reader.IntAttribute("x");
+      frame->frame.y = reader.IntAttribute("y");
+      frame->frame.w = reader.IntAttribute("w");
+      frame->frame.h = reader.IntAttribute("h");
+    } else if (frame && reader.Depth() == 4 && !strcmp(name, "spriteSourceSize")) {
+      frame->offset.x = reader.IntAttribute("x");
+      frame->offset.y = reader.IntAttribute("y");
+      tileset->canvasW = SDL_max(tileset->canvasW, reader.IntAttribute("w"));
+      tileset->canvasH = SDL_max(tileset->canvasH, reader.IntAttribute("h"));
+    }
+  }
+
+  if (event == XMLStreamReader::FAILED) {
+    debugPrint("loadTileset: '%s' failed to parse: %s on line %d\n", xmlPath, reader.ErrorName(), reader.ErrorLineNum());
+    XENO_destroyTileset(tileset);
+    return NULL;
+  }
+  if (!tileset->nFrames) {
+    debugPrint("loadTileset: '%s' has no tiles\n", xmlPath);
+    XENO_destroyTileset(tileset);
+    return NULL;
+  }
+
+  // Swap the descriptor's extension for the atlas's, and keep the base name
+  const char *slash = strrchr(xmlPath, '/');
+  const char *base = slash ? slash + 1 : xmlPath;
+  const char *dot = strrchr(base, '.');
+  size_t stem = dot ? (size_t) (dot - xmlPath) : strlen(xmlPath);
+  XENO_copyName(tileset->name, base, stem - (size_t) (base - xmlPath));
+
+  char *bmpPath = (char *) XENO_malloc(XENO_MEM_XML, stem + 5);
+  if (bmpPath) {
+    memcpy(bmpPath, xmlPath, stem);
+    strcpy(bmpPath + stem, ".bmp");
+    tileset->texture = XENO_LoadBMPTexture(renderer, bmpPath);
+    XENO_free(bmpPath);
+  }
+
+  if (!tileset->texture) {
+    XENO_destroyTileset(tileset);
+    return NULL;
+  }
+
+  return tileset;
+}
+
+
+void XENO_destroyTileset(XENO_Tileset *tileset) {
+  if (tileset) {
+    if (tileset->texture)
+      SDL_DestroyTexture(tileset->texture);
+    XENO_free(tileset->frames);
+    XENO_free(tileset);
+  }
+}
+
+
+/** Finds a frame by its id (e.g. "switchFloorOn_3.png"). Returns its index, or -1. */
+int XENO_findTilesetFrame(const XENO_Tileset *tileset, const char *id) {
+  assert(tileset && id);
+  for (int i = 0; i < tileset->nFrames; ++i) {
+    if (!strcmp(tileset->frames[i].id, id))
+      return i;
+  }
+  return -1;
+}
+
+
+/** Adds every frame of a tileset to a map's tile table, in order.
+ *  Returns the id of the first frame (the rest follow consecutively), or 0 on failure. */
+XENO_TileId XENO_addTilesetToMap(XENO_TileMap *map, const XENO_Tileset *tileset) {
+  assert(map && tileset);
+  XENO_TileId first = 0;
+  for (int i = 0; i < tileset->nFrames; ++i) {
+    XENO_Tile tile;
+    tile.texture = tileset->texture;
+    tile.frame = tileset->frames[i].frame;
+    tile.offset = tileset->frames[i].offset;
+    tile.timeline = 0;
+    XENO_TileId id = XENO_addTile(map, &tile);
+    if (!id)
+      return 0;
+    if (!first)
+      first = id;
+  }
+  return first;
+}
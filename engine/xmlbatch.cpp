@@ -0,0 +1,220 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/xmlbatch.h>
+#include <xeno/profiler.h>
+#include <SDL2/SDL.h>
+#include <physfs.h>
+#include <stdlib.h>
+#include <assert.h>
+
+using namespace tinyxml2;
+
+// Reads a whole file into the worker's buffer, growing it as needed. Returns the length, or -1.
+static PHYSFS_sint64 XENO_readIntoWorker(XENO_XMLWorker *worker, const char *path) {
+  XENO_ZONE("readXML");
+  PHYSFS_File *file = PHYSFS_openRead(path);
+  if (!file) {
+    debugPrint("parseXMLBatch: Couldn't open '%s': %s\n", path, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    return -1;
+  }
+
+  PHYSFS_sint64 length = PHYSFS_fileLength(file);
+  if (length >= 0 && (size_t) length + 1 > worker->capBuffer) {
+    char *buffer = (char *) XENO_realloc(XENO_MEM_XML, worker->buffer, (size_t) length + 1);
+    if (buffer) {
+      worker->buffer = buffer;
+      worker->capBuffer = (size_t) length + 1;
+    } else {
+      debugPrint("parseXMLBatch: Could not realloc memory\n");
+      length = -1;
+    }
+  }
+  if (length >= 0 && PHYSFS_readBytes(file, worker->buffer, (PHYSFS_uint64) length) != length) {
+    debugPrint("parseXMLBatch: Couldn't read '%s': %s\n", path, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    length = -1;
+  }
+  PHYSFS_close(file);
+  return length;
+}
+
+
+// Claims paths until the job runs out, parsing each into the worker's document
+static void XENO_runXMLJob(XENO_XMLWorker *worker) {
+  XENO_XMLBatch *batch = worker->batch;
+  int index;
+  while ((index = SDL_AtomicAdd(&batch->next, 1)) < batch->nPaths) {
+    const char *path = batch->paths[index];
+    PHYSFS_sint64 length = XENO_readIntoWorker(worker, path);
+    const XMLDocument *doc = NULL;
+    if (length >= 0) {
+      XENO_ZONE("parseXML");
+      // Borrowed buffer: the document parses it in place and leaves freeing it to us
+      worker->doc->ParseInSitu(worker->buffer, (size_t) length);
+      doc = worker->doc;
+      if (!doc->Error())
+        SDL_AtomicAdd(&batch->nParsed, 1);
+      else
+        debugPrint("parseXMLBatch: '%s' failed to parse: %s\n", path, doc->ErrorStr());
+    }
+
+    if (batch->order == XENO_XML_IN_ORDER) {
+      // Paths are claimed in order, so whoever holds the turn is never waiting itself
+      SDL_LockMutex(batch->lock);
+      while (batch->turn != index)
+        SDL_CondWait(batch->wake, batch->lock);
+      SDL_UnlockMutex(batch->lock);
+
+      batch->callback(index, path, doc, batch->userdata);
+
+      SDL_LockMutex(batch->lock);
+      ++batch->turn;
+      SDL_CondBroadcast(batch->wake);
+      SDL_UnlockMutex(batch->lock);
+    } else {
+      batch->callback(index, path, doc, batch->userdata);
+    }
+  }
+}
+
+
+static int XENO_xmlWorkerMain(void *data) {
+  XENO_XMLWorker *worker = (XENO_XMLWorker *) data;
+  XENO_XMLBatch *batch = worker->batch;
+  int generation = 0;
+  XENO_setMemTag(XENO_MEM_XML);
+
+  for (;;) {
+    SDL_LockMutex(batch->lock);
+    while (!batch->quit && batch->generation == generation)
+      SDL_CondWait(batch->wake, batch->lock);
+    if (batch->quit) {
+      SDL_UnlockMutex(batch->lock);
+      return 0;
+    }
+    generation = batch->generation;
+    SDL_UnlockMutex(batch->lock);
+
+    XENO_runXMLJob(worker);
+
+    SDL_LockMutex(batch->lock);
+    ++batch->nFinished;
+    SDL_CondSignal(batch->done);
+    SDL_UnlockMutex(batch->lock);
+  }
+}
+
+
+/** Creates a batch parser with nWorkers documents, one of which is used by the calling thread;
+ *  the rest get their own threads. nWorkers <= 0 uses one per CPU core.
+ *  flags are XENO_XML_* batch flags. */
+XENO_XMLBatch * XENO_createXMLBatch(int nWorkers, int flags) {
+  if (nWorkers <= 0)
+    nWorkers = SDL_max(SDL_GetCPUCount(), 1);
+  XENO_MemTagScope memTag(XENO_MEM_XML);
+
+  XENO_XMLBatch *batch = (XENO_XMLBatch *) XENO_calloc(XENO_MEM_XML, 1, sizeof(XENO_XMLBatch));
+  if (!batch)
+    return NULL;
+  batch->workers = (XENO_XMLWorker *) XENO_calloc(XENO_MEM_XML, nWorkers, sizeof(XENO_XMLWorker));
+  batch->lock = SDL_CreateMutex();
+  batch->wake = SDL_CreateCond();
+  batch->done = SDL_CreateCond();
+  if (!batch->workers || !batch->lock || !batch->wake || !batch->done) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "createXMLBatch: Couldn't create batch: %s\n", SDL_GetError());
+    XENO_destroyXMLBatch(batch);
+    return NULL;
+  }
+
+  const Whitespace whitespace = (flags & XENO_XML_COLLAPSE_WHITESPACE) ? COLLAPSE_WHITESPACE : PRESERVE_WHITESPACE;
+  for (int i = 0; i < nWorkers; ++i) {
+    XENO_XMLWorker *worker = &batch->workers[i];
+    worker->batch = batch;
+    worker->arena = new XMLArena();
+    worker->doc = new XMLDocument(true, whitespace);
+    if (!worker->arena || !worker->doc) {
+      debugPrint("createXMLBatch: Could not allocate memory\n");
+      XENO_destroyXMLBatch(batch);
+      return NULL;
+    }
+    worker->doc->SetArena(worker->arena);
+    worker->doc->SetUnquotedAttributes((flags & XENO_XML_UNQUOTED_ATTRIBUTES) != 0);
+    ++batch->nWorkers;
+
+    // Worker 0 is whoever calls XENO_parseXMLBatch
+    if (i > 0) {
+      worker->thread = SDL_CreateThread(XENO_xmlWorkerMain, "xmlworker", worker);
+      if (!worker->thread) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "createXMLBatch: Couldn't create thread: %s\n", SDL_GetError());
+        XENO_destroyXMLBatch(batch);
+        return NULL;
+      }
+    }
+  }
+  return batch;
+}
+
+
+void XENO_destroyXMLBatch(XENO_XMLBatch *batch) {
+  if (batch) {
+    if (batch->lock) {
+      SDL_LockMutex(batch->lock);
+      batch->quit = SDL_TRUE;
+      SDL_CondBroadcast(batch->wake);
+      SDL_UnlockMutex(batch->lock);
+    }
+    for (int i = 0; i < batch->nWorkers; ++i) {
+      XENO_XMLWorker *worker = &batch->workers[i];
+      if (worker->thread)
+        SDL_WaitThread(worker->thread, NULL);
+      delete worker->doc;
+      delete worker->arena;
+      XENO_free(worker->buffer);
+    }
+    if (batch->done)
+      SDL_DestroyCond(batch->done);
+    if (batch->wake)
+      SDL_DestroyCond(batch->wake);
+    if (batch->lock)
+      SDL_DestroyMutex(batch->lock);
+    XENO_free(batch->workers);
+    XENO_free(batch);
+  }
+}
+
+
+/** Reads and parses every path across the batch's workers, handing each document to callback
+ *  in the given order. With XENO_XML_AS_COMPLETED the callback runs on several threads at
+ *  once. Returns once every document has been handed back, with the number that parsed. */
+int XENO_parseXMLBatch(XENO_XMLBatch *batch, const char * const *paths, int nPaths, XENO_XMLBatchOrder order,
+                       XENO_XMLBatchCallback callback, void *userdata) {
+  assert(batch && (paths || !nPaths) && callback);
+  XENO_MemTagScope memTag(XENO_MEM_XML);
+  batch->paths = paths;
+  batch->nPaths = nPaths;
+  batch->order = order;
+  batch->callback = callback;
+  batch->userdata = userdata;
+  batch->turn = 0;
+  SDL_AtomicSet(&batch->next, 0);
+  SDL_AtomicSet(&batch->nParsed, 0);
+
+  // The job is published under the lock, so workers see all of it once they see the new generation
+  SDL_LockMutex(batch->lock);
+  batch->nFinished = 0;
+  ++batch->generation;
+  SDL_CondBroadcast(batch->wake);
+  SDL_UnlockMutex(batch->lock);
+
+  XENO_runXMLJob(&batch->workers[0]);
+
+  SDL_LockMutex(batch->lock);
+  while (batch->nFinished < batch->nWorkers - 1)
+    SDL_CondWait(batch->done, batch->lock);
+  SDL_UnlockMutex(batch->lock);
+
+  return SDL_AtomicGet(&batch->nParsed);
+}
@@ -0,0 +1,219 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/fsutils.h>
+#include <xeno/xmlpatch.h>
+#include <xeno/profiler.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+using namespace tinyxml2;
+
+static bool XENO_addXMLChange(XENO_XMLChangeSet *changes, XENO_XMLChangeType type, int what,
+                              XMLElement *element, XMLNode *parent) {
+  if (changes->nChanges == changes->capChanges) {
+    int capChanges = changes->capChanges ? changes->capChanges * 2 : 16;
+    XENO_XMLChange *grown = (XENO_XMLChange *) XENO_realloc(XENO_MEM_XML, changes->changes, sizeof(XENO_XMLChange) * capChanges);
+    if (!grown) {
+      debugPrint("patchXML: Could not realloc memory\n");
+      return false;
+    }
+    changes->changes = grown;
+    changes->capChanges = capChanges;
+  }
+
+  XENO_XMLChange *change = &changes->changes[changes->nChanges++];
+  change->type = type;
+  change->what = what;
+  change->element = element;
+  change->parent = parent;
+  return true;
+}
+
+
+// The flag a parent gets when a child of this kind comes, goes or moves
+static int XENO_contentFlag(const XMLNode *node) {
+  if (node->ToElement())
+    return XENO_XML_CHILDREN_CHANGED;
+  if (node->ToText())
+    return XENO_XML_TEXT_CHANGED;
+  return 0; // Comments and the like don't count as content
+}
+
+
+// Whether two siblings are the same node in two versions of a document. Elements match by
+// name and "id" (tileset tiles and entity defs are keyed by it), then by their order among
+// siblings; other nodes only by kind and order.
+static bool XENO_sameXMLNode(const XMLNode *live, const XMLNode *next) {
+  const XMLElement *liveElement = live->ToElement();
+  const XMLElement *nextElement = next->ToElement();
+  if (liveElement || nextElement) {
+    if (!liveElement || !nextElement || strcmp(liveElement->Name(), nextElement->Name()))
+      return false;
+    const char *liveId = liveElement->Attribute("id");
+    const char *nextId = nextElement->Attribute("id");
+    return liveId == nextId || (liveId && nextId && !strcmp(liveId, nextId));
+  }
+  return (live->ToText() && next->ToText()) || (live->ToComment() && next->ToComment()) ||
+         (live->ToDeclaration() && next->ToDeclaration()) || (live->ToUnknown() && next->ToUnknown());
+}
+
+
+static int XENO_patchAttributes(XMLElement *live, const XMLElement *next) {
+  int what = 0;
+  for (const XMLAttribute *a = next->FirstAttribute(); a; a = a->Next()) {
+    const XMLAttribute *old = live->FindAttribute(a->Name());
+    if (!old || strcmp(old->Value(), a->Value())) {
+      live->SetAttribute(a->Name(), a->Value());
+      what = XENO_XML_ATTRIBUTES_CHANGED;
+    }
+  }
+  for (const XMLAttribute *a = live->FirstAttribute(); a; ) {
+    const XMLAttribute *following = a->Next();
+    if (!next->FindAttribute(a->Name())) {
+      live->DeleteAttribute(a->Name());
+      what = XENO_XML_ATTRIBUTES_CHANGED;
+    }
+    a = following;
+  }
+  return what;
+}
+
+
+static bool XENO_patchXMLChildren(XENO_XMLChangeSet *changes, XMLNode *live, const XMLNode *next, int *what);
+
+// Brings a matched pair up to date. 'what' collects the flags for the live node's parent.
+static bool XENO_patchXMLNode(XENO_XMLChangeSet *changes, XMLNode *live, const XMLNode *next, int *what) {
+  XMLElement *element = live->ToElement();
+  if (element) {
+    int own = XENO_patchAttributes(element, next->ToElement());
+    if (!XENO_patchXMLChildren(changes, element, next, &own))
+      return false;
+    return !own || XENO_addXMLChange(changes, XENO_XML_ELEMENT_CHANGED, own, element, element->Parent());
+  }
+
+  XMLText *text = live->ToText();
+  const XMLText *nextText = next->ToText();
+  if (text ? text->CData() != nextText->CData() || strcmp(text->Value(), nextText->Value())
+           : strcmp(live->Value(), next->Value()) != 0) {
+    live->SetValue(next->Value());
+    if (text)
+      text->SetCData(nextText->CData());
+    *what |= XENO_contentFlag(live);
+  }
+  return true;
+}
+
+
+// Makes the live node's children match next's. Matched children keep their identity and are
+// moved into the new order; the rest are cloned in or taken out.
+static bool XENO_patchXMLChildren(XENO_XMLChangeSet *changes, XMLNode *live, const XMLNode *next, int *what) {
+  XMLNode *placed = NULL; // Everything up to here is in its final place
+
+  for (const XMLNode *n = next->FirstChild(); n; n = n->NextSibling()) {
+    XMLNode *unplaced = placed ? placed->NextSibling() : live->FirstChild();
+    XMLNode *match = unplaced;
+    while (match && !XENO_sameXMLNode(match, n))
+      match = match->NextSibling();
+
+    if (match) {
+      if (match != unplaced) {
+        if (placed)
+          live->InsertAfterChild(placed, match);
+        else
+          live->InsertFirstChild(match);
+        *what |= XENO_contentFlag(match);
+      }
+      if (!XENO_patchXMLNode(changes, match, n, what))
+        return false;
+    } else {
+      match = n->DeepClone(changes->doc);
+      if (!match) {
+        debugPrint("patchXML: Could not clone node\n");
+        return false;
+      }
+      if (placed)
+        live->InsertAfterChild(placed, match);
+      else
+        live->InsertFirstChild(match);
+      *what |= XENO_contentFlag(match);
+      if (match->ToElement() && !XENO_addXMLChange(changes, XENO_XML_ELEMENT_ADDED, 0, match->ToElement(), live))
+        return false;
+    }
+    placed = match;
+  }
+
+  // Whatever is left over isn't in the new version
+  XMLNode *rest = placed ? placed->NextSibling() : live->FirstChild();
+  while (rest) {
+    XMLNode *following = rest->NextSibling();
+    XMLElement *element = rest->ToElement();
+    *what |= XENO_contentFlag(rest);
+    if (element) {
+      if (!changes->removed)
+        changes->removed = changes->doc->NewElement("removed");
+      if (!changes->removed || !XENO_addXMLChange(changes, XENO_XML_ELEMENT_REMOVED, 0, element, live))
+        return false;
+      changes->removed->InsertEndChild(element);
+    } else {
+      live->DeleteChild(rest);
+    }
+    rest = following;
+  }
+  return true;
+}
+
+
+/** Updates a live document in place to match 'next', a freshly parsed version of it. Unchanged
+ *  elements keep their identity, so pointers into the live tree stay valid unless their element
+ *  was removed. What changed is appended to 'changes'. Returns false on failure, which can leave
+ *  the live document partly patched. */
+bool XENO_patchXML(XMLDocument *live, const XMLDocument *next, XENO_XMLChangeSet *changes) {
+  assert(live && next && changes);
+  assert(!changes->doc || changes->doc == live); // A set holds one document's removed elements
+  if (next->Error()) {
+    debugPrint("patchXML: New version failed to parse: %s\n", next->ErrorStr());
+    return false;
+  }
+
+  XENO_MemTagScope memTag(XENO_MEM_XML);
+  changes->doc = live;
+  int what = 0;
+  return XENO_patchXMLChildren(changes, live, next, &what);
+}
+
+
+/** Re-reads a document (e.g. from the override directory) and patches the live one to match. */
+bool XENO_reloadXML(XMLDocument *live, const char *filename, XENO_XMLChangeSet *changes) {
+  XENO_ZONE("reloadXML");
+  assert(live && filename && changes);
+  XENO_MemTagScope memTag(XENO_MEM_XML);
+  char *buffer = NULL;
+  uint32_t length = XENO_readFile(filename, &buffer);
+  if (!buffer)
+    return false;
+
+  // Parsed the way the live document was
+  XMLDocument next(live->ProcessEntities(), live->WhitespaceMode());
+  next.SetUnquotedAttributes(live->UnquotedAttributes());
+  next.ParseInSitu(buffer, length);
+  if (next.Error())
+    debugPrint("reloadXML: '%s' failed to parse: %s\n", filename, next.ErrorStr());
+  bool ok = !next.Error() && XENO_patchXML(live, &next, changes);
+  XENO_free(buffer);
+  return ok;
+}
+
+
+/** Deletes the removed elements and empties the set. */
+void XENO_clearXMLChanges(XENO_XMLChangeSet *changes) {
+  assert(changes);
+  if (changes->removed)
+    changes->doc->DeleteNode(changes->removed);
+  XENO_free(changes->changes);
+  memset(changes, 0, sizeof(XENO_XMLChangeSet));
+}
@@ -0,0 +1,81 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include <xeno/platform.h>
+#include <xeno/xmlutils.h>
+#include <xeno/profiler.h>
+#include <physfs.h>
+#include <assert.h>
+
+XENO_PhysFSInputStream::XENO_PhysFSInputStream(const char *filename) : file(NULL) {
+  assert(PHYSFS_isInit() && filename);
+  file = PHYSFS_openRead(filename);
+  if (!file)
+    debugPrint("PhysFSInputStream: Couldn't open '%s': %s\n", filename, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+}
+
+
+XENO_PhysFSInputStream::~XENO_PhysFSInputStream() {
+  if (file)
+    PHYSFS_close(file);
+}
+
+
+int XENO_PhysFSInputStream::Read(char *buffer, int size) {
+  if (!file)
+    return -1;
+  return (int) PHYSFS_readBytes(file, buffer, (PHYSFS_uint64) size);
+}
+
+
+XENO_PhysFSOutputStream::XENO_PhysFSOutputStream(const char *filename) : file(NULL) {
+  assert(PHYSFS_isInit() && filename);
+  file = PHYSFS_openWrite(filename);
+  if (!file)
+    debugPrint("PhysFSOutputStream: Couldn't open '%s': %s\n", filename, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+}
+
+
+XENO_PhysFSOutputStream::~XENO_PhysFSOutputStream() {
+  close();
+}
+
+
+/** Closes the file early. Returns false if it wasn't open or couldn't be closed. */
+bool XENO_PhysFSOutputStream::close() {
+  if (!file)
+    return false;
+  bool ok = PHYSFS_close(file) != 0;
+  if (!ok)
+    debugPrint("PhysFSOutputStream: Couldn't close: %s\n", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+  file = NULL;
+  return ok;
+}
+
+
+bool XENO_PhysFSOutputStream::Write(const char *data, int size) {
+  if (!file)
+    return false;
+  if (PHYSFS_writeBytes(file, data, (PHYSFS_uint64) size) != size) {
+    debugPrint("PhysFSOutputStream: Couldn't write: %s\n", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    return false;
+  }
+  return true;
+}
+
+
+/** Writes a document (e.g. a save game) to the PhysFS write directory. Memory use is a
+ *  fixed buffer in the printer however large the document is. Returns false on failure. */
+bool XENO_saveXML(const tinyxml2::XMLDocument *doc, const char *filename, bool compact) {
+  XENO_ZONE("saveXML");
+  assert(doc && filename);
+  XENO_PhysFSOutputStream output(filename);
+  if (!output.isOpen())
+    return false;
+
+  tinyxml2::XMLPrinter printer(output, compact);
+  doc->Print(&printer);
+  bool ok = printer.Flush();
+  return output.close() && ok;
+}
@@ -99,10 +99,32 @@ static volatile size_t numArchivers = 0;
 /* mutexes ... */
 static void *errorLock = NULL;     /* protects error message list.        */
 static void *stateLock = NULL;     /* protects other PhysFS static state. */
+static void *poolLock = NULL;      /* protects the object pools.          */
+
+/* object pools ... */
+static __PHYSFS_Pool *pools = NULL;
+static __PHYSFS_Pool fileHandlePool = __PHYSFS_POOL(sizeof (FileHandle), 16);
+__PHYSFS_Pool __PHYSFS_ioPool = __PHYSFS_POOL(sizeof (PHYSFS_Io), 32);
+__PHYSFS_Pool __PHYSFS_bufferPool = __PHYSFS_POOL(__PHYSFS_POOLBUFSIZE, 1);
 
 /* allocator ... */
 static int externalAllocator = 0;
 PHYSFS_Allocator allocator;
+PHYSFS_ZipReadCallback __PHYSFS_zipReadCallback = NULL;
+PHYSFS_StepCallback __PHYSFS_stepCallback = NULL;
+
+
+/* PHYSFS_setBuffer() buffers that fit come from the buffer pool. */
+static void freeFileBuffer(FileHandle *fh)
+{
+    if (fh->buffer == NULL)
+        return;
+    else if (fh->bufsize <= __PHYSFS_POOLBUFSIZE)
+        __PHYSFS_poolFree(&__PHYSFS_bufferPool, fh->buffer);
+    else
+        allocator.Free(fh->buffer);
+    fh->buffer = NULL;
+} /* freeFileBuffer */
 
 
 #ifdef PHYSFS_NEED_ATOMIC_OP_FALLBACK
@@ -132,13 +154,17 @@ int __PHYSFS_ATOMIC_DECR(int *ptrval)
 /* PHYSFS_Io implementation for i/o to physical filesystem... */
 
 /* !!! FIXME: maybe refcount the paths in a string pool? */
+#define NATIVEIO_PATHSIZE 256
 typedef struct __PHYSFS_NativeIoInfo
 {
     void *handle;
     const char *path;
     int mode;   /* 'r', 'w', or 'a' */
+    char pathbuf[NATIVEIO_PATHSIZE];  /* path is kept here if it fits. */
 } NativeIoInfo;
 
+static __PHYSFS_Pool nativeIoInfoPool = __PHYSFS_POOL(sizeof (NativeIoInfo), 16);
+
 static PHYSFS_sint64 nativeIo_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
@@ -186,9 +212,10 @@ static void nativeIo_destroy(PHYSFS_Io *io)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
     __PHYSFS_platformClose(info->handle);
-    allocator.Free((void *) info->path);
-    allocator.Free(info);
-    allocator.Free(io);
+    if (info->path != info->pathbuf)
+        allocator.Free((void *) info->path);
+    __PHYSFS_poolFree(&nativeIoInfoPool, info);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
 } /* nativeIo_destroy */
 
 static const PHYSFS_Io __PHYSFS_nativeIoInterface =
@@ -210,13 +237,17 @@ PHYSFS_Io *__PHYSFS_createNativeIo(const char *path, const int mode)
     NativeIoInfo *info = NULL;
     void *handle = NULL;
     char *pathdup = NULL;
+    const size_t pathlen = strlen(path) + 1;
 
     assert((mode == 'r') || (mode == 'w') || (mode == 'a'));
-    io = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
+    io = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
     GOTO_IF(!io, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
-    info = (NativeIoInfo *) allocator.Malloc(sizeof (NativeIoInfo));
+    info = (NativeIoInfo *) __PHYSFS_poolAlloc(&nativeIoInfoPool);
     GOTO_IF(!info, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
-    pathdup = (char *) allocator.Malloc(strlen(path) + 1);
+    if (pathlen <= sizeof (info->pathbuf))
+        pathdup = info->pathbuf;
+    else
+        pathdup = (char *) allocator.Malloc(pathlen);
     GOTO_IF(!pathdup, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
 
     if (mode == 'r')
@@ -239,9 +270,9 @@ PHYSFS_Io *__PHYSFS_createNativeIo(const char *path, const int mode)
 
 createNativeIo_failed:
     if (handle != NULL) __PHYSFS_platformClose(handle);
-    if (pathdup != NULL) allocator.Free(pathdup);
-    if (info != NULL) allocator.Free(info);
-    if (io != NULL) allocator.Free(io);
+    if ((pathdup != NULL) && (pathdup != info->pathbuf)) allocator.Free(pathdup);
+    if (info != NULL) __PHYSFS_poolFree(&nativeIoInfoPool, info);
+    if (io != NULL) __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
     return NULL;
 } /* __PHYSFS_createNativeIo */
 
@@ -454,7 +485,7 @@ static PHYSFS_Io *handleIo_duplicate(PHYSFS_Io *io)
      *  abstraction. We're allowed to: we're physfs.c!
      */
     FileHandle *origfh = (FileHandle *) io->opaque;
-    FileHandle *newfh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
+    FileHandle *newfh = (FileHandle *) __PHYSFS_poolAlloc(&fileHandlePool);
     PHYSFS_Io *retval = NULL;
 
     GOTO_IF(!newfh, PHYSFS_ERR_OUT_OF_MEMORY, handleIo_dupe_failed);
@@ -500,8 +531,8 @@ handleIo_dupe_failed:
     if (newfh)
     {
         if (newfh->io != NULL) newfh->io->destroy(newfh->io);
-        if (newfh->buffer != NULL) allocator.Free(newfh->buffer);
-        allocator.Free(newfh);
+        freeFileBuffer(newfh);
+        __PHYSFS_poolFree(&fileHandlePool, newfh);
     } /* if */
 
     return NULL;
@@ -1135,6 +1166,10 @@ static int initializeMutexes(void)
     if (stateLock == NULL)
         goto initializeMutexes_failed;
 
+    poolLock = __PHYSFS_platformCreateMutex();
+    if (poolLock == NULL)
+        goto initializeMutexes_failed;
+
     return 1;  /* success. */
 
 initializeMutexes_failed:
@@ -1144,7 +1179,10 @@ initializeMutexes_failed:
     if (stateLock != NULL)
         __PHYSFS_platformDestroyMutex(stateLock);
 
-    errorLock = stateLock = NULL;
+    if (poolLock != NULL)
+        __PHYSFS_platformDestroyMutex(poolLock);
+
+    errorLock = stateLock = poolLock = NULL;
     return 0;  /* failed. */
 } /* initializeMutexes */
 
@@ -1262,7 +1300,8 @@ static int closeFileHandleList(FileHandle **list)
         } /* if */
 
         io->destroy(io);
-        allocator.Free(i);
+        freeFileBuffer(i);
+        __PHYSFS_poolFree(&fileHandlePool, i);
     } /* for */
 
     *list = NULL;
@@ -1347,6 +1386,26 @@ static void freeArchivers(void)
 } /* freeArchivers */
 
 
+/* Gives back every pool's slabs. Nothing may still be using them. */
+static void drainPools(void)
+{
+    while (pools != NULL)
+    {
+        __PHYSFS_Pool *pool = pools;
+        while (pool->slabs != NULL)
+        {
+            void *next = *((void **) pool->slabs);
+            allocator.Free(pool->slabs);
+            pool->slabs = next;
+        } /* while */
+        pool->freelist = NULL;
+        pool->registered = 0;
+        pools = pool->next;
+        pool->next = NULL;
+    } /* while */
+} /* drainPools */
+
+
 static int doDeinit(void)
 {
     closeFileHandleList(&openWriteList);
@@ -1355,6 +1414,7 @@ static int doDeinit(void)
     freeSearchPath();
     freeArchivers();
     freeErrorStates();
+    drainPools();
 
     if (baseDir != NULL)
     {
@@ -1391,11 +1451,12 @@ static int doDeinit(void)
 
     if (errorLock) __PHYSFS_platformDestroyMutex(errorLock);
     if (stateLock) __PHYSFS_platformDestroyMutex(stateLock);
+    if (poolLock) __PHYSFS_platformDestroyMutex(poolLock);
 
     if (allocator.Deinit != NULL)
         allocator.Deinit();
 
-    errorLock = stateLock = NULL;
+    errorLock = stateLock = poolLock = NULL;
 
     __PHYSFS_platformDeinit();
 
@@ -1434,6 +1495,69 @@ PHYSFS_uint32 __PHYSFS_hashString(const char *str, size_t len)
 } /* __PHYSFS_hashString */
 
 
+/* Slab headers and objects are padded to this, so objects are as aligned
+   as the allocator's own blocks. */
+#define POOL_ALIGN 16
+#define POOL_ROUNDUP(x) (((x) + (POOL_ALIGN - 1)) & ~((size_t) (POOL_ALIGN - 1)))
+
+void *__PHYSFS_poolAlloc(__PHYSFS_Pool *pool)
+{
+    void *retval;
+
+    if (poolLock != NULL)
+        __PHYSFS_platformGrabMutex(poolLock);
+
+    if (pool->freelist == NULL)  /* out of objects, carve up a new slab. */
+    {
+        const size_t objsize = POOL_ROUNDUP(pool->objsize);
+        PHYSFS_uint8 *slab = (PHYSFS_uint8 *) allocator.Malloc(POOL_ALIGN + (objsize * pool->perslab));
+        if (slab != NULL)
+        {
+            size_t i;
+            *((void **) slab) = pool->slabs;
+            pool->slabs = slab;
+            for (i = 0; i < pool->perslab; i++)
+            {
+                void *obj = slab + POOL_ALIGN + (i * objsize);
+                *((void **) obj) = pool->freelist;
+                pool->freelist = obj;
+            } /* for */
+
+            if (!pool->registered)
+            {
+                pool->registered = 1;
+                pool->next = pools;
+                pools = pool;
+            } /* if */
+        } /* if */
+    } /* if */
+
+    retval = pool->freelist;
+    if (retval != NULL)
+        pool->freelist = *((void **) retval);
+
+    if (poolLock != NULL)
+        __PHYSFS_platformReleaseMutex(poolLock);
+
+    BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    return retval;
+} /* __PHYSFS_poolAlloc */
+
+
+void __PHYSFS_poolFree(__PHYSFS_Pool *pool, void *obj)
+{
+    if (obj == NULL)
+        return;
+
+    if (poolLock != NULL)
+        __PHYSFS_platformGrabMutex(poolLock);
+    *((void **) obj) = pool->freelist;
+    pool->freelist = obj;
+    if (poolLock != NULL)
+        __PHYSFS_platformReleaseMutex(poolLock);
+} /* __PHYSFS_poolFree */
+
+
 /* MAKE SURE you hold stateLock before calling this! */
 static int doRegisterArchiver(const PHYSFS_Archiver *_archiver)
 {
@@ -2582,7 +2706,7 @@ static PHYSFS_File *doOpenWrite(const char *_fname, int appending)
 
         GOTO_IF_ERRPASS(!io, doOpenWriteEnd);
 
-        fh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
+        fh = (FileHandle *) __PHYSFS_poolAlloc(&fileHandlePool);
         if (fh == NULL)
         {
             io->destroy(io);
@@ -2652,7 +2776,7 @@ PHYSFS_File *PHYSFS_openRead(const char *_fname)
 
         GOTO_IF_ERRPASS(!io, openReadEnd);
 
-        fh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
+        fh = (FileHandle *) __PHYSFS_poolAlloc(&fileHandlePool);
         if (fh == NULL)
         {
             io->destroy(io);
@@ -2685,7 +2809,6 @@ static int closeHandleInOpenList(FileHandle **list, FileHandle *handle)
         if (i == handle)  /* handle is in this list? */
         {
             PHYSFS_Io *io = handle->io;
-            PHYSFS_uint8 *tmp = handle->buffer;
 
             /* send our buffer to io... */
             if (!handle->forReading)
@@ -2701,15 +2824,14 @@ static int closeHandleInOpenList(FileHandle **list, FileHandle *handle)
             /* ...then close the underlying file. */
             io->destroy(io);
 
-            if (tmp != NULL)  /* free any associated buffer. */
-                allocator.Free(tmp);
+            freeFileBuffer(handle);  /* free any associated buffer. */
 
             if (prev == NULL)
                 *list = handle->next;
             else
                 prev->next = handle->next;
 
-            allocator.Free(handle);
+            __PHYSFS_poolFree(&fileHandlePool, handle);
             return 1;
         } /* if */
         prev = i;
@@ -2959,22 +3081,28 @@ int PHYSFS_setBuffer(PHYSFS_File *handle, PHYSFS_uint64 _bufsize)
         BAIL_IF_ERRPASS(!fh->io->seek(fh->io, pos), 0);
     } /* if */
 
-    if (bufsize == 0)  /* delete existing buffer. */
+    /* the buffer's contents are spent, so there's nothing to realloc. */
+    if ((bufsize == 0) || (fh->buffer == NULL) ||
+        ((bufsize <= __PHYSFS_POOLBUFSIZE) != (fh->bufsize <= __PHYSFS_POOLBUFSIZE)))
     {
-        if (fh->buffer)
-        {
-            allocator.Free(fh->buffer);
-            fh->buffer = NULL;
-        } /* if */
+        freeFileBuffer(fh);
+        fh->bufsize = 0;
     } /* if */
 
-    else
+    if ((bufsize != 0) && (bufsize <= __PHYSFS_POOLBUFSIZE))
+    {
+        if (fh->buffer == NULL)
+            fh->buffer = (PHYSFS_uint8 *) __PHYSFS_poolAlloc(&__PHYSFS_bufferPool);
+        BAIL_IF_ERRPASS(!fh->buffer, 0);
+    } /* if */
+
+    else if (bufsize != 0)
     {
         PHYSFS_uint8 *newbuf;
         newbuf = (PHYSFS_uint8 *) allocator.Realloc(fh->buffer, bufsize);
         BAIL_IF(!newbuf, PHYSFS_ERR_OUT_OF_MEMORY, 0);
         fh->buffer = newbuf;
-    } /* else */
+    } /* else if */
 
     fh->bufsize = bufsize;
     fh->buffill = fh->bufpos = 0;
@@ -3066,9 +3194,15 @@ int __PHYSFS_readAll(PHYSFS_Io *io, void *buf, const size_t _len)
 } /* __PHYSFS_readAll */
 
 
+/* What the word in front of a smallAlloc'd block says about where it's from. */
+#define SMALLALLOC_STACK ((void *) 0)
+#define SMALLALLOC_HEAP ((void *) 1)
+#define SMALLALLOC_SCRATCH ((void *) 2)
+#define SMALLALLOC_SCRATCH_FREED ((void *) 3)
+
 void *__PHYSFS_initSmallAlloc(void *ptr, const size_t len)
 {
-    void *useHeap = ((ptr == NULL) ? ((void *) 1) : ((void *) 0));
+    void *useHeap = ((ptr == NULL) ? SMALLALLOC_HEAP : SMALLALLOC_STACK);
     if (useHeap)  /* too large for stack allocation or alloca() failed. */
         ptr = allocator.Malloc(len+sizeof (void *));
 
@@ -3085,14 +3219,66 @@ void *__PHYSFS_initSmallAlloc(void *ptr, const size_t len)
 } /* __PHYSFS_initSmallAlloc */
 
 
+#if PHYSFS_NO_ALLOCA
+#define SCRATCH_WORDS (__PHYSFS_SCRATCHSIZE / sizeof (void *))
+#define SCRATCH_NONE ((size_t) -1)
+
+/*
+ * Each block is [index of the block below][marker][data...], in words, so
+ *  the data stays pointer-aligned. Blocks freed out of order are only marked,
+ *  and popped with the block above them.
+ */
+typedef struct
+{
+    size_t top;  /* first free word */
+    size_t last;  /* most recent block, or SCRATCH_NONE */
+    void *words[SCRATCH_WORDS];
+} ScratchStack;
+
+static __PHYSFS_THREADLOCAL ScratchStack scratch = { 0, SCRATCH_NONE };
+
+void *__PHYSFS_scratchAlloc(const size_t len)
+{
+    const size_t datawords = (len + sizeof (void *) - 1) / sizeof (void *);
+    void **block;
+
+    /* too big for what's left, so it's the heap after all. */
+    if ((len >= __PHYSFS_SCRATCHSIZE) || (datawords + 2 > SCRATCH_WORDS - scratch.top))
+        return __PHYSFS_initSmallAlloc(NULL, len);
+
+    block = &scratch.words[scratch.top];
+    block[0] = (void *) scratch.last;
+    block[1] = SMALLALLOC_SCRATCH;
+    scratch.last = scratch.top;
+    scratch.top += datawords + 2;
+    return block + 2;
+} /* __PHYSFS_scratchAlloc */
+
+
+static void scratchFree(void **block)
+{
+    block[1] = SMALLALLOC_SCRATCH_FREED;
+    while ((scratch.last != SCRATCH_NONE) &&
+           (scratch.words[scratch.last + 1] == SMALLALLOC_SCRATCH_FREED))
+    {
+        scratch.top = scratch.last;
+        scratch.last = (size_t) scratch.words[scratch.last];
+    } /* while */
+} /* scratchFree */
+#endif
+
+
 void __PHYSFS_smallFree(void *ptr)
 {
     if (ptr != NULL)
     {
         void **block = ((void **) ptr) - 1;
-        const int useHeap = (*block != NULL);
-        if (useHeap)
+        if (*block == SMALLALLOC_HEAP)
             allocator.Free(block);
+#if PHYSFS_NO_ALLOCA
+        else if (*block == SMALLALLOC_SCRATCH)
+            scratchFree(block - 1);
+#endif
         /*printf("%s free'd (%p).\n", useHeap ? "heap" : "stack", block);*/
     } /* if */
 } /* __PHYSFS_smallFree */
@@ -3109,6 +3295,18 @@ int PHYSFS_setAllocator(const PHYSFS_Allocator *a)
 } /* PHYSFS_setAllocator */
 
 
+void PHYSFS_setZipReadCallback(PHYSFS_ZipReadCallback callback)
+{
+    __PHYSFS_zipReadCallback = callback;
+} /* PHYSFS_setZipReadCallback */
+
+
+void PHYSFS_setStepCallback(PHYSFS_StepCallback callback)
+{
+    __PHYSFS_stepCallback = callback;
+} /* PHYSFS_setStepCallback */
+
+
 const PHYSFS_Allocator *PHYSFS_getAllocator(void)
 {
     BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, NULL);
@@ -3844,6 +3844,69 @@ PHYSFS_DECL int PHYSFS_deregisterArchiver(const char *ext);
 
 /* Everything above this line is part of the PhysicsFS 2.1 API. */
 
+
+/**
+ * \typedef PHYSFS_ZipReadCallback
+ * \brief Function told about every read from a .zip archive entry.
+ *
+ *   \param compressed Bytes read from the archive to satisfy the request.
+ *   \param uncompressed Bytes handed back to the caller. This equals
+ *                       (compressed) for entries that are stored rather
+ *                       than deflated.
+ *
+ * \sa PHYSFS_setZipReadCallback
+ */
+typedef void (*PHYSFS_ZipReadCallback)(PHYSFS_uint64 compressed,
+                                       PHYSFS_uint64 uncompressed);
+
+/**
+ * \fn void PHYSFS_setZipReadCallback(PHYSFS_ZipReadCallback callback)
+ * \brief Report .zip reads to a function, for statistics.
+ *
+ * (callback) is called after each read from an entry in a .zip archive,
+ *  on whichever thread did the read, so it must be thread safe, and it
+ *  should be cheap. Reads that fail before any data is read aren't
+ *  reported.
+ *
+ * This may be called whether PhysicsFS is initialized or not, and the
+ *  callback stays set across PHYSFS_deinit(). Pass NULL to stop.
+ *
+ *   \param callback Function to call, or NULL.
+ */
+PHYSFS_DECL void PHYSFS_setZipReadCallback(PHYSFS_ZipReadCallback callback);
+
+
+/**
+ * \typedef PHYSFS_StepCallback
+ * \brief Function told when PhysicsFS starts and finishes a costly step.
+ *
+ *   \param step Name of the step, like "zip_load_entries".
+ *   \param detail What it's working on, like the archive's name. May be
+ *                 NULL. Neither string outlives the call.
+ *   \param begin Non-zero when the step starts, zero when it's finished,
+ *                whether it succeeded or not.
+ *
+ * \sa PHYSFS_setStepCallback
+ */
+typedef void (*PHYSFS_StepCallback)(const char *step, const char *detail,
+                                    int begin);
+
+/**
+ * \fn void PHYSFS_setStepCallback(PHYSFS_StepCallback callback)
+ * \brief Report the steps of mounting an archive to a function, for timing.
+ *
+ * .zip archives report "zip_parse_end_of_central_dir" and "zip_load_entries"
+ *  with the archive's name as the detail. Steps may nest, and are reported
+ *  on whichever thread does the work, so (callback) must be thread safe.
+ *
+ * This may be called whether PhysicsFS is initialized or not, and the
+ *  callback stays set across PHYSFS_deinit(). Pass NULL to stop.
+ *
+ *   \param callback Function to call, or NULL.
+ */
+PHYSFS_DECL void PHYSFS_setStepCallback(PHYSFS_StepCallback callback);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -213,12 +213,25 @@ static int zip_prep_crypto_keys(ZIPfileinfo *finfo, const PHYSFS_uint8 *crypto_h
 } /* zip_prep_crypto_keys */
 
 
+/*
+ * Per-file state is pooled, so streaming lots of small files out of an
+ *  archive doesn't churn the allocator. Read buffers come from the shared
+ *  buffer pool.
+ */
+__PHYSFS_COMPILE_TIME_ASSERT(readBufFitsPool, ZIP_READBUFSIZE <= __PHYSFS_POOLBUFSIZE);
+static __PHYSFS_Pool fileInfoPool = __PHYSFS_POOL(sizeof (ZIPfileinfo), 16);
+
+/* miniz's only allocation is its inflate state, 32k window and all. */
+static __PHYSFS_Pool inflateStatePool = __PHYSFS_POOL(sizeof (inflate_state), 1);
+
 /*
  * Bridge physfs allocation functions to zlib's format...
  */
 static voidpf zlibPhysfsAlloc(voidpf opaque, uInt items, uInt size)
 {
-    return ((PHYSFS_Allocator *) opaque)->Malloc(items * size);
+    __PHYSFS_Pool *pool = (__PHYSFS_Pool *) opaque;
+    BAIL_IF(((size_t) items * size) > pool->objsize, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    return __PHYSFS_poolAlloc(pool);
 } /* zlibPhysfsAlloc */
 
 /*
@@ -226,7 +239,7 @@ static voidpf zlibPhysfsAlloc(voidpf opaque, uInt items, uInt size)
  */
 static void zlibPhysfsFree(voidpf opaque, voidpf address)
 {
-    ((PHYSFS_Allocator *) opaque)->Free(address);
+    __PHYSFS_poolFree((__PHYSFS_Pool *) opaque, address);
 } /* zlibPhysfsFree */
 
 
@@ -238,7 +251,7 @@ static void initializeZStream(z_stream *pstr)
     memset(pstr, '\0', sizeof (z_stream));
     pstr->zalloc = zlibPhysfsAlloc;
     pstr->zfree = zlibPhysfsFree;
-    pstr->opaque = &allocator;
+    pstr->opaque = &inflateStatePool;
 } /* initializeZStream */
 
 
@@ -304,6 +317,7 @@ static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
     ZIPfileinfo *finfo = (ZIPfileinfo *) _io->opaque;
     ZIPentry *entry = finfo->entry;
     PHYSFS_sint64 retval = 0;
+    PHYSFS_sint64 compressed = 0;
     PHYSFS_sint64 maxread = (PHYSFS_sint64) len;
     PHYSFS_sint64 avail = entry->uncompressed_size -
                           finfo->uncompressed_position;
@@ -314,7 +328,7 @@ static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
     BAIL_IF_ERRPASS(maxread == 0, 0);    /* quick rejection. */
 
     if (entry->compression_method == COMPMETH_NONE)
-        retval = zip_read_decrypt(finfo, buf, maxread);
+        compressed = retval = zip_read_decrypt(finfo, buf, maxread);
     else
     {
         finfo->stream.next_out = buf;
@@ -340,6 +354,7 @@ static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
                         break;
 
                     finfo->compressed_position += (PHYSFS_uint32) br;
+                    compressed += br;
                     finfo->stream.next_in = finfo->buffer;
                     finfo->stream.avail_in = (unsigned int) br;
                 } /* if */
@@ -356,6 +371,12 @@ static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
     if (retval > 0)
         finfo->uncompressed_position += (PHYSFS_uint32) retval;
 
+    if ((__PHYSFS_zipReadCallback != NULL) && ((retval > 0) || (compressed > 0)))
+    {
+        __PHYSFS_zipReadCallback((PHYSFS_uint64) compressed,
+                                 (PHYSFS_uint64) ((retval > 0) ? retval : 0));
+    } /* if */
+
     return retval;
 } /* ZIP_read */
 
@@ -445,8 +466,8 @@ static PHYSFS_Io *zip_get_io(PHYSFS_Io *io, ZIPinfo *inf, ZIPentry *entry);
 static PHYSFS_Io *ZIP_duplicate(PHYSFS_Io *io)
 {
     ZIPfileinfo *origfinfo = (ZIPfileinfo *) io->opaque;
-    PHYSFS_Io *retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    ZIPfileinfo *finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo));
+    PHYSFS_Io *retval = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    ZIPfileinfo *finfo = (ZIPfileinfo *) __PHYSFS_poolAlloc(&fileInfoPool);
     GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, failed);
     GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, failed);
     memset(finfo, '\0', sizeof (*finfo));
@@ -458,7 +479,7 @@ static PHYSFS_Io *ZIP_duplicate(PHYSFS_Io *io)
     initializeZStream(&finfo->stream);
     if (finfo->entry->compression_method != COMPMETH_NONE)
     {
-        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
+        finfo->buffer = (PHYSFS_uint8 *) __PHYSFS_poolAlloc(&__PHYSFS_bufferPool);
         GOTO_IF(!finfo->buffer, PHYSFS_ERR_OUT_OF_MEMORY, failed);
         if (zlib_err(inflateInit2(&finfo->stream, -MAX_WBITS)) != Z_OK)
             goto failed;
@@ -476,15 +497,15 @@ failed:
 
         if (finfo->buffer != NULL)
         {
-            allocator.Free(finfo->buffer);
+            __PHYSFS_poolFree(&__PHYSFS_bufferPool, finfo->buffer);
             inflateEnd(&finfo->stream);
         } /* if */
 
-        allocator.Free(finfo);
+        __PHYSFS_poolFree(&fileInfoPool, finfo);
     } /* if */
 
     if (retval != NULL)
-        allocator.Free(retval);
+        __PHYSFS_poolFree(&__PHYSFS_ioPool, retval);
 
     return NULL;
 } /* ZIP_duplicate */
@@ -500,10 +521,10 @@ static void ZIP_destroy(PHYSFS_Io *io)
         inflateEnd(&finfo->stream);
 
     if (finfo->buffer != NULL)
-        allocator.Free(finfo->buffer);
+        __PHYSFS_poolFree(&__PHYSFS_bufferPool, finfo->buffer);
 
-    allocator.Free(finfo);
-    allocator.Free(io);
+    __PHYSFS_poolFree(&fileInfoPool, finfo);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
 } /* ZIP_destroy */
 
 
@@ -1466,6 +1487,7 @@ static void *ZIP_openArchive(PHYSFS_Io *io, const char *name,
     PHYSFS_uint64 dstart = 0;  /* data start */
     PHYSFS_uint64 cdir_ofs;  /* central dir offset */
     PHYSFS_uint64 count;
+    int rc;
 
     assert(io != NULL);  /* shouldn't ever happen. */
 
@@ -1480,7 +1502,10 @@ static void *ZIP_openArchive(PHYSFS_Io *io, const char *name,
 
     info->io = io;
 
-    if (!zip_parse_end_of_central_dir(info, &dstart, &cdir_ofs, &count))
+    __PHYSFS_STEP("zip_parse_end_of_central_dir", name, 1);
+    rc = zip_parse_end_of_central_dir(info, &dstart, &cdir_ofs, &count);
+    __PHYSFS_STEP("zip_parse_end_of_central_dir", name, 0);
+    if (!rc)
         goto ZIP_openarchive_failed;
     else if (!__PHYSFS_DirTreeInit(&info->tree, sizeof (ZIPentry)))
         goto ZIP_openarchive_failed;
@@ -1488,7 +1513,10 @@ static void *ZIP_openArchive(PHYSFS_Io *io, const char *name,
     root = (ZIPentry *) info->tree.root;
     root->resolved = ZIP_DIRECTORY;
 
-    if (!zip_load_entries(info, dstart, cdir_ofs, count))
+    __PHYSFS_STEP("zip_load_entries", name, 1);
+    rc = zip_load_entries(info, dstart, cdir_ofs, count);
+    __PHYSFS_STEP("zip_load_entries", name, 0);
+    if (!rc)
         goto ZIP_openarchive_failed;
 
     assert(info->tree.root->sibling == NULL);
@@ -1560,11 +1588,11 @@ static PHYSFS_Io *ZIP_openRead(void *opaque, const char *filename)
 
     BAIL_IF(entry->tree.isdir, PHYSFS_ERR_NOT_A_FILE, NULL);
 
-    retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
+    retval = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    GOTO_IF_ERRPASS(!retval, ZIP_openRead_failed);
 
-    finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo));
-    GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
+    finfo = (ZIPfileinfo *) __PHYSFS_poolAlloc(&fileInfoPool);
+    GOTO_IF_ERRPASS(!finfo, ZIP_openRead_failed);
     memset(finfo, '\0', sizeof (ZIPfileinfo));
 
     io = zip_get_io(info->io, info, entry);
@@ -1575,9 +1603,9 @@ static PHYSFS_Io *ZIP_openRead(void *opaque, const char *filename)
 
     if (finfo->entry->compression_method != COMPMETH_NONE)
     {
-        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
+        finfo->buffer = (PHYSFS_uint8 *) __PHYSFS_poolAlloc(&__PHYSFS_bufferPool);
         if (!finfo->buffer)
-            GOTO(PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
+            goto ZIP_openRead_failed;
         else if (zlib_err(inflateInit2(&finfo->stream, -MAX_WBITS)) != Z_OK)
             goto ZIP_openRead_failed;
     } /* if */
@@ -1607,15 +1635,15 @@ ZIP_openRead_failed:
 
         if (finfo->buffer != NULL)
         {
-            allocator.Free(finfo->buffer);
+            __PHYSFS_poolFree(&__PHYSFS_bufferPool, finfo->buffer);
             inflateEnd(&finfo->stream);
         } /* if */
 
-        allocator.Free(finfo);
+        __PHYSFS_poolFree(&fileInfoPool, finfo);
     } /* if */
 
     if (retval != NULL)
-        allocator.Free(retval);
+        __PHYSFS_poolFree(&__PHYSFS_ioPool, retval);
 
     return NULL;
 } /* ZIP_openRead */
@@ -42,6 +42,17 @@
 #include <alloca.h>
 #endif
 
+/* The Xbox has no alloca(); smallAlloc uses a per-thread scratch stack. */
+#if (defined PHYSFS_PLATFORM_NXDK) && !(defined PHYSFS_NO_ALLOCA)
+#define PHYSFS_NO_ALLOCA 1
+#endif
+
+#ifdef _MSC_VER
+#define __PHYSFS_THREADLOCAL __declspec(thread)
+#else
+#define __PHYSFS_THREADLOCAL __thread
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -143,15 +154,24 @@ int __PHYSFS_ATOMIC_DECR(int *ptrval);
  * NEVER realloc a pointer from this.
  * NEVER forget to use smallFree: it may not be a pointer from the stack.
  * NEVER forget to check for NULL...allocation can fail here, of course!
+ * Without alloca() (PHYSFS_NO_ALLOCA), small allocations come from a
+ *  per-thread scratch stack, which is popped by smallFree, so free them in
+ *  the reverse order they were made in.
  */
 #define __PHYSFS_SMALLALLOCTHRESHOLD 256
 void *__PHYSFS_initSmallAlloc(void *ptr, const size_t len);
 
+#if PHYSFS_NO_ALLOCA
+#define __PHYSFS_SCRATCHSIZE 8192
+void *__PHYSFS_scratchAlloc(const size_t len);
+#define __PHYSFS_smallAlloc(bytes) __PHYSFS_scratchAlloc((size_t) (bytes))
+#else
 #define __PHYSFS_smallAlloc(bytes) ( \
     __PHYSFS_initSmallAlloc( \
         (((bytes) < __PHYSFS_SMALLALLOCTHRESHOLD) ? \
             alloca((size_t)((bytes)+sizeof(void*))) : NULL), (bytes)) \
 )
+#endif
 
 void __PHYSFS_smallFree(void *ptr);
 
@@ -314,6 +334,45 @@ char *__PHYSFS_strdup(const char *str);
  */
 PHYSFS_uint32 __PHYSFS_hashString(const char *str, size_t len);
 
+/*
+ * Fixed-size object pools, for what gets made and thrown away with every
+ *  open file: handles, PHYSFS_Io structs, read buffers, inflate state.
+ *  Objects are carved from slabs of (perslab) objects and recycled through
+ *  a free list, so opening and closing files stops hitting the allocator
+ *  once a pool has grown to the most objects ever in use at once. Slabs
+ *  are only given back by PHYSFS_deinit(). Safe to use from any thread.
+ */
+typedef struct __PHYSFS_Pool
+{
+    size_t objsize;
+    size_t perslab;
+    void *freelist;
+    void *slabs;
+    int registered;  /* in the list PHYSFS_deinit() drains? */
+    struct __PHYSFS_Pool *next;
+} __PHYSFS_Pool;
+
+#define __PHYSFS_POOL(objsize, perslab) { (objsize), (perslab), NULL, NULL, 0, NULL }
+
+void *__PHYSFS_poolAlloc(__PHYSFS_Pool *pool);
+void __PHYSFS_poolFree(__PHYSFS_Pool *pool, void *obj);
+
+/* Shared by the archivers: PHYSFS_Io structs, and 16k read buffers. */
+#define __PHYSFS_POOLBUFSIZE (16 * 1024)
+extern __PHYSFS_Pool __PHYSFS_ioPool;
+extern __PHYSFS_Pool __PHYSFS_bufferPool;
+
+/* Set by PHYSFS_setZipReadCallback(); NULL if nobody is listening. */
+extern PHYSFS_ZipReadCallback __PHYSFS_zipReadCallback;
+
+/* Set by PHYSFS_setStepCallback(); reports a step starting or finishing. */
+extern PHYSFS_StepCallback __PHYSFS_stepCallback;
+#define __PHYSFS_STEP(step, detail, begin) \
+    do { \
+        if (__PHYSFS_stepCallback != NULL) \
+            __PHYSFS_stepCallback(step, detail, begin); \
+    } while (0)
+
 
 /*
  * The current allocator. Not valid before PHYSFS_init is called!
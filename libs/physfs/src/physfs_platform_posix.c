@@ -157,6 +157,9 @@ int __PHYSFS_platformMkDir(const char *path)
 } /* __PHYSFS_platformMkDir */
 
 
+/* The fd is handed around by pointer, so the ints are pooled. */
+static __PHYSFS_Pool fdPool = __PHYSFS_POOL(sizeof (int), 64);
+
 static void *doOpen(const char *filename, int mode)
 {
     const int appending = (mode & O_APPEND);
@@ -180,11 +183,11 @@ static void *doOpen(const char *filename, int mode)
         } /* if */
     } /* if */
 
-    retval = (int *) allocator.Malloc(sizeof (int));
+    retval = (int *) __PHYSFS_poolAlloc(&fdPool);
     if (!retval)
     {
         close(fd);
-        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        BAIL_ERRPASS(NULL);
     } /* if */
 
     *retval = fd;
@@ -285,7 +288,7 @@ void __PHYSFS_platformClose(void *opaque)
 {
     const int fd = *((int *) opaque);
     (void) close(fd);  /* we don't check this. You should have used flush! */
-    allocator.Free(opaque);
+    __PHYSFS_poolFree(&fdPool, opaque);
 } /* __PHYSFS_platformClose */
 
 
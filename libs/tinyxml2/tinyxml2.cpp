@@ -28,9 +28,22 @@ distribution.
 #if defined(ANDROID_NDK) || defined(__BORLANDC__) || defined(__QNXNTO__) || defined(NXDK)
 #   include <stddef.h>
 #   include <stdarg.h>
+#   include <float.h>
 #else
 #   include <cstddef>
 #   include <cstdarg>
+#   include <cfloat>
+#endif
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define TIXML_SIMD_BYTES 32
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#   include <emmintrin.h>
+#   define TIXML_SIMD_BYTES 16
+#endif
+#if defined(TIXML_SIMD_BYTES) && defined(_MSC_VER)
+#   include <intrin.h>
 #endif
 
 #if defined(_MSC_VER) && (_MSC_VER >= 1400 ) && (!defined WINCE) && (!defined NXDK)
@@ -136,6 +149,175 @@ static const Entity entities[NUM_ENTITIES] = {
 };
 
 
+// The tokenizer's inner loops: whitespace runs, the next delimiter, and the
+// next byte StrPair::GetStr() has to rewrite. With SSE2 or AVX2 these test a
+// whole block of bytes at once, and count newlines with a popcount.
+#ifdef TIXML_SIMD_BYTES
+
+#if defined(__GNUC__) || defined(__clang__)
+// The block loads are aligned, so they never cross into an unmapped page,
+// but they do read past the terminator.
+#   define TIXML_NO_SANITIZE __attribute__((no_sanitize_address))
+static inline int CountBits( unsigned v )	{ return __builtin_popcount( v ); }
+static inline int LowestBit( unsigned v )	{ return __builtin_ctz( v ); }
+#else
+#   define TIXML_NO_SANITIZE
+static inline int CountBits( unsigned v )
+{
+    v = v - ( ( v >> 1 ) & 0x55555555u );
+    v = ( v & 0x33333333u ) + ( ( v >> 2 ) & 0x33333333u );
+    return static_cast<int>( ( ( ( v + ( v >> 4 ) ) & 0x0f0f0f0fu ) * 0x01010101u ) >> 24 );
+}
+static inline int LowestBit( unsigned v )
+{
+    unsigned long i;
+    _BitScanForward( &i, v );
+    return static_cast<int>( i );
+}
+#endif
+
+#if TIXML_SIMD_BYTES == 32
+typedef __m256i SimdBlock;
+static const unsigned SIMD_MASK = 0xffffffffu;
+TIXML_NO_SANITIZE static inline SimdBlock SimdLoad( const char* p )	{ return _mm256_load_si256( reinterpret_cast<const __m256i*>( p ) ); }
+static inline SimdBlock SimdSplat( char c )			{ return _mm256_set1_epi8( c ); }
+static inline unsigned SimdEq( SimdBlock b, SimdBlock c )	{ return static_cast<unsigned>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( b, c ) ) ); }
+static inline unsigned SimdLessEq( SimdBlock b, SimdBlock c )	{ return SimdEq( _mm256_min_epu8( b, c ), b ); }
+static inline SimdBlock SimdSub( SimdBlock b, SimdBlock c )	{ return _mm256_sub_epi8( b, c ); }
+#else
+typedef __m128i SimdBlock;
+static const unsigned SIMD_MASK = 0xffffu;
+TIXML_NO_SANITIZE static inline SimdBlock SimdLoad( const char* p )	{ return _mm_load_si128( reinterpret_cast<const __m128i*>( p ) ); }
+static inline SimdBlock SimdSplat( char c )			{ return _mm_set1_epi8( c ); }
+static inline unsigned SimdEq( SimdBlock b, SimdBlock c )	{ return static_cast<unsigned>( _mm_movemask_epi8( _mm_cmpeq_epi8( b, c ) ) ); }
+static inline unsigned SimdLessEq( SimdBlock b, SimdBlock c )	{ return SimdEq( _mm_min_epu8( b, c ), b ); }
+static inline SimdBlock SimdSub( SimdBlock b, SimdBlock c )	{ return _mm_sub_epi8( b, c ); }
+#endif
+
+// Bit i is set if byte i is ' ' or '\t' through '\r', the bytes IsWhiteSpace() accepts
+static inline unsigned SimdSpaces( SimdBlock b )
+{
+    return SimdEq( b, SimdSplat( ' ' ) ) | SimdLessEq( SimdSub( b, SimdSplat( '\t' ) ), SimdSplat( '\r' - '\t' ) );
+}
+
+struct ScanNotSpace {
+    unsigned operator()( SimdBlock b ) const	{ return ~SimdSpaces( b ); }
+};
+
+struct ScanSpace {
+    unsigned operator()( SimdBlock b ) const	{ return SimdSpaces( b ) | SimdEq( b, SimdSplat( 0 ) ); }
+};
+
+struct ScanChar {
+    SimdBlock c;
+    explicit ScanChar( char ch ) : c( SimdSplat( ch ) ) {}
+    unsigned operator()( SimdBlock b ) const	{ return SimdEq( b, c ) | SimdEq( b, SimdSplat( 0 ) ); }
+};
+
+struct ScanRewrite {
+    unsigned operator()( SimdBlock b ) const {
+        return SimdEq( b, SimdSplat( CR ) ) | SimdEq( b, SimdSplat( LF ) ) | SimdEq( b, SimdSplat( '&' ) )
+               | SimdEq( b, SimdSplat( 0 ) );
+    }
+};
+
+// Returns the first byte at or after p that 'match' flags; every matcher flags
+// the terminator, so the scan always stops. Newlines before it are added to
+// *curLineNumPtr, if given.
+template< class Match >
+TIXML_NO_SANITIZE static const char* ScanBlocks( const char* p, const Match& match, int* curLineNumPtr )
+{
+    const size_t offset = reinterpret_cast<size_t>( p ) & ( TIXML_SIMD_BYTES - 1 );
+    const char* block = p - offset;
+    unsigned live = ( SIMD_MASK << offset ) & SIMD_MASK;
+    for( ;; ) {
+        const SimdBlock b = SimdLoad( block );
+        const unsigned found = match( b ) & live;
+        if ( found ) {
+            const int i = LowestBit( found );
+            if ( curLineNumPtr ) {
+                *curLineNumPtr += CountBits( SimdEq( b, SimdSplat( LF ) ) & live & ( ( 1u << i ) - 1 ) );
+            }
+            return block + i;
+        }
+        if ( curLineNumPtr ) {
+            *curLineNumPtr += CountBits( SimdEq( b, SimdSplat( LF ) ) & live );
+        }
+        block += TIXML_SIMD_BYTES;
+        live = SIMD_MASK;
+    }
+}
+
+static const char* ScanToNonSpace( const char* p, int* curLineNumPtr )
+{
+    return ScanBlocks( p, ScanNotSpace(), curLineNumPtr );
+}
+
+static const char* ScanToSpace( const char* p )
+{
+    return ScanBlocks( p, ScanSpace(), 0 );
+}
+
+static const char* ScanToChar( const char* p, char ch, int* curLineNumPtr )
+{
+    return ScanBlocks( p, ScanChar( ch ), curLineNumPtr );
+}
+
+static const char* ScanToRewrite( const char* p )
+{
+    return ScanBlocks( p, ScanRewrite(), 0 );
+}
+
+#else
+
+static const char* ScanToNonSpace( const char* p, int* curLineNumPtr )
+{
+    while( XMLUtil::IsWhiteSpace( *p ) ) {
+        if ( curLineNumPtr && *p == LF ) {
+            ++(*curLineNumPtr);
+        }
+        ++p;
+    }
+    return p;
+}
+
+static const char* ScanToSpace( const char* p )
+{
+    while ( *p && !XMLUtil::IsWhiteSpace( *p ) ) {
+        ++p;
+    }
+    return p;
+}
+
+static const char* ScanToChar( const char* p, char ch, int* curLineNumPtr )
+{
+    while ( *p && *p != ch ) {
+        if ( *p == LF ) {
+            ++(*curLineNumPtr);
+        }
+        ++p;
+    }
+    return p;
+}
+
+static const char* ScanToRewrite( const char* p )
+{
+    while ( *p && *p != CR && *p != LF && *p != '&' ) {
+        ++p;
+    }
+    return p;
+}
+
+#endif
+
+
+const char* XMLUtil::SkipWhiteSpaceRun( const char* p, int* curLineNumPtr )
+{
+    TIXMLASSERT( p );
+    return ScanToNonSpace( p, curLineNumPtr );
+}
+
+
 StrPair::~StrPair()
 {
     Reset();
@@ -178,16 +360,24 @@ void StrPair::Reset()
 }
 
 
-void StrPair::SetStr( const char* str, int flags )
+void StrPair::SetStr( const char* str, int flags, XMLArena* arena )
 {
     TIXMLASSERT( str );
     Reset();
     size_t len = strlen( str );
     TIXMLASSERT( _start == 0 );
-    _start = new char[ len+1 ];
+    if ( arena ) {
+        // Owned by the arena; nothing to delete
+        _start = static_cast<char*>( arena->Alloc( len+1 ) );
+        flags &= ~NEEDS_DELETE;
+    }
+    else {
+        _start = new char[ len+1 ];
+        flags |= NEEDS_DELETE;
+    }
     memcpy( _start, str, len+1 );
     _end = _start + len;
-    _flags = flags | NEEDS_DELETE;
+    _flags = flags;
 }
 
 
@@ -200,19 +390,20 @@ char* StrPair::ParseText( char* p, const char* endTag, int strFlags, int* curLin
     char* start = p;
     const char  endChar = *endTag;
     size_t length = strlen( endTag );
+    TIXMLASSERT( endChar != LF );
 
     // Inner loop of text parsing.
-    while ( *p ) {
-        if ( *p == endChar && strncmp( p, endTag, length ) == 0 ) {
+    for( ;; ) {
+        p = const_cast<char*>( ScanToChar( p, endChar, curLineNumPtr ) );
+        if ( !*p ) {
+            return 0;
+        }
+        if ( strncmp( p, endTag, length ) == 0 ) {
             Set( start, p, strFlags );
             return p + length;
-        } else if (*p == '\n') {
-            ++(*curLineNumPtr);
         }
         ++p;
-        TIXMLASSERT( p );
     }
-    return 0;
 }
 
 
@@ -247,18 +438,19 @@ void StrPair::CollapseWhitespace()
         const char* p = _start;	// the read pointer
         char* q = _start;	// the write pointer
 
-        while( *p ) {
-            if ( XMLUtil::IsWhiteSpace( *p )) {
-                p = XMLUtil::SkipWhiteSpace( p, 0 );
-                if ( *p == 0 ) {
-                    break;    // don't write to q; this trims the trailing space.
-                }
-                *q = ' ';
-                ++q;
+        for( ;; ) {
+            // Copy the word, then replace the run of space after it with one ' '
+            const char* space = ScanToSpace( p );
+            if ( q != p ) {
+                memmove( q, p, space - p );
             }
-            *q = *p;
+            q += space - p;
+            p = ScanToNonSpace( space, 0 );
+            if ( *p == 0 ) {
+                break;    // don't write to q; this trims the trailing space.
+            }
+            *q = ' ';
             ++q;
-            ++p;
         }
         *q = 0;
     }
@@ -274,8 +466,9 @@ const char* StrPair::GetStr()
         _flags ^= NEEDS_FLUSH;
 
         if ( _flags ) {
-            const char* p = _start;	// the read pointer
-            char* q = _start;	// the write pointer
+            // Nothing moves until the first CR, LF or entity
+            const char* p = ScanToRewrite( _start );	// the read pointer
+            char* q = const_cast<char*>( p );	// the write pointer
 
             while( p < _end ) {
                 if ( (_flags & NEEDS_NEWLINE_NORMALIZATION) && *p == CR ) {
@@ -347,9 +540,12 @@ const char* StrPair::GetStr()
                     }
                 }
                 else {
-                    *q = *p;
-                    ++p;
-                    ++q;
+                    // Copy up to the next byte that needs rewriting in one go
+                    const char* next = ScanToRewrite( p + 1 );
+                    TIXMLASSERT( next <= _end );
+                    memmove( q, p, next - p );
+                    q += next - p;
+                    p = next;
                 }
             }
             *q = 0;
@@ -368,6 +564,196 @@ const char* StrPair::GetStr()
 
 
 
+// --------- XMLArena ----------- //
+
+XMLArena::XMLArena( size_t blockSize ) :
+    _first( 0 ),
+    _current( 0 ),
+    _top( 0 ),
+    _end( 0 ),
+    _usedBefore( 0 ),
+    _blockSize( blockSize )
+{
+}
+
+
+XMLArena::~XMLArena()
+{
+    Release();
+}
+
+
+void XMLArena::Reset()
+{
+    // The next Alloc() starts over from the first block
+    _current = 0;
+    _top = 0;
+    _end = 0;
+    _usedBefore = 0;
+}
+
+
+void XMLArena::Release()
+{
+    while ( _first ) {
+        Block* next = _first->next;
+        delete [] reinterpret_cast<char*>( _first );
+        _first = next;
+    }
+    Reset();
+}
+
+
+size_t XMLArena::Used() const
+{
+    return _current ? _usedBefore + ( _top - Data( _current ) ) : 0;
+}
+
+
+size_t XMLArena::Reserved() const
+{
+    size_t reserved = 0;
+    for( const Block* block = _first; block; block = block->next ) {
+        reserved += block->size;
+    }
+    return reserved;
+}
+
+
+void* XMLArena::AllocFromNextBlock( size_t size )
+{
+    // Reuse the next block kept from before a Reset() if the request fits,
+    // otherwise slot a new one in after the current block.
+    Block* next = _current ? _current->next : _first;
+    if ( !next || next->size < size ) {
+        const size_t blockSize = size > _blockSize ? size : _blockSize;
+        Block* block = reinterpret_cast<Block*>( new char[HEADER_SIZE + blockSize] );
+        block->next = next;
+        block->size = blockSize;
+        if ( _current ) {
+            _current->next = block;
+        }
+        else {
+            _first = block;
+        }
+        next = block;
+    }
+
+    if ( _current ) {
+        _usedBefore += _top - Data( _current );
+    }
+    _current = next;
+    _top = Data( next ) + size;
+    _end = Data( next ) + next->size;
+    return Data( next );
+}
+
+
+// --------- XMLAtomTable ----------- //
+
+XMLAtomTable::XMLAtomTable() :
+    _storage( 4 * 1024 ),
+    _names(),
+    _hashes(),
+    _slots( 0 ),
+    _nSlots( 64 )
+{
+    _slots = new XMLAtom[_nSlots];
+    memset( _slots, 0, sizeof( XMLAtom ) * _nSlots );
+    // Atom 0 means no name
+    _names.Push( "" );
+    _hashes.Push( 0 );
+}
+
+
+XMLAtomTable::~XMLAtomTable()
+{
+    delete [] _slots;
+}
+
+
+unsigned XMLAtomTable::Hash( const char* name, size_t length )
+{
+    // FNV-1a
+    unsigned hash = 2166136261u;
+    for( size_t i = 0; i < length; ++i ) {
+        hash ^= static_cast<unsigned char>( name[i] );
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+// Returns the slot holding the name, or the empty slot where it belongs
+int XMLAtomTable::FindSlot( const char* name, size_t length, unsigned hash ) const
+{
+    const int mask = _nSlots - 1;
+    for( int slot = static_cast<int>( hash ) & mask; ; slot = ( slot + 1 ) & mask ) {
+        const XMLAtom atom = _slots[slot];
+        if ( !atom ) {
+            return slot;
+        }
+        if ( _hashes[atom] == hash && XMLUtil::StringEqual( _names[atom], name, static_cast<int>( length ) )
+                && !_names[atom][length] ) {
+            return slot;
+        }
+    }
+}
+
+
+void XMLAtomTable::Grow()
+{
+    delete [] _slots;
+    _nSlots *= 2;
+    _slots = new XMLAtom[_nSlots];
+    memset( _slots, 0, sizeof( XMLAtom ) * _nSlots );
+
+    const int mask = _nSlots - 1;
+    for( XMLAtom atom = 1; atom < _names.Size(); ++atom ) {
+        int slot = static_cast<int>( _hashes[atom] ) & mask;
+        while ( _slots[slot] ) {
+            slot = ( slot + 1 ) & mask;
+        }
+        _slots[slot] = atom;
+    }
+}
+
+
+XMLAtom XMLAtomTable::Intern( const char* name, size_t length )
+{
+    TIXMLASSERT( name );
+    const unsigned hash = Hash( name, length );
+    int slot = FindSlot( name, length, hash );
+    if ( _slots[slot] ) {
+        return _slots[slot];
+    }
+
+    // Keep the load factor under a half, so probes stay short
+    if ( ( _names.Size() + 1 ) * 2 > _nSlots ) {
+        Grow();
+        slot = FindSlot( name, length, hash );
+    }
+
+    char* copy = static_cast<char*>( _storage.Alloc( length + 1 ) );
+    memcpy( copy, name, length );
+    copy[length] = 0;
+
+    const XMLAtom atom = _names.Size();
+    _names.Push( copy );
+    _hashes.Push( hash );
+    _slots[slot] = atom;
+    return atom;
+}
+
+
+XMLAtom XMLAtomTable::Find( const char* name ) const
+{
+    TIXMLASSERT( name );
+    const size_t length = strlen( name );
+    return _slots[FindSlot( name, length, Hash( name, length ) )];
+}
+
+
 // --------- XMLUtil ----------- //
 
 const char* XMLUtil::writeBoolTrue  = "true";
@@ -595,9 +981,86 @@ void XMLUtil::ToStr( uint64_t v, char* buffer, int bufferSize )
     TIXML_SNPRINTF(buffer, bufferSize, "%llu", (long long)v);
 }
 
+// Reads [space][sign](digits | 0x hexdigits) into a sign and magnitude. Like
+// sscanf, trailing text after the number is ignored. Returns false if there
+// are no digits or the magnitude doesn't fit in 64 bits.
+static bool ParseInteger( const char* p, bool* negative, bool* hex, uint64_t* magnitude )
+{
+    while ( XMLUtil::IsWhiteSpace( *p ) ) {
+        ++p;
+    }
+    *negative = ( *p == '-' );
+    if ( *p == '-' || *p == '+' ) {
+        ++p;
+    }
+    *hex = ( p[0] == '0' && ( p[1] == 'x' || p[1] == 'X' ) && isxdigit( static_cast<unsigned char>( p[2] ) ) );
+
+    uint64_t m = 0;
+    const char* const start = p;
+    if ( *hex ) {
+        p += 2;
+        for( ;; ++p ) {
+            unsigned d;
+            if ( *p >= '0' && *p <= '9' ) {
+                d = *p - '0';
+            }
+            else if ( ( *p | 0x20 ) >= 'a' && ( *p | 0x20 ) <= 'f' ) {
+                d = ( *p | 0x20 ) - 'a' + 10;
+            }
+            else {
+                break;
+            }
+            if ( m >> 60 ) {
+                return false;
+            }
+            m = ( m << 4 ) | d;
+        }
+    }
+    else {
+        const uint64_t maxTenth = static_cast<uint64_t>( -1 ) / 10;
+        for( ; *p >= '0' && *p <= '9'; ++p ) {
+            const unsigned d = *p - '0';
+            if ( m > maxTenth || ( m == maxTenth && d > static_cast<uint64_t>( -1 ) % 10 ) ) {
+                return false;
+            }
+            m = m * 10 + d;
+        }
+    }
+    *magnitude = m;
+    return p != start;
+}
+
+
+// Signed conversions: decimal must fit the signed range, hex may use every bit (0xffffffff is -1)
+static bool ToSigned( const char* str, uint64_t maxPositive, uint64_t allBits, uint64_t* bits )
+{
+    bool negative, hex;
+    uint64_t m;
+    if ( !ParseInteger( str, &negative, &hex, &m ) || m > ( hex ? allBits : maxPositive + negative ) ) {
+        return false;
+    }
+    *bits = negative ? 0 - m : m;
+    return true;
+}
+
+
+static bool ToUnsignedBits( const char* str, uint64_t maxValue, uint64_t* value )
+{
+    bool negative, hex;
+    uint64_t m;
+    if ( !ParseInteger( str, &negative, &hex, &m ) || m > maxValue || ( negative && m ) ) {
+        return false;
+    }
+    *value = m;
+    return true;
+}
+
+
 bool XMLUtil::ToInt( const char* str, int* value )
 {
-    if ( TIXML_SSCANF( str, "%d", value ) == 1 ) {
+    uint64_t bits;
+    if ( ToSigned( str, INT_MAX, UINT_MAX, &bits ) ) {
+        *value = static_cast<int>( static_cast<unsigned>( bits ) );
         return true;
     }
     return false;
@@ -605,7 +1068,9 @@ bool XMLUtil::ToInt( const char* str, int* value )
 
 bool XMLUtil::ToUnsigned( const char* str, unsigned *value )
 {
-    if ( TIXML_SSCANF( str, "%u", value ) == 1 ) {
+    uint64_t v;
+    if ( ToUnsignedBits( str, UINT_MAX, &v ) ) {
+        *value = static_cast<unsigned>( v );
         return true;
     }
     return false;
@@ -637,8 +1102,94 @@ bool XMLUtil::ToBool( const char* str, bool* value )
 }
 
 
+// Powers of ten that are exact in a float and a double
+static const float exactFloatPow10[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+static const double exactDoublePow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+// Reads [space][sign]digits[.digits][e[sign]digits] as mantissa * 10^exponent.
+// Returns false for anything it can't represent exactly that way (no digits,
+// more than 19 significant digits, inf, nan, hex floats, or a number running
+// into letters), which is left to sscanf.
+static bool ParseDecimal( const char* p, bool* negative, uint64_t* mantissa, int* exponent )
+{
+    while ( XMLUtil::IsWhiteSpace( *p ) ) {
+        ++p;
+    }
+    *negative = ( *p == '-' );
+    if ( *p == '-' || *p == '+' ) {
+        ++p;
+    }
+
+    uint64_t m = 0;
+    int digits = 0;
+    int e = 0;
+    const char* const start = p;
+    for( ; *p >= '0' && *p <= '9'; ++p ) {
+        if ( m || *p != '0' ) {
+            m = m * 10 + ( *p - '0' );
+            ++digits;
+        }
+    }
+    if ( *p == '.' ) {
+        for( ++p; *p >= '0' && *p <= '9'; ++p ) {
+            if ( m || *p != '0' ) {
+                m = m * 10 + ( *p - '0' );
+                ++digits;
+            }
+            --e;
+        }
+    }
+    if ( p == start || ( p == start + 1 && *start == '.' ) || digits > 19 ) {
+        return false;
+    }
+
+    if ( *p == 'e' || *p == 'E' ) {
+        const char* q = p + 1;
+        const bool negativeExp = ( *q == '-' );
+        if ( *q == '-' || *q == '+' ) {
+            ++q;
+        }
+        if ( *q < '0' || *q > '9' ) {
+            return false;
+        }
+        int x = 0;
+        for( ; *q >= '0' && *q <= '9'; ++q ) {
+            if ( x < 10000 ) {
+                x = x * 10 + ( *q - '0' );
+            }
+        }
+        e += negativeExp ? -x : x;
+        p = q;
+    }
+    if ( isalnum( static_cast<unsigned char>( *p ) ) || *p == '.' ) {
+        return false;
+    }
+
+    *mantissa = m;
+    *exponent = m ? e : 0;
+    return true;
+}
+
+
 bool XMLUtil::ToFloat( const char* str, float* value )
 {
+    // A mantissa and power of ten that are both exact give a correctly rounded
+    // result from a single multiply or divide; anything else goes to sscanf.
+    bool negative;
+    uint64_t m;
+    int e;
+    if ( ParseDecimal( str, &negative, &m, &e ) && m <= ( 1u << 24 ) && e >= -10 && e <= 10 ) {
+        float f = static_cast<float>( m );
+        f = e < 0 ? f / exactFloatPow10[-e] : f * exactFloatPow10[e];
+        *value = negative ? -f : f;
+        return true;
+    }
     if ( TIXML_SSCANF( str, "%f", value ) == 1 ) {
         return true;
     }
@@ -648,6 +1199,25 @@ bool XMLUtil::ToFloat( const char* str, float* value )
 
 bool XMLUtil::ToDouble( const char* str, double* value )
 {
+    bool negative;
+    uint64_t m;
+    int e;
+    if ( ParseDecimal( str, &negative, &m, &e ) && m <= ( static_cast<uint64_t>( 1 ) << 53 ) && e >= -22 && e <= 22 ) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+        double d = static_cast<double>( m );
+        d = e < 0 ? d / exactDoublePow10[-e] : d * exactDoublePow10[e];
+        *value = negative ? -d : d;
+        return true;
+#else
+        // x87 rounds to extended precision first, and rounding twice can be off
+        // by one ulp, so only take results that are exact integers.
+        if ( e >= 0 && e <= 15 && m <= ( static_cast<uint64_t>( 1 ) << 53 ) / static_cast<uint64_t>( exactDoublePow10[e] ) ) {
+            const double d = static_cast<double>( m ) * exactDoublePow10[e];
+            *value = negative ? -d : d;
+            return true;
+        }
+#endif
+    }
     if ( TIXML_SSCANF( str, "%lf", value ) == 1 ) {
         return true;
     }
@@ -657,9 +1227,9 @@ bool XMLUtil::ToDouble( const char* str, double* value )
 
 bool XMLUtil::ToInt64(const char* str, int64_t* value)
 {
-	long long v = 0;	// horrible syntax trick to make the compiler happy about %lld
-	if (TIXML_SSCANF(str, "%lld", &v) == 1) {
-		*value = static_cast<int64_t>(v);
+	uint64_t bits;
+	if ( ToSigned( str, static_cast<uint64_t>( -1 ) >> 1, static_cast<uint64_t>( -1 ), &bits ) ) {
+		*value = static_cast<int64_t>( bits );
 		return true;
 	}
 	return false;
@@ -667,12 +1237,7 @@ bool XMLUtil::ToInt64(const char* str, int64_t* value)
 
 
 bool XMLUtil::ToUnsigned64(const char* str, uint64_t* value) {
-    unsigned long long v = 0;	// horrible syntax trick to make the compiler happy about %llu
-    if(TIXML_SSCANF(str, "%llu", &v) == 1) {
-        *value = (uint64_t)v;
-        return true;
-    }
-    return false;
+    return ToUnsignedBits( str, static_cast<uint64_t>( -1 ), value );
 }
 
 
@@ -797,7 +1362,7 @@ void XMLNode::SetValue( const char* str, bool staticMem )
         _value.SetInternedStr( str );
     }
     else {
-        _value.SetStr( str );
+        _value.SetStr( str, 0, _document->Arena() );
     }
 }
 
@@ -1376,13 +1941,17 @@ const char* XMLAttribute::Value() const
     return _value.GetStr();
 }
 
-char* XMLAttribute::ParseDeep( char* p, bool processEntities, int* curLineNumPtr )
+char* XMLAttribute::ParseDeep( char* p, bool processEntities, bool unquotedValues, XMLAtomTable* atoms, int* curLineNumPtr )
 {
     // Parse using the name rules: bug fix, was using ParseText before
+    char* const name = p;
     p = _name.ParseName( p );
     if ( !p || !*p ) {
         return 0;
     }
+    if ( atoms ) {
+        _atom = atoms->Intern( name, p - name );
+    }
 
     // Skip white space before =
     p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
@@ -1393,10 +1962,23 @@ char* XMLAttribute::ParseDeep( char* p, bool processEntities, int* curLineNumPtr
     ++p;	// move up to opening quote
     p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
     if ( *p != '\"' && *p != '\'' ) {
-        return 0;
-    }
-
-    const char endTag[2] = { *p, 0 };
+        if ( !unquotedValues ) {
+            return 0;
+        }
+        // The value runs up to white space or the end of the tag. Its
+        // terminator is only written lazily, after the tag is parsed.
+        char* start = p;
+        while ( *p && !XMLUtil::IsWhiteSpace( *p ) && *p != '>' && !( *p == '/' && *(p+1) == '>' ) ) {
+            ++p;
+        }
+        if ( p == start ) {
+            return 0;
+        }
+        _value.Set( start, p, processEntities ? StrPair::ATTRIBUTE_VALUE : StrPair::ATTRIBUTE_VALUE_LEAVE_ENTITIES );
+        return p;
+    }
+
+    const char endTag[2] = { *p, 0 };
     ++p;	// move past opening quote
 
     p = _value.ParseText( p, endTag, processEntities ? StrPair::ATTRIBUTE_VALUE : StrPair::ATTRIBUTE_VALUE_LEAVE_ENTITIES, curLineNumPtr );
@@ -1406,7 +1988,7 @@ char* XMLAttribute::ParseDeep( char* p, bool processEntities, int* curLineNumPtr
 
 void XMLAttribute::SetName( const char* n )
 {
-    _name.SetStr( n );
+    _name.SetStr( n, 0, Arena() );
 }
 
 
@@ -1475,7 +2057,7 @@ XMLError XMLAttribute::QueryDoubleValue( double* value ) const
 
 void XMLAttribute::SetAttribute( const char* v )
 {
-    _value.SetStr( v );
+    _value.SetStr( v, 0, Arena() );
 }
 
 
@@ -1483,7 +2065,7 @@ void XMLAttribute::SetAttribute( int v )
 {
     char buf[BUF_SIZE];
     XMLUtil::ToStr( v, buf, BUF_SIZE );
-    _value.SetStr( buf );
+    _value.SetStr( buf, 0, Arena() );
 }
 
 
@@ -1491,7 +2073,7 @@ void XMLAttribute::SetAttribute( unsigned v )
 {
     char buf[BUF_SIZE];
     XMLUtil::ToStr( v, buf, BUF_SIZE );
-    _value.SetStr( buf );
+    _value.SetStr( buf, 0, Arena() );
 }
 
 
@@ -1499,14 +2081,14 @@ void XMLAttribute::SetAttribute(int64_t v)
 {
 	char buf[BUF_SIZE];
 	XMLUtil::ToStr(v, buf, BUF_SIZE);
-	_value.SetStr(buf);
+	_value.SetStr(buf, 0, Arena());
 }
 
 void XMLAttribute::SetAttribute(uint64_t v)
 {
     char buf[BUF_SIZE];
     XMLUtil::ToStr(v, buf, BUF_SIZE);
-    _value.SetStr(buf);
+    _value.SetStr(buf, 0, Arena());
 }
 
 
@@ -1514,32 +2096,40 @@ void XMLAttribute::SetAttribute( bool v )
 {
     char buf[BUF_SIZE];
     XMLUtil::ToStr( v, buf, BUF_SIZE );
-    _value.SetStr( buf );
+    _value.SetStr( buf, 0, Arena() );
 }
 
 void XMLAttribute::SetAttribute( double v )
 {
     char buf[BUF_SIZE];
     XMLUtil::ToStr( v, buf, BUF_SIZE );
-    _value.SetStr( buf );
+    _value.SetStr( buf, 0, Arena() );
 }
 
 void XMLAttribute::SetAttribute( float v )
 {
     char buf[BUF_SIZE];
     XMLUtil::ToStr( v, buf, BUF_SIZE );
-    _value.SetStr( buf );
+    _value.SetStr( buf, 0, Arena() );
 }
 
 
 // --------- XMLElement ---------- //
 XMLElement::XMLElement( XMLDocument* doc ) : XMLNode( doc ),
     _closingType( OPEN ),
-    _rootAttribute( 0 )
+    _rootAttribute( 0 ),
+    _atom( 0 )
 {
 }
 
 
+void XMLElement::SetName( const char* str, bool staticMem )
+{
+    SetValue( str, staticMem );
+    _atom = _document->AtomTable() ? _document->AtomTable()->Intern( str ) : 0;
+}
+
+
 XMLElement::~XMLElement()
 {
     while( _rootAttribute ) {
@@ -1561,6 +2151,18 @@ const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
 }
 
 
+const XMLAttribute* XMLElement::FindAttribute( XMLAtom atom ) const
+{
+    TIXMLASSERT( _document->AtomTable() );
+    for( XMLAttribute* a = _rootAttribute; a; a = a->_next ) {
+        if ( a->_atom == atom ) {
+            return a;
+        }
+    }
+    return 0;
+}
+
+
 const char* XMLElement::Attribute( const char* name, const char* value ) const
 {
     const XMLAttribute* a = FindAttribute( name );
@@ -1859,6 +2461,9 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
             _rootAttribute = attrib;
         }
         attrib->SetName( name );
+        if ( _document->AtomTable() ) {
+            attrib->_atom = _document->AtomTable()->Intern( name );
+        }
     }
     return attrib;
 }
@@ -1903,8 +2508,9 @@ char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
 
             const int attrLineNum = attrib->_parseLineNum;
 
-            p = attrib->ParseDeep( p, _document->ProcessEntities(), curLineNumPtr );
-            if ( !p || Attribute( attrib->Name() ) ) {
+            XMLAtomTable* atoms = _document->AtomTable();
+            p = attrib->ParseDeep( p, _document->ProcessEntities(), _document->UnquotedAttributes(), atoms, curLineNumPtr );
+            if ( !p || ( atoms ? FindAttribute( attrib->_atom ) : FindAttribute( attrib->Name() ) ) ) {
                 DeleteAttribute( attrib );
                 _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "XMLElement name=%s", Name() );
                 return 0;
@@ -1979,10 +2585,14 @@ char* XMLElement::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr
         ++p;
     }
 
+    char* const name = p;
     p = _value.ParseName( p );
     if ( _value.Empty() ) {
         return 0;
     }
+    if ( _document->AtomTable() ) {
+        _atom = _document->AtomTable()->Intern( name, p - name );
+    }
 
     p = ParseAttributes( p, curLineNumPtr );
     if ( !p || !*p || _closingType != OPEN ) {
@@ -2078,11 +2688,16 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
     XMLNode( 0 ),
     _writeBOM( false ),
     _processEntities( processEntities ),
+    _unquotedAttributes( false ),
     _errorID(XML_SUCCESS),
     _whitespaceMode( whitespaceMode ),
     _errorStr(),
     _errorLineNum( 0 ),
     _charBuffer( 0 ),
+    _borrowedBuffer( false ),
+    _releaseBuffer( 0 ),
+    _arena( 0 ),
+    _atoms( 0 ),
     _parseCurLineNum( 0 ),
 	_parsingDepth(0),
     _unlinked(),
@@ -2102,6 +2717,32 @@ XMLDocument::~XMLDocument()
 }
 
 
+void XMLDocument::SetArena( XMLArena* arena )
+{
+    Clear();
+    _arena = arena;
+    _elementPool.SetArena( arena );
+    _attributePool.SetArena( arena );
+    _textPool.SetArena( arena );
+    _commentPool.SetArena( arena );
+}
+
+
+// Takes the parse buffer from the arena, if there is one
+char* XMLDocument::NewCharBuffer( size_t size )
+{
+    TIXMLASSERT( _charBuffer == 0 );
+    if ( _arena ) {
+        _charBuffer = static_cast<char*>( _arena->Alloc( size ) );
+        _borrowedBuffer = true;
+    }
+    else {
+        _charBuffer = new char[size];
+    }
+    return _charBuffer;
+}
+
+
 void XMLDocument::MarkInUse(XMLNode* node)
 {
 	TIXMLASSERT(node);
@@ -2117,18 +2758,34 @@ void XMLDocument::MarkInUse(XMLNode* node)
 
 void XMLDocument::Clear()
 {
-    DeleteChildren();
-	while( _unlinked.Size()) {
-		DeleteNode(_unlinked[0]);	// Will remove from _unlinked as part of delete.
-	}
+    if ( _arena ) {
+        // Arena nodes own nothing that needs destructing, so they are
+        // simply forgotten; resetting the arena below reclaims them.
+        _firstChild = 0;
+        _lastChild = 0;
+        _unlinked.Clear();
+    }
+    else {
+        DeleteChildren();
+        while( _unlinked.Size()) {
+            DeleteNode(_unlinked[0]);	// Will remove from _unlinked as part of delete.
+        }
+    }
 
 #ifdef TINYXML2_DEBUG
     const bool hadError = Error();
 #endif
     ClearError();
 
-    delete [] _charBuffer;
+    if ( !_borrowedBuffer ) {
+        delete [] _charBuffer;
+    }
+    else if ( _releaseBuffer && _charBuffer ) {
+        _releaseBuffer( _charBuffer );
+    }
     _charBuffer = 0;
+    _borrowedBuffer = false;
+    _releaseBuffer = 0;
 	_parsingDepth = 0;
 
 #if 0
@@ -2138,8 +2795,12 @@ void XMLDocument::Clear()
     _attributePool.Trace( "attribute" );
 #endif
 
+    if ( _arena ) {
+        _arena->Reset();
+    }
+
 #ifdef TINYXML2_DEBUG
-    if ( !hadError ) {
+    if ( !hadError && !_arena ) {
         TIXMLASSERT( _elementPool.CurrentAllocs()   == _elementPool.Untracked() );
         TIXMLASSERT( _attributePool.CurrentAllocs() == _attributePool.Untracked() );
         TIXMLASSERT( _textPool.CurrentAllocs()      == _textPool.Untracked() );
@@ -2308,8 +2969,7 @@ XMLError XMLDocument::LoadFile( FILE* fp )
     }
 
     const size_t size = filelength;
-    TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[size+1];
+    NewCharBuffer( size+1 );
     const size_t read = fread( _charBuffer, 1, size, fp );
     if ( read != size ) {
         SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
@@ -2364,8 +3024,7 @@ XMLError XMLDocument::Parse( const char* p, size_t len )
     if ( len == static_cast<size_t>(-1) ) {
         len = strlen( p );
     }
-    TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[ len+1 ];
+    NewCharBuffer( len+1 );
     memcpy( _charBuffer, p, len );
     _charBuffer[len] = 0;
 
@@ -2384,6 +3043,37 @@ XMLError XMLDocument::Parse( const char* p, size_t len )
 }
 
 
+XMLError XMLDocument::ParseInSitu( char* p, size_t len, void (*release)( void* ) )
+{
+    Clear();
+
+    // Adopt the buffer first, so it is released even if it is rejected.
+    _charBuffer = p;
+    _borrowedBuffer = true;
+    _releaseBuffer = release;
+
+    if ( len == 0 || !p || !*p ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+    if ( len == static_cast<size_t>(-1) ) {
+        len = strlen( p );
+    }
+    _charBuffer[len] = 0;
+
+    Parse();
+    if ( Error() ) {
+        // Same cleanup as Parse(); the buffer itself stays until Clear().
+        DeleteChildren();
+        _elementPool.Clear();
+        _attributePool.Clear();
+        _textPool.Clear();
+        _commentPool.Clear();
+    }
+    return _errorID;
+}
+
+
 void XMLDocument::Print( XMLPrinter* streamer ) const
 {
     if ( streamer ) {
@@ -2478,34 +3168,911 @@ void XMLDocument::PopDepth()
 	--_parsingDepth;
 }
 
+// --------- XMLStreamReader ----------- //
+
+XMLStreamReader::XMLStreamReader( XMLInputStream* input, bool processEntities, Whitespace whitespaceMode, int bufferSize ) :
+    _input( input ),
+    _processEntities( processEntities ),
+    _unquotedAttributes( false ),
+    _whitespaceMode( whitespaceMode ),
+    _buffer( 0 ),
+    _capacity( bufferSize > 16 ? bufferSize : 16 ),
+    _size( 0 ),
+    _pos( 0 ),
+    _started( false ),
+    _eof( false ),
+    _restoreLT( false ),
+    _pendingEnd( false ),
+    _sawMarkup( false ),
+    _event( START_ELEMENT ),
+    _name( "" ),
+    _text( "" ),
+    _lineNum( 1 ),
+    _eventLineNum( 0 ),
+    _errorID( XML_SUCCESS ),
+    _errorLineNum( 0 ),
+    _attributes(),
+    _ranges(),
+    _names(),
+    _nameStarts()
+{
+    TIXMLASSERT( input );
+    _buffer = new char[_capacity + 1];
+    _buffer[0] = 0;
+}
+
+
+XMLStreamReader::~XMLStreamReader()
+{
+    delete [] _buffer;
+}
+
+
+const char* XMLStreamReader::ErrorName() const
+{
+    return XMLDocument::ErrorIDToName( _errorID );
+}
+
+
+XMLStreamReader::Event XMLStreamReader::Fail( XMLError error )
+{
+    _errorID = error;
+    _errorLineNum = _lineNum;
+    _event = FAILED;
+    return _event;
+}
+
+
+// Moves the unread bytes to the front of the window and appends more input.
+// Returns false at the end of the input (or on a read error).
+bool XMLStreamReader::Fill()
+{
+    if ( _eof ) {
+        return false;
+    }
+    if ( _pos > 0 ) {
+        memmove( _buffer, _buffer + _pos, _size - _pos );
+        _size -= _pos;
+        _pos = 0;
+        _buffer[_size] = 0;
+    }
+    if ( _size == _capacity ) {
+        // One token fills the whole window; make room for the rest of it.
+        TIXMLASSERT( _capacity <= INT_MAX / 2 );
+        char* buffer = new char[_capacity * 2 + 1];
+        memcpy( buffer, _buffer, _size );
+        delete [] _buffer;
+        _buffer = buffer;
+        _capacity *= 2;
+    }
+
+    const int read = _input->Read( _buffer + _size, _capacity - _size );
+    if ( read <= 0 ) {
+        if ( read < 0 ) {
+            Fail( XML_ERROR_FILE_READ_ERROR );
+        }
+        _eof = true;
+        return false;
+    }
+    _size += read;
+    _buffer[_size] = 0;
+    return true;
+}
+
+
+// Returns the offset from _pos of 'terminator', searching from 'offset'
+// and reading more input as needed, or -1 if the input ends first.
+int XMLStreamReader::Find( int offset, const char* terminator )
+{
+    const int length = static_cast<int>( strlen( terminator ) );
+    for( ;; ) {
+        const char* found = strstr( _buffer + _pos + offset, terminator );
+        if ( found ) {
+            return static_cast<int>( found - ( _buffer + _pos ) );
+        }
+        // The terminator may straddle the end of the window
+        const int scanned = _size - _pos - length + 1;
+        offset = scanned > offset ? scanned : offset;
+        if ( !Fill() ) {
+            return -1;
+        }
+    }
+}
+
+
+// Like Find( 1, ">" ), but ignores '>' inside quoted attribute values.
+int XMLStreamReader::FindTagEnd()
+{
+    int i = 1;
+    char quote = 0;
+    for( ;; ) {
+        for( ; _pos + i < _size; ++i ) {
+            const char c = _buffer[_pos + i];
+            if ( quote ) {
+                if ( c == quote ) {
+                    quote = 0;
+                }
+            }
+            else if ( c == '"' || c == '\'' ) {
+                quote = c;
+            }
+            else if ( c == '>' ) {
+                return i;
+            }
+        }
+        if ( !Fill() ) {
+            return -1;
+        }
+    }
+}
+
+
+// Counts the lines of a token and marks it read
+void XMLStreamReader::Consume( int length )
+{
+    const char* p = _buffer + _pos;
+    for( const char* end = p + length; p < end; ++p ) {
+        if ( *p == '\n' ) {
+            ++_lineNum;
+        }
+    }
+    _pos += length;
+}
+
+
+XMLStreamReader::Event XMLStreamReader::ParseStartTag( int end )
+{
+    char* p = _buffer + _pos + 1;
+    char* const tagEnd = _buffer + _pos + end;
+    int scratchLine = 0;
+    StrPair pair;
+
+    char* const nameStart = p;
+    p = pair.ParseName( p );
+    if ( !p || p > tagEnd ) {
+        return Fail( XML_ERROR_PARSING_ELEMENT );
+    }
+    char* const nameEnd = p;
+
+    bool empty = false;
+    _ranges.Clear();
+    for( ;; ) {
+        p = XMLUtil::SkipWhiteSpace( p, &scratchLine );
+        if ( p == tagEnd ) {
+            break;
+        }
+        if ( *p == '/' && p + 1 == tagEnd ) {
+            empty = true;
+            break;
+        }
+
+        char* const attrName = p;
+        p = pair.ParseName( p );
+        if ( !p || p >= tagEnd ) {
+            return Fail( XML_ERROR_PARSING_ATTRIBUTE );
+        }
+        char* const attrNameEnd = p;
+        p = XMLUtil::SkipWhiteSpace( p, &scratchLine );
+        if ( *p != '=' ) {
+            return Fail( XML_ERROR_PARSING_ATTRIBUTE );
+        }
+        p = XMLUtil::SkipWhiteSpace( p + 1, &scratchLine );
+
+        char* value = p;
+        if ( *p == '\"' || *p == '\'' ) {
+            const char endTag[2] = { *p, 0 };
+            ++value;
+            p = pair.ParseText( value, endTag, 0, &scratchLine );
+            if ( !p || p > tagEnd ) {
+                return Fail( XML_ERROR_PARSING_ATTRIBUTE );
+            }
+            --p;
+        }
+        else if ( _unquotedAttributes ) {
+            while ( p < tagEnd && !XMLUtil::IsWhiteSpace( *p ) && !( *p == '/' && p + 1 == tagEnd ) ) {
+                ++p;
+            }
+            if ( p == value ) {
+                return Fail( XML_ERROR_PARSING_ATTRIBUTE );
+            }
+        }
+        else {
+            return Fail( XML_ERROR_PARSING_ATTRIBUTE );
+        }
+
+        _ranges.Push( attrName );
+        _ranges.Push( attrNameEnd );
+        _ranges.Push( value );
+        _ranges.Push( p );
+        if ( *p == '\"' || *p == '\'' ) {
+            ++p;
+        }
+    }
+
+    if ( _nameStarts.Size() >= TINYXML2_MAX_ELEMENT_DEPTH ) {
+        return Fail( XML_ELEMENT_DEPTH_EXCEEDED );
+    }
+    _eventLineNum = _lineNum;
+    Consume( end + 1 );
+
+    // Everything is scanned, so the strings can now be terminated in place
+    const int valueFlags = _processEntities ? StrPair::ATTRIBUTE_VALUE : StrPair::ATTRIBUTE_VALUE_LEAVE_ENTITIES;
+    _attributes.Clear();
+    for( int i = 0; i < _ranges.Size(); i += 4 ) {
+        pair.Set( _ranges[i], _ranges[i + 1], StrPair::ATTRIBUTE_NAME );
+        _attributes.Push( pair.GetStr() );
+        pair.Set( _ranges[i + 2], _ranges[i + 3], valueFlags );
+        _attributes.Push( pair.GetStr() );
+    }
+
+    const int nameLength = static_cast<int>( nameEnd - nameStart );
+    _nameStarts.Push( _names.Size() );
+    char* name = _names.PushArr( nameLength + 1 );
+    memcpy( name, nameStart, nameLength );
+    name[nameLength] = 0;
+
+    _name = name;
+    _pendingEnd = empty;
+    _event = START_ELEMENT;
+    return _event;
+}
+
+
+XMLStreamReader::Event XMLStreamReader::ParseEndTag( int end )
+{
+    char* p = _buffer + _pos + 2;
+    int scratchLine = 0;
+    StrPair pair;
+
+    char* const nameStart = p;
+    p = pair.ParseName( p );
+    if ( !p ) {
+        return Fail( XML_ERROR_PARSING_ELEMENT );
+    }
+    const int nameLength = static_cast<int>( p - nameStart );
+    p = XMLUtil::SkipWhiteSpace( p, &scratchLine );
+    if ( p != _buffer + _pos + end ) {
+        return Fail( XML_ERROR_PARSING_ELEMENT );
+    }
+
+    if ( _nameStarts.Empty() ) {
+        return Fail( XML_ERROR_MISMATCHED_ELEMENT );
+    }
+    const char* open = &_names[_nameStarts.PeekTop()];
+    if ( !XMLUtil::StringEqual( open, nameStart, nameLength ) || open[nameLength] ) {
+        return Fail( XML_ERROR_MISMATCHED_ELEMENT );
+    }
+
+    _eventLineNum = _lineNum;
+    Consume( end + 1 );
+    // Popping leaves the name's bytes in place until the next push
+    _names.PopArr( _names.Size() - _nameStarts.Pop() );
+    _name = open;
+    _attributes.Clear();
+    _event = END_ELEMENT;
+    return _event;
+}
+
+
+XMLStreamReader::Event XMLStreamReader::Next()
+{
+    if ( _event == FAILED || _event == END_DOCUMENT ) {
+        return _event;
+    }
+    if ( _restoreLT ) {
+        _buffer[_pos] = '<';
+        _restoreLT = false;
+    }
+    if ( _pendingEnd ) {
+        _pendingEnd = false;
+        _name = &_names[_nameStarts.PeekTop()];
+        _names.PopArr( _names.Size() - _nameStarts.Pop() );
+        _attributes.Clear();
+        _event = END_ELEMENT;
+        return _event;
+    }
+
+    if ( !_started ) {
+        _started = true;
+        while ( _size < 3 && Fill() ) {
+        }
+        bool hasBOM = false;
+        _pos = static_cast<int>( XMLUtil::ReadBOM( _buffer, &hasBOM ) - _buffer );
+    }
+
+    for( ;; ) {
+        if ( _pos == _size && !Fill() ) {
+            if ( _errorID != XML_SUCCESS ) {
+                return _event;
+            }
+            if ( !_nameStarts.Empty() ) {
+                return Fail( XML_ERROR_PARSING );
+            }
+            if ( !_sawMarkup ) {
+                return Fail( XML_ERROR_EMPTY_DOCUMENT );
+            }
+            _event = END_DOCUMENT;
+            return _event;
+        }
+
+        if ( _buffer[_pos] != '<' ) {
+            int end = Find( 0, "<" );
+            if ( end < 0 ) {
+                if ( _errorID != XML_SUCCESS ) {
+                    return _event;
+                }
+                end = _size - _pos;
+            }
+
+            char* const start = _buffer + _pos;
+            bool whitespace = true;
+            for( int i = 0; i < end && whitespace; ++i ) {
+                whitespace = XMLUtil::IsWhiteSpace( start[i] );
+            }
+            if ( whitespace ) {
+                Consume( end );
+                continue;
+            }
+
+            int flags = _processEntities ? StrPair::TEXT_ELEMENT : StrPair::TEXT_ELEMENT_LEAVE_ENTITIES;
+            if ( _whitespaceMode == COLLAPSE_WHITESPACE ) {
+                flags |= StrPair::NEEDS_WHITESPACE_COLLAPSING;
+            }
+            _eventLineNum = _lineNum;
+            Consume( end );
+            _restoreLT = _pos < _size;
+
+            StrPair pair;
+            pair.Set( start, start + end, flags );
+            _text = pair.GetStr();
+            _event = CHARACTERS;
+            return _event;
+        }
+
+        // The longest prefix that decides the kind of markup is "<![CDATA["
+        while ( _size - _pos < 9 && Fill() ) {
+        }
+        const char* const p = _buffer + _pos;
+        int end = 0;
+        _sawMarkup = true;
+
+        if ( XMLUtil::StringEqual( p, "<?", 2 ) ) {
+            end = Find( 2, "?>" );
+            if ( end < 0 ) {
+                return _errorID != XML_SUCCESS ? _event : Fail( XML_ERROR_PARSING_DECLARATION );
+            }
+            Consume( end + 2 );
+        }
+        else if ( XMLUtil::StringEqual( p, "<!--", 4 ) ) {
+            end = Find( 4, "-->" );
+            if ( end < 0 ) {
+                return _errorID != XML_SUCCESS ? _event : Fail( XML_ERROR_PARSING_COMMENT );
+            }
+            Consume( end + 3 );
+        }
+        else if ( XMLUtil::StringEqual( p, "<![CDATA[", 9 ) ) {
+            end = Find( 9, "]]>" );
+            if ( end < 0 ) {
+                return _errorID != XML_SUCCESS ? _event : Fail( XML_ERROR_PARSING_CDATA );
+            }
+            char* const start = _buffer + _pos + 9;
+            _eventLineNum = _lineNum;
+            Consume( end + 3 );
+
+            StrPair pair;
+            pair.Set( start, _buffer + _pos - 3, StrPair::NEEDS_NEWLINE_NORMALIZATION );
+            _text = pair.GetStr();
+            _event = CHARACTERS;
+            return _event;
+        }
+        else if ( XMLUtil::StringEqual( p, "<!", 2 ) ) {
+            // Skipped like XMLUnknown, e.g. <!DOCTYPE>
+            end = Find( 2, ">" );
+            if ( end < 0 ) {
+                return _errorID != XML_SUCCESS ? _event : Fail( XML_ERROR_PARSING_UNKNOWN );
+            }
+            Consume( end + 1 );
+        }
+        else if ( p[1] == '/' ) {
+            end = Find( 2, ">" );
+            if ( end < 0 ) {
+                return _errorID != XML_SUCCESS ? _event : Fail( XML_ERROR_PARSING_ELEMENT );
+            }
+            return ParseEndTag( end );
+        }
+        else {
+            end = FindTagEnd();
+            if ( end < 0 ) {
+                return _errorID != XML_SUCCESS ? _event : Fail( XML_ERROR_PARSING_ELEMENT );
+            }
+            return ParseStartTag( end );
+        }
+    }
+}
+
+
+XMLStreamReader::Event XMLStreamReader::SkipElement()
+{
+    TIXMLASSERT( _event == START_ELEMENT );
+    const int depth = Depth();
+    Event event = _event;
+    do {
+        event = Next();
+    } while ( ( event != END_ELEMENT || Depth() >= depth ) && event != FAILED && event != END_DOCUMENT );
+    return event;
+}
+
+
+const char* XMLStreamReader::Attribute( const char* name, const char* value ) const
+{
+    for( int i = 0; i < _attributes.Size(); i += 2 ) {
+        if ( XMLUtil::StringEqual( _attributes[i], name ) ) {
+            if ( !value || XMLUtil::StringEqual( _attributes[i + 1], value ) ) {
+                return _attributes[i + 1];
+            }
+            return 0;
+        }
+    }
+    return 0;
+}
+
+
+XMLError XMLStreamReader::QueryIntAttribute( const char* name, int* value ) const
+{
+    const char* str = Attribute( name );
+    if ( !str ) {
+        return XML_NO_ATTRIBUTE;
+    }
+    return XMLUtil::ToInt( str, value ) ? XML_SUCCESS : XML_WRONG_ATTRIBUTE_TYPE;
+}
+
+
+XMLError XMLStreamReader::QueryUnsignedAttribute( const char* name, unsigned* value ) const
+{
+    const char* str = Attribute( name );
+    if ( !str ) {
+        return XML_NO_ATTRIBUTE;
+    }
+    return XMLUtil::ToUnsigned( str, value ) ? XML_SUCCESS : XML_WRONG_ATTRIBUTE_TYPE;
+}
+
+
+XMLError XMLStreamReader::QueryBoolAttribute( const char* name, bool* value ) const
+{
+    const char* str = Attribute( name );
+    if ( !str ) {
+        return XML_NO_ATTRIBUTE;
+    }
+    return XMLUtil::ToBool( str, value ) ? XML_SUCCESS : XML_WRONG_ATTRIBUTE_TYPE;
+}
+
+
+XMLError XMLStreamReader::QueryFloatAttribute( const char* name, float* value ) const
+{
+    const char* str = Attribute( name );
+    if ( !str ) {
+        return XML_NO_ATTRIBUTE;
+    }
+    return XMLUtil::ToFloat( str, value ) ? XML_SUCCESS : XML_WRONG_ATTRIBUTE_TYPE;
+}
+
+
+XMLError XMLStreamReader::QueryDoubleAttribute( const char* name, double* value ) const
+{
+    const char* str = Attribute( name );
+    if ( !str ) {
+        return XML_NO_ATTRIBUTE;
+    }
+    return XMLUtil::ToDouble( str, value ) ? XML_SUCCESS : XML_WRONG_ATTRIBUTE_TYPE;
+}
+
+
+// --------- XMLPath ----------- //
+
+XMLPath::XMLPath() :
+    _buffer( 0 ),
+    _nSteps( 0 ),
+    _select( 0 ),
+    _selectAtom( 0 ),
+    _atoms( 0 )
+{
+}
+
+
+XMLPath::XMLPath( const char* path, XMLAtomTable* atoms ) :
+    _buffer( 0 ),
+    _nSteps( 0 ),
+    _select( 0 ),
+    _selectAtom( 0 ),
+    _atoms( 0 )
+{
+    Compile( path, atoms );
+}
+
+
+XMLPath::~XMLPath()
+{
+    delete [] _buffer;
+}
+
+
+void XMLPath::Reset()
+{
+    delete [] _buffer;
+    _buffer = 0;
+    _nSteps = 0;
+    _select = 0;
+    _selectAtom = 0;
+    _atoms = 0;
+}
+
+
+static char* ScanPathName( char* p )
+{
+    while ( *p && !strchr( "/[]@='\"", *p ) ) {
+        ++p;
+    }
+    return p;
+}
+
+
+bool XMLPath::Compile( const char* path, XMLAtomTable* atoms )
+{
+    TIXMLASSERT( path );
+    Reset();
+    const size_t length = strlen( path );
+    _buffer = new char[length + 1];
+    memcpy( _buffer, path, length + 1 );
+
+    if ( !Parse() ) {
+        Reset();
+        return false;
+    }
+
+    _atoms = atoms;
+    if ( atoms ) {
+        for( int i = 0; i < _nSteps; ++i ) {
+            Step& step = _steps[i];
+            step.nameAtom = step.name ? atoms->Intern( step.name ) : 0;
+            step.attrAtom = step.attr ? atoms->Intern( step.attr ) : 0;
+        }
+        _selectAtom = _select ? atoms->Intern( _select ) : 0;
+    }
+    return true;
+}
+
+
+// Splits _buffer into steps, terminating each name in place
+bool XMLPath::Parse()
+{
+    char* p = _buffer;
+    for( ;; ) {
+        if ( _nSteps == MAX_STEPS ) {
+            return false;
+        }
+        Step& step = _steps[_nSteps++];
+        step.name = p;
+        step.attr = 0;
+        step.value = 0;
+        step.nameAtom = 0;
+        step.attrAtom = 0;
+
+        p = ScanPathName( p );
+        if ( p == step.name ) {
+            return false;
+        }
+        char sep = *p;
+        *p = 0;
+        if ( XMLUtil::StringEqual( step.name, "*" ) ) {
+            step.name = 0;
+        }
+
+        if ( sep == '[' ) {
+            if ( *++p != '@' ) {
+                return false;
+            }
+            step.attr = ++p;
+            p = ScanPathName( p );
+            if ( p == step.attr ) {
+                return false;
+            }
+            sep = *p;
+            *p = 0;
+
+            if ( sep == '=' ) {
+                ++p;
+                if ( *p == '\'' || *p == '"' ) {
+                    const char quote = *p++;
+                    step.value = p;
+                    p = strchr( p, quote );
+                    if ( !p ) {
+                        return false;
+                    }
+                    *p++ = 0;
+                }
+                else {
+                    step.value = p;
+                    p = ScanPathName( p );
+                }
+                sep = *p;
+                *p = 0;
+            }
+            if ( sep != ']' ) {
+                return false;
+            }
+            sep = *++p;
+        }
+
+        if ( sep == '/' ) {
+            ++p;
+        }
+        else if ( sep == '@' ) {
+            _select = ++p;
+            p = ScanPathName( p );
+            return p != _select && !*p;
+        }
+        else {
+            return !sep;
+        }
+    }
+}
+
+
+bool XMLPath::Matches( const XMLElement* element, const Step& step, bool byAtom ) const
+{
+    if ( step.name ) {
+        if ( byAtom ? element->Atom() != step.nameAtom : !XMLUtil::StringEqual( element->Name(), step.name ) ) {
+            return false;
+        }
+    }
+    if ( step.attr ) {
+        const XMLAttribute* a = byAtom ? element->FindAttribute( step.attrAtom ) : element->FindAttribute( step.attr );
+        if ( !a || ( step.value && !XMLUtil::StringEqual( a->Value(), step.value ) ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+const XMLElement* XMLPath::NextMatch( const XMLElement* element, int step, bool byAtom ) const
+{
+    while ( element && !Matches( element, _steps[step], byAtom ) ) {
+        element = element->NextSiblingElement();
+    }
+    return element;
+}
+
+
+// The selected attribute's value, or the element's text if no attribute is selected
+const char* XMLPath::Selected( const XMLElement* element, bool byAtom ) const
+{
+    if ( !_select ) {
+        return element->GetText();
+    }
+    const XMLAttribute* a = byAtom ? element->FindAttribute( _selectAtom ) : element->FindAttribute( _select );
+    return a ? a->Value() : 0;
+}
+
+
+// Depth-first over the matches, with one cursor per step instead of recursion
+template< class Sink >
+int XMLPath::Walk( const XMLNode* from, Sink& sink, int max ) const
+{
+    TIXMLASSERT( from );
+    if ( !_nSteps || !max ) {
+        return 0;
+    }
+    const bool byAtom = _atoms && from->GetDocument()->AtomTable() == _atoms;
+    const XMLElement* at[MAX_STEPS];
+    int depth = 0;
+    int n = 0;
+
+    at[0] = NextMatch( from->FirstChildElement(), 0, byAtom );
+    while ( depth >= 0 ) {
+        const XMLElement* element = at[depth];
+        if ( !element ) {
+            if ( --depth >= 0 ) {
+                at[depth] = NextMatch( at[depth]->NextSiblingElement(), depth, byAtom );
+            }
+            continue;
+        }
+        if ( depth + 1 < _nSteps ) {
+            ++depth;
+            at[depth] = NextMatch( element->FirstChildElement(), depth, byAtom );
+            continue;
+        }
+
+        const char* value = Selected( element, byAtom );
+        if ( ( value || !_select ) && sink.Add( element, value, n ) ) {
+            if ( ++n == max ) {
+                break;
+            }
+        }
+        at[depth] = NextMatch( element->NextSiblingElement(), depth, byAtom );
+    }
+    return n;
+}
+
+
+struct XMLPathElements {
+    const XMLElement** out;
+    bool Add( const XMLElement* element, const char*, int n ) {
+        if ( out ) {
+            out[n] = element;
+        }
+        return true;
+    }
+};
+
+
+struct XMLPathTexts {
+    const char** out;
+    bool Add( const XMLElement*, const char* value, int n ) {
+        if ( !value ) {
+            return false;
+        }
+        out[n] = value;
+        return true;
+    }
+};
+
+
+template< class T, bool ( *Convert )( const char*, T* ) >
+struct XMLPathValues {
+    T* out;
+    bool Add( const XMLElement*, const char* value, int n ) {
+        return value && Convert( value, &out[n] );
+    }
+};
+
+
+const XMLElement* XMLPath::First( const XMLNode* from ) const
+{
+    const XMLElement* element = 0;
+    XMLPathElements sink = { &element };
+    Walk( from, sink, 1 );
+    return element;
+}
+
+
+int XMLPath::Count( const XMLNode* from ) const
+{
+    XMLPathElements sink = { 0 };
+    return Walk( from, sink, -1 );
+}
+
+
+int XMLPath::Select( const XMLNode* from, const XMLElement** out, int max ) const
+{
+    TIXMLASSERT( out || !max );
+    XMLPathElements sink = { out };
+    return Walk( from, sink, max );
+}
+
+
+int XMLPath::QueryTexts( const XMLNode* from, const char** out, int max ) const
+{
+    TIXMLASSERT( out || !max );
+    XMLPathTexts sink = { out };
+    return Walk( from, sink, max );
+}
+
+
+int XMLPath::QueryInts( const XMLNode* from, int* out, int max ) const
+{
+    TIXMLASSERT( out || !max );
+    XMLPathValues< int, XMLUtil::ToInt > sink = { out };
+    return Walk( from, sink, max );
+}
+
+
+int XMLPath::QueryUnsigneds( const XMLNode* from, unsigned* out, int max ) const
+{
+    TIXMLASSERT( out || !max );
+    XMLPathValues< unsigned, XMLUtil::ToUnsigned > sink = { out };
+    return Walk( from, sink, max );
+}
+
+
+int XMLPath::QueryFloats( const XMLNode* from, float* out, int max ) const
+{
+    TIXMLASSERT( out || !max );
+    XMLPathValues< float, XMLUtil::ToFloat > sink = { out };
+    return Walk( from, sink, max );
+}
+
+
+int XMLPath::QueryDoubles( const XMLNode* from, double* out, int max ) const
+{
+    TIXMLASSERT( out || !max );
+    XMLPathValues< double, XMLUtil::ToDouble > sink = { out };
+    return Walk( from, sink, max );
+}
+
+
 XMLPrinter::XMLPrinter( FILE* file, bool compact, int depth ) :
     _elementJustOpened( false ),
     _stack(),
     _firstElement( true ),
     _fp( file ),
+    _stream( 0 ),
+    _streamError( false ),
+    _depth( depth ),
+    _textDepth( -1 ),
+    _processEntities( true ),
+    _compactMode( compact ),
+    _buffer(),
+    _chunk( 0 ),
+    _chunkSize( 0 )
+{
+    Init();
+}
+
+
+XMLPrinter::XMLPrinter( XMLOutputStream& stream, bool compact, int depth ) :
+    _elementJustOpened( false ),
+    _stack(),
+    _firstElement( true ),
+    _fp( 0 ),
+    _stream( &stream ),
+    _streamError( false ),
     _depth( depth ),
     _textDepth( -1 ),
     _processEntities( true ),
     _compactMode( compact ),
-    _buffer()
+    _buffer(),
+    _chunk( new char[CHUNK_SIZE] ),
+    _chunkSize( 0 )
+{
+    Init();
+}
+
+
+void XMLPrinter::Init()
 {
     for( int i=0; i<ENTITY_RANGE; ++i ) {
-        _entityFlag[i] = false;
-        _restrictedEntityFlag[i] = false;
+        _entityFlag[i] = 0;
+        _restrictedEntityFlag[i] = 0;
     }
     for( int i=0; i<NUM_ENTITIES; ++i ) {
         const char entityValue = entities[i].value;
         const unsigned char flagIndex = static_cast<unsigned char>(entityValue);
         TIXMLASSERT( flagIndex < ENTITY_RANGE );
-        _entityFlag[flagIndex] = true;
+        _entityFlag[flagIndex] = static_cast<unsigned char>( i + 1 );
+        if ( entityValue == '&' || entityValue == '<' || entityValue == '>' ) {	// '>' not required, but consistency is nice
+            _restrictedEntityFlag[flagIndex] = static_cast<unsigned char>( i + 1 );
+        }
     }
-    _restrictedEntityFlag[static_cast<unsigned char>('&')] = true;
-    _restrictedEntityFlag[static_cast<unsigned char>('<')] = true;
-    _restrictedEntityFlag[static_cast<unsigned char>('>')] = true;	// not required, but consistency is nice
+    _entityFlag[0] = ENTITY_STOP;
+    _restrictedEntityFlag[0] = ENTITY_STOP;
     _buffer.Push( 0 );
 }
 
 
+bool XMLPrinter::Flush()
+{
+    if ( _chunkSize ) {
+        const size_t size = _chunkSize;
+        _chunkSize = 0;
+        WriteToStream( _chunk, size );
+    }
+    return !_streamError;
+}
+
+
+void XMLPrinter::WriteToStream( const char* data, size_t size )
+{
+    TIXMLASSERT( _stream );
+    while ( size && !_streamError ) {
+        const int toWrite = ( INT_MAX < size ) ? INT_MAX : static_cast<int>( size );
+        _streamError = !_stream->Write( data, toWrite );
+        data += toWrite;
+        size -= toWrite;
+    }
+}
+
+
 void XMLPrinter::Print( const char* format, ... )
 {
     va_list     va;
@@ -2514,6 +4081,26 @@ void XMLPrinter::Print( const char* format, ... )
     if ( _fp ) {
         vfprintf( _fp, format, va );
     }
+    else if ( _stream ) {
+        const int len = TIXML_VSCPRINTF( format, va );
+        va_end( va );
+        TIXMLASSERT( len >= 0 );
+        va_start( va, format );
+        if ( _chunkSize + len >= CHUNK_SIZE ) {
+            Flush();
+        }
+        if ( len < CHUNK_SIZE ) {
+            TIXML_VSNPRINTF( _chunk + _chunkSize, len + 1, format, va );
+            _chunkSize += len;
+        }
+        else {
+            // Too big for the chunk; the one case that allocates
+            char* str = new char[len + 1];
+            TIXML_VSNPRINTF( str, len + 1, format, va );
+            WriteToStream( str, len );
+            delete [] str;
+        }
+    }
     else {
         const int len = TIXML_VSCPRINTF( format, va );
         // Close out and re-start the va-args
@@ -2533,6 +4120,17 @@ void XMLPrinter::Write( const char* data, size_t size )
     if ( _fp ) {
         fwrite ( data , sizeof(char), size, _fp);
     }
+    else if ( _stream ) {
+        if ( _chunkSize + size > CHUNK_SIZE ) {
+            Flush();
+            if ( size >= CHUNK_SIZE ) {
+                WriteToStream( data, size );
+                return;
+            }
+        }
+        memcpy( _chunk + _chunkSize, data, size );
+        _chunkSize += size;
+    }
     else {
         char* p = _buffer.PushArr( static_cast<int>(size) ) - 1;   // back up over the null terminator.
         memcpy( p, data, size );
@@ -2546,6 +4144,12 @@ void XMLPrinter::Putc( char ch )
     if ( _fp ) {
         fputc ( ch, _fp);
     }
+    else if ( _stream ) {
+        if ( _chunkSize == CHUNK_SIZE ) {
+            Flush();
+        }
+        _chunk[_chunkSize++] = ch;
+    }
     else {
         char* p = _buffer.PushArr( sizeof(char) ) - 1;   // back up over the null terminator.
         p[0] = ch;
@@ -2568,47 +4172,30 @@ void XMLPrinter::PrintString( const char* p, bool restricted )
     const char* q = p;
 
     if ( _processEntities ) {
-        const bool* flag = restricted ? _restrictedEntityFlag : _entityFlag;
-        while ( *q ) {
-            TIXMLASSERT( p <= q );
-            // Remember, char is sometimes signed. (How many times has that bitten me?)
-            if ( *q > 0 && *q < ENTITY_RANGE ) {
-                // Check for entities. If one is found, flush
-                // the stream up until the entity, write the
-                // entity, and keep looking.
-                if ( flag[static_cast<unsigned char>(*q)] ) {
-                    while ( p < q ) {
-                        const size_t delta = q - p;
-                        const int toPrint = ( INT_MAX < delta ) ? INT_MAX : static_cast<int>(delta);
-                        Write( p, toPrint );
-                        p += toPrint;
-                    }
-                    bool entityPatternPrinted = false;
-                    for( int i=0; i<NUM_ENTITIES; ++i ) {
-                        if ( entities[i].value == *q ) {
-                            Putc( '&' );
-                            Write( entities[i].pattern, entities[i].length );
-                            Putc( ';' );
-                            entityPatternPrinted = true;
-                            break;
-                        }
-                    }
-                    if ( !entityPatternPrinted ) {
-                        // TIXMLASSERT( entityPatternPrinted ) causes gcc -Wunused-but-set-variable in release
-                        TIXMLASSERT( false );
-                    }
-                    ++p;
-                }
+        // Remember, char is sometimes signed. (How many times has that bitten me?)
+        const unsigned char* flag = restricted ? _restrictedEntityFlag : _entityFlag;
+        for( ;; ) {
+            // One table lookup per byte finds both entities and the terminator
+            unsigned char f;
+            while ( ( f = flag[static_cast<unsigned char>( *q )] ) == 0 ) {
+                ++q;
             }
-            ++q;
-            TIXMLASSERT( p <= q );
-        }
-        // Flush the remaining string. This will be the entire
-        // string if an entity wasn't found.
-        if ( p < q ) {
-            const size_t delta = q - p;
-            const int toPrint = ( INT_MAX < delta ) ? INT_MAX : static_cast<int>(delta);
-            Write( p, toPrint );
+            // Flush the run before the entity, which is the entire
+            // string if an entity wasn't found.
+            while ( p < q ) {
+                const size_t delta = q - p;
+                const int toPrint = ( INT_MAX < delta ) ? INT_MAX : static_cast<int>(delta);
+                Write( p, toPrint );
+                p += toPrint;
+            }
+            if ( f == ENTITY_STOP ) {
+                break;
+            }
+            const Entity& entity = entities[f - 1];
+            Putc( '&' );
+            Write( entity.pattern, entity.length );
+            Putc( ';' );
+            p = ++q;
         }
     }
     else {
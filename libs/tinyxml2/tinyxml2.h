@@ -116,6 +116,8 @@ static const int TINYXML2_MAX_ELEMENT_DEPTH = 100;
 namespace tinyxml2
 {
 class XMLDocument;
+class XMLArena;
+class XMLAtomTable;
 class XMLElement;
 class XMLAttribute;
 class XMLComment;
@@ -171,7 +173,7 @@ public:
         _start = const_cast<char*>(str);
     }
 
-    void SetStr( const char* str, int flags=0 );
+    void SetStr( const char* str, int flags=0, XMLArena* arena=0 );
 
     char* ParseText( char* in, const char* endTag, int strFlags, int* curLineNumPtr );
     char* ParseName( char* in );
@@ -322,6 +324,111 @@ private:
 };
 
 
+/**
+	A bump allocator that an XMLDocument can take its nodes and strings
+	from (see XMLDocument::SetArena()). Memory is never returned piece by
+	piece; Reset() rewinds to the start and keeps the blocks, so a document
+	that is parsed and cleared over and over stops touching the heap once
+	the blocks have grown to fit the largest document.
+*/
+class TINYXML2_LIB XMLArena
+{
+public:
+    explicit XMLArena( size_t blockSize = 16 * 1024 );
+    ~XMLArena();
+
+    void* Alloc( size_t size ) {
+        size = ( size + ALIGNMENT - 1 ) & ~static_cast<size_t>( ALIGNMENT - 1 );
+        if ( size > static_cast<size_t>( _end - _top ) ) {
+            return AllocFromNextBlock( size );
+        }
+        void* mem = _top;
+        _top += size;
+        return mem;
+    }
+
+    /// Makes all the memory available again, keeping the blocks.
+    void Reset();
+    /// Returns the blocks to the heap.
+    void Release();
+
+    /// Bytes handed out since the last Reset().
+    size_t Used() const;
+    /// Bytes held in blocks.
+    size_t Reserved() const;
+
+    enum { ALIGNMENT = sizeof( double ) > sizeof( void* ) ? sizeof( double ) : sizeof( void* ) };
+
+private:
+    XMLArena( const XMLArena& );	// not supported
+    void operator=( const XMLArena& );	// not supported
+
+    struct Block {
+        Block*	next;
+        size_t	size;
+    };
+    enum { HEADER_SIZE = ( sizeof( Block ) + ALIGNMENT - 1 ) & ~( ALIGNMENT - 1 ) };
+
+    static char* Data( Block* block ) {
+        return reinterpret_cast<char*>( block ) + HEADER_SIZE;
+    }
+    void* AllocFromNextBlock( size_t size );
+
+    Block*	_first;
+    Block*	_current;
+    char*	_top;
+    char*	_end;
+    size_t	_usedBefore;	// Bytes used in the blocks before _current
+    size_t	_blockSize;
+};
+
+
+/// A small integer standing for an interned name; 0 is no name.
+typedef int XMLAtom;
+
+/**
+	Interns element and attribute names to XMLAtoms (see
+	XMLDocument::SetAtomTable()). Atoms are numbered from 1 in the order
+	names are first seen, and stay valid for the life of the table, so
+	one table can be shared by every document a loader parses and the
+	atoms it needs can be looked up once, up front.
+*/
+class TINYXML2_LIB XMLAtomTable
+{
+public:
+    XMLAtomTable();
+    ~XMLAtomTable();
+
+    XMLAtom Intern( const char* name ) {
+        return Intern( name, strlen( name ) );
+    }
+    XMLAtom Intern( const char* name, size_t length );
+    /// Returns the atom of a name, or 0 if it has not been interned.
+    XMLAtom Find( const char* name ) const;
+    const char* Name( XMLAtom atom ) const {
+        TIXMLASSERT( atom > 0 && atom < _names.Size() );
+        return _names[atom];
+    }
+    int Count() const {
+        return _names.Size() - 1;
+    }
+
+private:
+    XMLAtomTable( const XMLAtomTable& );	// not supported
+    void operator=( const XMLAtomTable& );	// not supported
+
+    static unsigned Hash( const char* name, size_t length );
+    int FindSlot( const char* name, size_t length, unsigned hash ) const;
+    void Grow();
+
+    XMLArena					_storage;	// The interned strings
+    DynArray<const char*, 64>	_names;		// Indexed by atom
+    DynArray<unsigned, 64>		_hashes;	// Indexed by atom
+    XMLAtom*					_slots;		// Open addressing, linear probing; 0 is empty
+    int							_nSlots;	// Power of two
+};
+
+
 /*
 	Parent virtual class of a pool for fast allocation
 	and deallocation of objects.
@@ -336,6 +443,9 @@ public:
     virtual void* Alloc() = 0;
     virtual void Free( void* ) = 0;
     virtual void SetTracked() = 0;
+    virtual XMLArena* Arena() const		{
+        return 0;
+    }
 };
 
 
@@ -346,7 +456,7 @@ template< int ITEM_SIZE >
 class MemPoolT : public MemPool
 {
 public:
-    MemPoolT() : _blockPtrs(), _root(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
+    MemPoolT() : _blockPtrs(), _root(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0), _arena(0)	{}
     ~MemPoolT() {
         MemPoolT< ITEM_SIZE >::Clear();
     }
@@ -371,7 +481,19 @@ public:
         return _currentAllocs;
     }
 
+    /// Takes items from 'arena' instead of the pool's own blocks; the pool must be empty.
+    void SetArena( XMLArena* arena ) {
+        Clear();
+        _arena = arena;
+    }
+    virtual XMLArena* Arena() const	{
+        return _arena;
+    }
+
     virtual void* Alloc() {
+        if ( _arena ) {
+            return _arena->Alloc( ITEM_SIZE );
+        }
         if ( !_root ) {
             // Need a new block.
             Block* block = new Block();
@@ -398,7 +520,8 @@ public:
     }
 
     virtual void Free( void* mem ) {
-        if ( !mem ) {
+        if ( !mem || _arena ) {
+            // Arena items are reclaimed all at once by XMLArena::Reset()
             return;
         }
         --_currentAllocs;
@@ -454,6 +577,7 @@ private:
     int _nAllocs;
     int _maxAllocs;
     int _nUntracked;
+    XMLArena* _arena;
 };
 
 
@@ -553,18 +677,23 @@ public:
     static const char* SkipWhiteSpace( const char* p, int* curLineNumPtr )	{
         TIXMLASSERT( p );
 
-        while( IsWhiteSpace(*p) ) {
-            if (curLineNumPtr && *p == '\n') {
+        // Most runs are the single space between attributes; only longer ones
+        // are worth the block scan.
+        if ( !IsWhiteSpace( *p ) ) {
+            return p;
+        }
+        if ( !IsWhiteSpace( *(p+1) ) ) {
+            if ( curLineNumPtr && *p == '\n' ) {
                 ++(*curLineNumPtr);
             }
-            ++p;
+            return p + 1;
         }
-        TIXMLASSERT( p );
-        return p;
+        return SkipWhiteSpaceRun( p, curLineNumPtr );
     }
     static char* SkipWhiteSpace( char* p, int* curLineNumPtr )				{
         return const_cast<char*>( SkipWhiteSpace( const_cast<const char*>(p), curLineNumPtr ) );
     }
+    static const char* SkipWhiteSpaceRun( const char* p, int* curLineNumPtr );
 
     // Anything in the high order range of UTF-8 is assumed to not be whitespace. This isn't
     // correct, but simple, and usually works.
@@ -1137,6 +1266,10 @@ class TINYXML2_LIB XMLAttribute
 public:
     /// The name of the attribute.
     const char* Name() const;
+    /// The atom of the name, if the document has an atom table; otherwise 0.
+    XMLAtom Atom() const {
+        return _atom;
+    }
 
     /// The value of the attribute.
     const char* Value() const;
@@ -1234,20 +1367,24 @@ public:
 private:
     enum { BUF_SIZE = 200 };
 
-    XMLAttribute() : _name(), _value(),_parseLineNum( 0 ), _next( 0 ), _memPool( 0 ) {}
+    XMLAttribute() : _name(), _value(),_parseLineNum( 0 ), _next( 0 ), _memPool( 0 ), _atom( 0 ) {}
     virtual ~XMLAttribute()	{}
 
     XMLAttribute( const XMLAttribute& );	// not supported
     void operator=( const XMLAttribute& );	// not supported
     void SetName( const char* name );
 
-    char* ParseDeep( char* p, bool processEntities, int* curLineNumPtr );
+    char* ParseDeep( char* p, bool processEntities, bool unquotedValues, XMLAtomTable* atoms, int* curLineNumPtr );
+    XMLArena* Arena() const {
+        return _memPool ? _memPool->Arena() : 0;
+    }
 
     mutable StrPair _name;
     mutable StrPair _value;
     int             _parseLineNum;
     XMLAttribute*   _next;
     MemPool*        _memPool;
+    XMLAtom         _atom;
 };
 
 
@@ -1264,8 +1401,10 @@ public:
         return Value();
     }
     /// Set the name of the element.
-    void SetName( const char* str, bool staticMem=false )	{
-        SetValue( str, staticMem );
+    void SetName( const char* str, bool staticMem=false );
+    /// The atom of the name, if the document has an atom table; otherwise 0.
+    XMLAtom Atom() const {
+        return _atom;
     }
 
     virtual XMLElement* ToElement()				{
@@ -1506,6 +1645,10 @@ public:
     }
     /// Query a specific attribute in the list.
     const XMLAttribute* FindAttribute( const char* name ) const;
+    /** Query an attribute by the atom of its name, from the document's
+    	atom table. Compares integers instead of strings.
+    */
+    const XMLAttribute* FindAttribute( XMLAtom atom ) const;
 
     /** Convenience function for easy access to the text inside an element. Although easy
     	and concise, GetText() is limited compared to getting the XMLText child
@@ -1674,6 +1817,7 @@ private:
     // because the list needs to be scanned for dupes before adding
     // a new attribute.
     XMLAttribute* _rootAttribute;
+    XMLAtom _atom;
 };
 
 
@@ -1724,6 +1868,24 @@ public:
     */
     XMLError Parse( const char* xml, size_t nBytes=static_cast<size_t>(-1) );
 
+    /**
+    	Parse an XML document in place, without copying it. The
+    	document's strings point straight into 'xml', which is
+    	modified while parsing (entities, whitespace and string
+    	terminators are written into it).
+
+    	'xml' must have room for nBytes+1 characters; a null
+    	terminator is written at xml[nBytes]. If nBytes is not
+    	specified, 'xml' must be null terminated.
+
+    	If 'release' is null the buffer is borrowed, and must
+    	outlive the document (or its next Parse/Clear). Otherwise
+    	the document takes ownership and calls release(xml) when
+    	it is done with it - including when this call fails.
+    	Pass 'free' for buffers from malloc.
+    */
+    XMLError ParseInSitu( char* xml, size_t nBytes=static_cast<size_t>(-1), void (*release)( void* )=0 );
+
     /**
     	Load an XML file from disk.
     	Returns XML_SUCCESS (0) on success, or
@@ -1767,6 +1929,45 @@ public:
         return _whitespaceMode;
     }
 
+    /**
+    	Returns true if attribute values without quotes
+    	(e.g. <frame x=0 y=37 />) are accepted when parsing.
+    */
+    bool UnquotedAttributes() const {
+        return _unquotedAttributes;
+    }
+    /** Sets whether to accept unquoted attribute values when parsing.
+        Such values end at white space, '>' or "/>". Off by default.
+    */
+    void SetUnquotedAttributes( bool allow ) {
+        _unquotedAttributes = allow;
+    }
+
+    /**
+    	Allocates nodes, strings and the parse buffer from 'arena' (or, if
+    	null, from the document's own pools again). Clears the document.
+
+    	Arena nodes are not destructed: Clear() forgets them and resets the
+    	arena, which keeps its blocks for the next Parse(). The arena must
+    	outlive the document and must not be shared with another document.
+    */
+    void SetArena( XMLArena* arena );
+    XMLArena* Arena() const {
+        return _arena;
+    }
+
+    /**
+    	Interns the names of parsed (and created) elements and attributes
+    	in 'table', so they can be matched by XMLAtom. Null turns it off.
+    	The table is not owned and may be shared between documents.
+    */
+    void SetAtomTable( XMLAtomTable* table ) {
+        _atoms = table;
+    }
+    XMLAtomTable* AtomTable() const {
+        return _atoms;
+    }
+
     /**
     	Returns true if this document has a leading Byte Order Mark of UTF8.
     */
@@ -1850,7 +2051,9 @@ public:
     void DeleteNode( XMLNode* node );
 
     void ClearError() {
-        SetError(XML_SUCCESS, 0, 0);
+        _errorID = XML_SUCCESS;
+        _errorLineNum = 0;
+        _errorStr.Reset();
     }
 
     /// Return true if there was an error parsing the document.
@@ -1909,11 +2112,16 @@ private:
 
     bool			_writeBOM;
     bool			_processEntities;
+    bool			_unquotedAttributes;
     XMLError		_errorID;
     Whitespace		_whitespaceMode;
     mutable StrPair	_errorStr;
     int             _errorLineNum;
     char*			_charBuffer;
+    bool			_borrowedBuffer;	// _charBuffer came from ParseInSitu
+    void			(*_releaseBuffer)( void* );
+    XMLArena*		_arena;
+    XMLAtomTable*	_atoms;
     int				_parseCurLineNum;
 	int				_parsingDepth;
 	// Memory tracking does add some overhead.
@@ -1932,6 +2140,7 @@ private:
 	static const char* _errorNames[XML_ERROR_COUNT];
 
     void Parse();
+    char* NewCharBuffer( size_t size );
 
     void SetError( XMLError error, int lineNum, const char* format, ... );
 
@@ -1970,6 +2179,176 @@ inline NodeType* XMLDocument::CreateUnlinkedNode( MemPoolT<PoolElementSize>& poo
     return returnNode;
 }
 
+
+/**
+	A source of bytes for XMLStreamReader, such as a file read in chunks.
+*/
+class TINYXML2_LIB XMLInputStream
+{
+public:
+    virtual ~XMLInputStream() {}
+
+    /** Reads up to 'size' bytes into 'buffer'. Returns the number of
+    	bytes read, 0 at the end of the input, or -1 on error.
+    */
+    virtual int Read( char* buffer, int size ) = 0;
+};
+
+
+/**
+	A destination for XMLPrinter, such as a file written in chunks.
+*/
+class TINYXML2_LIB XMLOutputStream
+{
+public:
+    virtual ~XMLOutputStream() {}
+
+    /// Writes 'size' bytes from 'data'. Returns false if they couldn't all be written.
+    virtual bool Write( const char* data, int size ) = 0;
+};
+
+
+/**
+	A pull parser that walks a document one event at a time, without
+	building XMLElement or XMLAttribute nodes. It uses the same
+	tokenization, entity and whitespace rules as XMLDocument.
+
+	@verbatim
+	XMLStreamReader reader( &input );
+	XMLStreamReader::Event event;
+	while ( ( event = reader.Next() ) != XMLStreamReader::END_DOCUMENT ) {
+		if ( event == XMLStreamReader::FAILED )
+			break;
+		if ( event == XMLStreamReader::START_ELEMENT && XMLUtil::StringEqual( reader.Name(), "frame" ) )
+			reader.QueryIntAttribute( "x", &x );
+	}
+	@endverbatim
+
+	The reader keeps a window over the input that only has to hold the
+	current token, plus the names of the open elements. Memory use is
+	therefore bounded by the nesting depth and the largest single tag or
+	text run, not by the size of the document.
+
+	Strings returned by Name(), Text() and the attribute accessors point
+	into that window, and are only valid until the next call to Next().
+*/
+class TINYXML2_LIB XMLStreamReader
+{
+public:
+    enum Event {
+        START_ELEMENT,	// Name() and the attributes are available
+        END_ELEMENT,	// Name() is available; also reported for <empty/> elements
+        CHARACTERS,		// Text() is available; CDATA sections are reported as-is
+        END_DOCUMENT,
+        FAILED			// See ErrorID()
+    };
+
+    XMLStreamReader( XMLInputStream* input, bool processEntities = true, Whitespace whitespaceMode = PRESERVE_WHITESPACE,
+                     int bufferSize = 4096 );
+    ~XMLStreamReader();
+
+    /// Accept attribute values without quotes, as XMLDocument::SetUnquotedAttributes() does.
+    void SetUnquotedAttributes( bool allow ) {
+        _unquotedAttributes = allow;
+    }
+
+    /// Advances to the next event and returns it.
+    Event Next();
+    /// Skips the rest of the element just started, up to and including its END_ELEMENT.
+    Event SkipElement();
+
+    Event Current() const {
+        return _event;
+    }
+    /// The number of open elements, counting the one just started.
+    int Depth() const {
+        return _nameStarts.Size();
+    }
+    /// The line the current event starts on.
+    int LineNum() const {
+        return _eventLineNum;
+    }
+
+    const char* Name() const {
+        return _name;
+    }
+    const char* Text() const {
+        return _text;
+    }
+
+    int AttributeCount() const {
+        return _attributes.Size() / 2;
+    }
+    const char* AttributeName( int i ) const {
+        return _attributes[i * 2];
+    }
+    const char* AttributeValue( int i ) const {
+        return _attributes[i * 2 + 1];
+    }
+    /// Same semantics as XMLElement::Attribute().
+    const char* Attribute( const char* name, const char* value = 0 ) const;
+
+    XMLError QueryIntAttribute( const char* name, int* value ) const;
+    XMLError QueryUnsignedAttribute( const char* name, unsigned* value ) const;
+    XMLError QueryBoolAttribute( const char* name, bool* value ) const;
+    XMLError QueryFloatAttribute( const char* name, float* value ) const;
+    XMLError QueryDoubleAttribute( const char* name, double* value ) const;
+
+    int IntAttribute( const char* name, int defaultValue = 0 ) const {
+        int i = defaultValue;
+        QueryIntAttribute( name, &i );
+        return i;
+    }
+
+    XMLError ErrorID() const {
+        return _errorID;
+    }
+    int ErrorLineNum() const {
+        return _errorLineNum;
+    }
+    const char* ErrorName() const;
+
+private:
+    XMLStreamReader( const XMLStreamReader& );	// not supported
+    void operator=( const XMLStreamReader& );	// not supported
+
+    bool Fill();
+    int Find( int offset, const char* terminator );
+    int FindTagEnd();
+    Event ParseStartTag( int end );
+    Event ParseEndTag( int end );
+    Event Fail( XMLError error );
+    void Consume( int length );
+
+    XMLInputStream*	_input;
+    bool			_processEntities;
+    bool			_unquotedAttributes;
+    Whitespace		_whitespaceMode;
+
+    char*			_buffer;		// The window; always null terminated at _size
+    int				_capacity;
+    int				_size;
+    int				_pos;			// Start of the next token
+    bool			_started;
+    bool			_eof;
+    bool			_restoreLT;		// Text() was terminated by overwriting the '<' at _pos
+    bool			_pendingEnd;	// END_ELEMENT of an empty element still to report
+    bool			_sawMarkup;
+
+    Event			_event;
+    const char*		_name;
+    const char*		_text;
+    int				_lineNum;
+    int				_eventLineNum;
+    XMLError		_errorID;
+    int				_errorLineNum;
+
+    DynArray<const char*, 32> _attributes;	// Name, value, name, value...
+    DynArray<char*, 32>		_ranges;		// Raw attribute ranges, before entity processing
+    DynArray<char, 256>		_names;			// Null terminated names of the open elements
+    DynArray<int, 16>		_nameStarts;
+};
+
 /**
 	A XMLHandle is a class that wraps a node pointer with null checks; this is
 	an incredibly useful thing. Note that XMLHandle is not part of the TinyXML-2
@@ -2168,6 +2547,87 @@ private:
 };
 
 
+/**
+	A path compiled once and run over many documents, for loaders that
+	read the same values out of hundreds of files.
+
+	A path is a list of element names separated by '/', starting below
+	the node it is run from. '*' matches any element, and a step can
+	require an attribute with [@name] or [@name=value]. A trailing @name
+	selects that attribute's value; otherwise the element's text is used.
+
+	@verbatim
+	XMLPath frameX( "tileset/tiles/tile[@id]/frame@x", &atoms );
+	int x[256];
+	int n = frameX.QueryInts( &doc, x, 256 );
+	@endverbatim
+
+	Names are interned in 'atoms' when given. Run over a document that
+	uses the same table (see XMLDocument::SetAtomTable()), steps are
+	matched by XMLAtom rather than by string compares.
+*/
+class TINYXML2_LIB XMLPath
+{
+public:
+    static const int MAX_STEPS = 16;
+
+    XMLPath();
+    XMLPath( const char* path, XMLAtomTable* atoms = 0 );
+    ~XMLPath();
+
+    /** Compiles 'path', replacing any previous one. Returns false,
+    	and leaves the path empty, if it is malformed or too deep.
+    */
+    bool Compile( const char* path, XMLAtomTable* atoms = 0 );
+
+    bool Compiled() const {
+        return _nSteps > 0;
+    }
+
+    /// Returns the first matching element below 'from', or null.
+    const XMLElement* First( const XMLNode* from ) const;
+    /// Returns the number of matching elements below 'from'.
+    int Count( const XMLNode* from ) const;
+
+    /** The bulk queries write up to 'max' results in document order and
+    	return how many were written. Matches whose value is missing or
+    	doesn't convert to the type are skipped.
+    */
+    int Select( const XMLNode* from, const XMLElement** out, int max ) const;
+    int QueryTexts( const XMLNode* from, const char** out, int max ) const;
+    int QueryInts( const XMLNode* from, int* out, int max ) const;
+    int QueryUnsigneds( const XMLNode* from, unsigned* out, int max ) const;
+    int QueryFloats( const XMLNode* from, float* out, int max ) const;
+    int QueryDoubles( const XMLNode* from, double* out, int max ) const;
+
+private:
+    struct Step {
+        const char*	name;		// Null for '*'
+        const char*	attr;		// [@attr], or null
+        const char*	value;		// [@attr=value], or null
+        XMLAtom		nameAtom;
+        XMLAtom		attrAtom;
+    };
+
+    void Reset();
+    bool Parse();
+    bool Matches( const XMLElement* element, const Step& step, bool byAtom ) const;
+    const XMLElement* NextMatch( const XMLElement* element, int step, bool byAtom ) const;
+    const char* Selected( const XMLElement* element, bool byAtom ) const;
+    template< class Sink > int Walk( const XMLNode* from, Sink& sink, int max ) const;
+
+    XMLPath( const XMLPath& );	// not supported
+    void operator=( const XMLPath& );	// not supported
+
+    char*			_buffer;	// Copy of the path, split into the names below
+    Step			_steps[MAX_STEPS];
+    int				_nSteps;
+    const char*		_select;	// Trailing @attr, or null to select text
+    XMLAtom			_selectAtom;
+    XMLAtomTable*	_atoms;
+};
+
+
 /**
 	Printing functionality. The XMLPrinter gives you more
 	options than the XMLDocument::Print() method.
@@ -2220,7 +2680,20 @@ public:
     	with only required whitespace and newlines.
     */
     XMLPrinter( FILE* file=0, bool compact = false, int depth = 0 );
-    virtual ~XMLPrinter()	{}
+    /** Construct a printer that writes to 'stream'. Output is gathered
+    	in a fixed buffer, allocated once by this constructor, and handed
+    	to the stream in chunks, so memory use doesn't grow with the document.
+    */
+    XMLPrinter( XMLOutputStream& stream, bool compact = false, int depth = 0 );
+    virtual ~XMLPrinter()	{
+        Flush();
+        delete [] _chunk;
+    }
+
+    /** If printing to a stream, write out what is buffered. Returns false
+    	if the stream has failed on this or any earlier write.
+    */
+    bool Flush();
 
     /** If streaming, write the BOM and declaration. */
     void PushHeader( bool writeBOM, bool writeDeclaration );
@@ -2264,6 +2737,7 @@ public:
 
     virtual bool VisitEnter( const XMLDocument& /*doc*/ );
     virtual bool VisitExit( const XMLDocument& /*doc*/ )			{
+        Flush();
         return true;
     }
 
@@ -2317,23 +2791,33 @@ protected:
     DynArray< const char*, 10 > _stack;
 
 private:
+    void Init();
     void PrintString( const char*, bool restrictedEntitySet );	// prints out, after detecting entities.
+    void WriteToStream( const char* data, size_t size );
 
     bool _firstElement;
     FILE* _fp;
+    XMLOutputStream* _stream;
+    bool _streamError;
     int _depth;
     int _textDepth;
     bool _processEntities;
 	bool _compactMode;
 
     enum {
-        ENTITY_RANGE = 64,
-        BUF_SIZE = 200
+        ENTITY_RANGE = 256,
+        ENTITY_STOP = 0xff,
+        BUF_SIZE = 200,
+        CHUNK_SIZE = 4096
     };
-    bool _entityFlag[ENTITY_RANGE];
-    bool _restrictedEntityFlag[ENTITY_RANGE];
+    // Per byte: 1 + its index in the entity table if it is printed as an entity,
+    // ENTITY_STOP for the terminator, else 0.
+    unsigned char _entityFlag[ENTITY_RANGE];
+    unsigned char _restrictedEntityFlag[ENTITY_RANGE];
 
     DynArray< char, 20 > _buffer;
+    char* _chunk;	// Output waiting for the stream; CHUNK_SIZE bytes, only for stream printers
+    size_t _chunkSize;
 
     // Prohibit cloning, intentionally not implemented
     XMLPrinter( const XMLPrinter& );
@@ -3,8 +3,16 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
 #include <xeno/platform.h>
+#include <xeno/allocator.h>
+#include <xeno/memtrack.h>
 #include <xeno/fsutils.h>
 #include <xeno/imageutils.h>
+#include <xeno/mainloop.h>
+#include <xeno/xmlbatch.h>
+#include <xeno/dirtyrects.h>
+#include <xeno/metrics.h>
+#include <xeno/boot.h>
+#include <xeno/profiler.h>
 
 #include <SDL2/SDL.h>
 #include <physfs.h>
@@ -31,23 +39,118 @@ const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 #endif
 
+// Tileset descriptors are parsed at boot, across every core, to catch broken ones early
+static const char *tilesetDirs[] = {"tilesets/iso/prototype", "tilesets/ortho/prototype"};
+static const int MAX_DESCRIPTORS = 256;
+static const size_t MAX_DESCRIPTOR_PATH = 128;
+
+static void countTiles(int index, const char *path, const tinyxml2::XMLDocument *doc, void *userdata) {
+  if (!doc || doc->Error()) {
+    debugPrint("Couldn't parse '%s': %s\n", path, doc ? doc->ErrorStr() : "unreadable");
+    return;
+  }
+  const tinyxml2::XMLElement *tileset = doc->FirstChildElement("tileset");
+  const tinyxml2::XMLElement *tiles = tileset ? tileset->FirstChildElement("tiles") : NULL;
+  int n = 0;
+  for (const tinyxml2::XMLElement *tile = tiles ? tiles->FirstChildElement("tile") : NULL; tile;
+       tile = tile->NextSiblingElement("tile"))
+    ++n;
+  SDL_AtomicAdd((SDL_atomic_t *) userdata, n);
+}
+
+
+static void parseTilesetDescriptors(void) {
+  char *pathData = (char *) XENO_malloc(XENO_MEM_XML, MAX_DESCRIPTORS * MAX_DESCRIPTOR_PATH);
+  const char *paths[MAX_DESCRIPTORS];
+  int nPaths = 0;
+  if (!pathData)
+    return;
+
+  for (size_t d = 0; d < SDL_arraysize(tilesetDirs); ++d) {
+    char **files = PHYSFS_enumerateFiles(tilesetDirs[d]);
+    for (char **f = files; f && *f && nPaths < MAX_DESCRIPTORS; ++f) {
+      size_t len = strlen(*f);
+      if (len < 4 || strcmp(*f + len - 4, ".xml"))
+        continue;
+      char *path = pathData + nPaths * MAX_DESCRIPTOR_PATH;
+      SDL_snprintf(path, MAX_DESCRIPTOR_PATH, "%s/%s", tilesetDirs[d], *f);
+      paths[nPaths++] = path;
+    }
+    PHYSFS_freeList(files);
+  }
+
+  SDL_atomic_t tiles;
+  SDL_AtomicSet(&tiles, 0);
+  XENO_XMLBatch *batch = XENO_createXMLBatch(0, XENO_XML_UNQUOTED_ATTRIBUTES);
+  int parsed = batch ? XENO_parseXMLBatch(batch, paths, nPaths, XENO_XML_AS_COMPLETED, countTiles, &tiles) : 0;
+  debugPrint("Parsed %d of %d tileset descriptors (%d tiles) on %d workers\n", parsed, nPaths,
+             SDL_AtomicGet(&tiles), batch ? batch->nWorkers : 0);
+  XENO_destroyXMLBatch(batch);
+  XENO_free(pathData);
+}
+
 
 #ifdef XENO_PLATFORM_NXDK
 int main(void) {  
   XVideoSetMode(SCREEN_WIDTH, SCREEN_HEIGHT, 32, REFRESH_DEFAULT);
   char *argv0 = NULL;
+  int bootOnly = 0;
+  uint64_t maxFrames = 0;
+  Uint32 bootBudget = 0;
+  const char *metricsFile = NULL;
+  const char *traceFile = NULL;
+  // Report where memory's gone well before the console runs out of it
+  XENO_setMemWatermark(48 * 1024 * 1024);
 #else
 int main(int argc, char* argv[]) {
   char *argv0 = argv[0];
+  // --boot-only exits once booted instead of running the game, and --frames N stops
+  // the game after N frames. --boot-budget MS makes a slow boot exit with an error, for
+  // make boot-check. --mem-cap BYTES fails allocations past it, as if that were all the
+  // memory there is, and --mem-watermark BYTES reports where memory's gone once past it.
+  // MEMTRACK=y builds take --mem-sampling N to record the call stack of every Nth
+  // allocation. --metrics FILE writes the metrics to FILE in the write directory once
+  // booted, and PROFILE=y builds take --trace FILE to write the profiling zones there
+  // on the way out.
+  int bootOnly = 0;
+  uint64_t maxFrames = 0;
+  Uint32 bootBudget = 0;
+  const char *metricsFile = NULL;
+  const char *traceFile = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--boot-only") == 0)
+      bootOnly = 1;
+    else if (i + 1 == argc)
+      break;
+    else if (strcmp(argv[i], "--frames") == 0)
+      maxFrames = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--boot-budget") == 0)
+      bootBudget = (Uint32) strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--mem-cap") == 0)
+      XENO_setMemCap((size_t) strtoul(argv[++i], NULL, 10));
+    else if (strcmp(argv[i], "--mem-watermark") == 0)
+      XENO_setMemWatermark((size_t) strtoul(argv[++i], NULL, 10));
+    else if (strcmp(argv[i], "--mem-sampling") == 0)
+      XENO_setMemSampling((uint32_t) strtoul(argv[++i], NULL, 10));
+    else if (strcmp(argv[i], "--metrics") == 0)
+      metricsFile = argv[++i];
+    else if (strcmp(argv[i], "--trace") == 0)
+      traceFile = argv[++i];
+  }
 #endif
 
   SDL_Window *window;
   SDL_Renderer *renderer;
   SDL_Texture *sprite;
 
+  XENO_beginBootPhase("boot", NULL);
   SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO);
+  XENO_setMemTag(XENO_MEM_GAME);
 
-  if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+  XENO_beginBootPhase("SDL_Init", NULL);
+  int sdlInit = SDL_Init(SDL_INIT_VIDEO);
+  XENO_endBootPhase();
+  if (sdlInit < 0) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialize SDL.\n");
     return 1;
   }
@@ -56,89 +159,154 @@ int main(int argc, char* argv[]) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't set scale sampling quality.\n");
 
   const char* mounts[] = {"override", "resource.zip"};
-  if (!XENO_initFilesystem(argv0, mounts, 2)) {
+  XENO_beginBootPhase("initFilesystem", NULL);
+  int fsInit = XENO_initFilesystem(argv0, mounts, 2);
+  XENO_endBootPhase();
+  if (!fsInit) {
     debugPrint("initFilesystem failed! PhysFS error msg: %s\n", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
     debugSleep(3000);
     return 1;
   }
 debugPrint("Mounted filesystems\n");
+  XENO_beginBootPhase("loadAssets", NULL);
   // Test XML reader
   tinyxml2::XMLDocument doc;
   char *dreamBuf = NULL;
 debugPrint("Created doc object\n");
+  XENO_beginBootPhase("readFile", "testfile.txt");
   uint32_t testLen = XENO_readFile("testfile.txt", &dreamBuf);
+  XENO_endBootPhase();
 debugPrint("Buffered test file\n");
-  uint32_t dreamLen = XENO_readFile("dream.xml", &dreamBuf);
+  tinyxml2::XMLError parsed;
+  {
+    // The document takes the buffer over instead of copying it, so both go on the xml tag
+    XENO_MemTagScope memTag(XENO_MEM_XML);
+    XENO_beginBootPhase("readFile", "dream.xml");
+    uint32_t dreamLen = XENO_readFile("dream.xml", &dreamBuf);
+    XENO_endBootPhase();
 debugPrint("Buffered dream.xml\n");
-  if (doc.Parse(dreamBuf, dreamLen) == tinyxml2::XML_SUCCESS) {
+    XENO_beginBootPhase("parse", "dream.xml");
+    parsed = doc.ParseInSitu(dreamBuf, dreamLen, XENO_free);
+    XENO_endBootPhase();
+  }
+  XENO_beginBootPhase("parseTilesets", NULL);
+  parseTilesetDescriptors();
+  XENO_endBootPhase();
+  XENO_endBootPhase();
+  XENO_finishBoot();
+  XENO_printBootWaterfall();
+  if (parsed == tinyxml2::XML_SUCCESS) {
 debugPrint("Parsed dream.xml\n");
-    debugPrint("Play title: '%s'\n", doc.FirstChildElement( "PLAY" )->FirstChildElement( "TITLE" )->GetText());
+    XENO_MemTagScope memTag(XENO_MEM_XML);
+    tinyxml2::XMLPath titlePath("PLAY/TITLE");
+    const char *title = "";
+    titlePath.QueryTexts(&doc, &title, 1);
+    debugPrint("Play title: '%s'\n", title);
   } else
     debugPrint("XML parse failed: %s\n", doc.ErrorStr());
+  XENO_logMemStats();
+  if (metricsFile)
+    XENO_dumpMetrics(metricsFile, XENO_METRICS_TEXT);
 
-/*
-  window = SDL_CreateWindow(APP_TITLE,
-    SDL_WINDOWPOS_UNDEFINED,
-    SDL_WINDOWPOS_UNDEFINED,
-    SCREEN_WIDTH, SCREEN_HEIGHT,
-    SDL_WINDOW_SHOWN);
-  if(window == NULL)
-  {
-      debugPrint( "Window could not be created!\n");
+  if (!bootOnly) {
+    window = SDL_CreateWindow(APP_TITLE,
+      SDL_WINDOWPOS_UNDEFINED,
+      SDL_WINDOWPOS_UNDEFINED,
+      SCREEN_WIDTH, SCREEN_HEIGHT,
+      SDL_WINDOW_SHOWN);
+    if (!window) {
+      debugPrint("Window could not be created!\n");
       SDL_Quit();
       return 1;
-  }
+    }
 
-  // Create the renderer
-  renderer = SDL_CreateRenderer(window, -1, 0);
-  if (!renderer) {
+    // Draw straight into the window surface where we can, so that only the dirty
+    // regions need copying to the screen; otherwise present whole frames
+    SDL_Surface *screen = SDL_GetWindowSurface(window);
+    renderer = screen ? SDL_CreateSoftwareRenderer(screen) : NULL;
+    const int partial = renderer != NULL;
+    if (!renderer)
+      renderer = SDL_CreateRenderer(window, -1, 0);
+    if (!renderer) {
       SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create renderer.\n");
+      SDL_DestroyWindow(window);
       SDL_Quit();
       return 1;
-  }
+    }
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+
+    // Load image
+    sprite = XENO_LoadBMPTexture(renderer, "stone.bmp");
+
+    // Main render loop
+    struct DemoScene {
+      SDL_Renderer *renderer;
+      SDL_Texture *sprite;
+      SDL_Rect position;
+      XENO_DirtyRects dirty;
+
+      static int event(const SDL_Event *event, void *userdata) {
+        DemoScene *scene = (DemoScene *) userdata;
+        if (event->type == SDL_WINDOWEVENT && event->window.event == SDL_WINDOWEVENT_EXPOSED)
+          XENO_markAllDirty(&scene->dirty);
+        return 0;
+      }
 
-  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
-  SDL_RenderClear(renderer);
-
-  // Load image
-  sprite = XENO_LoadBMPTexture(renderer, "stone.bmp");
-
-  // Main render loop
-  int done = 0;
-  SDL_Event event;
-  SDL_Rect position;
-  position.x = 30;
-  position.y = 50;
-  SDL_QueryTexture(sprite, NULL, NULL, &position.w, &position.h);
-  while (!done) {
-      // Check for events
-      while (SDL_PollEvent(&event)) {
-          switch (event.type) {
-          case SDL_WINDOWEVENT:
-              switch (event.window.event) {
-              case SDL_WINDOWEVENT_EXPOSED:
-//                  SDL_SetRenderDrawColor(renderer, 0xA0, 0xA0, 0xA0, 0xFF);
-//                  SDL_RenderClear(renderer);
-                  break;
-              }
-              break;
-          case SDL_QUIT:
-              done = 1;
-              break;
-          default:
-              break;
-          }
+      static void update(double dt, void *userdata) {
       }
-      SDL_RenderClear(renderer);
-      SDL_RenderCopy(renderer, sprite, NULL, &position);
-      SDL_RenderPresent(renderer);
+
+      static void draw(SDL_Renderer *renderer, const SDL_Rect *region, void *userdata) {
+        DemoScene *scene = (DemoScene *) userdata;
+        if (scene->sprite && SDL_HasIntersection(region, &scene->position))
+          SDL_RenderCopy(renderer, scene->sprite, NULL, &scene->position);
+      }
+
+      static int render(double alpha, void *userdata) {
+        DemoScene *scene = (DemoScene *) userdata;
+        return XENO_renderDirty(scene->renderer, &scene->dirty, draw, scene);
+      }
+    };
+    DemoScene scene;
+    scene.renderer = renderer;
+    scene.sprite = sprite;
+    scene.position.x = 30;
+    scene.position.y = 50;
+    scene.position.w = scene.position.h = 0;
+    if (sprite)
+      SDL_QueryTexture(sprite, NULL, NULL, &scene.position.w, &scene.position.h);
+    XENO_initDirtyRects(&scene.dirty, SCREEN_WIDTH, SCREEN_HEIGHT, partial);
+
+    XENO_MainLoop loop;
+    XENO_initMainLoop(&loop, 60);
+    loop.maxFrames = maxFrames;
+    loop.event = DemoScene::event;
+    loop.update = DemoScene::update;
+    loop.render = DemoScene::render;
+    loop.userdata = &scene;
+    loop.dirty = &scene.dirty;
+    loop.window = window;
+    loop.renderer = renderer;
+    loop.arena = XENO_createFrameArena(64 * 1024, XENO_MEM_GAME);
+    XENO_setMetricsDump("metrics.json", XENO_METRICS_JSON, 10000);
+    XENO_runMainLoop(&loop);
+    XENO_printFrameHistogram(&loop);
+    XENO_destroyFrameArena(loop.arena);
+
+    if (sprite)
+      SDL_DestroyTexture(sprite);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
   }
-*/
+  if (traceFile)
+    XENO_exportTrace(traceFile);
 debugPrint("main: end of code\n");
 debugSleep(3000);
   SDL_Quit();
   PHYSFS_deinit(); // TODO: crashes on Xbox
 debugPrint("main: finished PHYSFS_deinit()");
   debugSleep(3000);
+  if (bootBudget && !XENO_checkBootBudget(bootBudget))
+    return 3;
   return 0;
 }